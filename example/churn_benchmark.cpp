@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Creates and destroys a plugin in a loop with on-demand (lazy) load/unload enabled, first
+// unloading the library after every destruction and then retaining it with an
+// UnloadRetentionPolicy.
+//
+// Usage: plugin_loader_ChurnBenchmark [library_path] [iterations]
+// library_path defaults to the plugin_loader_TestPlugins library of the build tree.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "base.hpp"
+
+double runChurn(const std::string & library_path, int iterations)
+{
+  plugin_loader::PluginLoader loader(library_path, true);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    loader.createInstance<Base>("Dog");
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+}
+
+int main(int argc, char ** argv)
+{
+  std::string library_path = argc > 1 ? argv[1] : TEST_PLUGINS_LIBRARY;
+  int iterations = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+  double unload_every_time = 0.0;
+  double retained = 0.0;
+  try {
+    unload_every_time = runChurn(library_path, iterations);
+
+    plugin_loader::UnloadRetentionPolicy policy;
+    policy.min_idle_time = std::chrono::seconds(1);
+    policy.max_idle_libraries = 8;
+    plugin_loader::setUnloadRetentionPolicy(policy);
+    retained = runChurn(library_path, iterations);
+  } catch (const plugin_loader::PluginLoaderException & e) {
+    fprintf(stderr, "Benchmark failed: %s\n", e.what());
+    return 1;
+  }
+
+  printf("create/destroy cycles          : %d\n", iterations);
+  printf("without retention (us/cycle)   : %.2f\n", unload_every_time);
+  printf("with 1s retention (us/cycle)   : %.2f\n", retained);
+  return 0;
+}
@@ -1,7 +1,18 @@
 #include "plugins.h"
+#include "library_id.hpp"
+
+namespace
+{
+class Id : public LibraryId
+{
+public:
+  virtual int get() {return 1;}
+};
+}  // namespace
 
 PLUGIN_LOADER_REGISTER_CLASS(Dog, Base)
 PLUGIN_LOADER_REGISTER_CLASS(Cat, Base)
 PLUGIN_LOADER_REGISTER_CLASS(Duck, Base)
 PLUGIN_LOADER_REGISTER_CLASS(Cow, Base)
 PLUGIN_LOADER_REGISTER_CLASS(Sheep, Base)
+PLUGIN_LOADER_REGISTER_CLASS(Id, LibraryId)
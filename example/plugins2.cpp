@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "base.hpp"
+#include "counter.hpp"
+#include "library_id.hpp"
+#include "pooled.hpp"
+
+class Table : public Base
+{
+public:
+  Table() {}
+  Table(const Table &) = default;
+  virtual void saySomething() {std::cout << "Table" << std::endl;}
+};
+
+PLUGIN_LOADER_REGISTER_PROTOTYPE_CLASS(Table, Base)
+
+namespace
+{
+int count = 0;
+}  // namespace
+
+// Counts in the library, so that each copy of the library counts on its own
+class StaticCounter : public Counter
+{
+public:
+  virtual int increment() {return ++count;}
+};
+
+PLUGIN_LOADER_REGISTER_CLASS(StaticCounter, Counter)
+
+class Buffer : public Pooled
+{
+};
+
+PLUGIN_LOADER_REGISTER_CLASS(Buffer, Pooled)
+
+namespace
+{
+class Id : public LibraryId
+{
+public:
+  virtual int get() {return 2;}
+};
+}  // namespace
+
+PLUGIN_LOADER_REGISTER_CLASS(Id, LibraryId)
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// OutputHandlerAsync::flush() must return once every message logged before it reached the sink
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plugin_loader/console.h"
+
+#include "check.hpp"
+
+// Only the thread of OutputHandlerAsync calls it, and flush() orders it before the checks
+class CountingOutputHandler : public plugin_loader::OutputHandler
+{
+public:
+  virtual void log(const plugin_loader::LogRecord & record)
+  {
+    int thread_index = 0;
+    int message_index = 0;
+    if (sscanf(record.text, "message %d %d", &thread_index, &message_index) != 2) {
+      ++reports;
+      return;
+    }
+    // Messages of a thread must be forwarded in the order they were logged, less the dropped ones
+    CHECK(next_messages[thread_index] <= message_index);
+    next_messages[thread_index] = message_index + 1;
+    ++count;
+  }
+
+  std::map<int, int> next_messages;
+  int count = 0;
+  int reports = 0;
+};
+
+void logMessages(int thread_count, int message_count)
+{
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; t++) {
+    threads.emplace_back([t, message_count] {
+        for (int i = 0; i < message_count; i++) {
+          plugin_loader::logInform("message %d %d", t, i);
+        }
+      });
+  }
+  for (std::thread & thread : threads) {
+    thread.join();
+  }
+}
+
+int main()
+{
+  const int thread_count = 4;
+  const int message_count = 1000;
+  plugin_loader::setLogLevel(plugin_loader::CONSOLE_LOG_INFO);
+  plugin_loader::setLogRateLimit(0, std::chrono::milliseconds(0));
+
+  {
+    // A queue much smaller than the messages makes the threads wait for the sink
+    CountingOutputHandler sink;
+    plugin_loader::OutputHandlerAsync async(&sink, 16, plugin_loader::CONSOLE_ASYNC_BLOCK);
+    plugin_loader::useOutputHandler(&async);
+    logMessages(thread_count, message_count);
+    async.flush();
+    CHECK(sink.count == thread_count * message_count);
+    CHECK(async.getDroppedCount() == 0);
+    plugin_loader::restorePreviousOutputHandler();
+  }
+
+  {
+    // Dropped messages are only counted, the others must still all be forwarded by flush()
+    CountingOutputHandler sink;
+    plugin_loader::OutputHandlerAsync async(&sink, 16, plugin_loader::CONSOLE_ASYNC_DROP);
+    plugin_loader::useOutputHandler(&async);
+    logMessages(thread_count, message_count);
+    async.flush();
+    std::size_t forwarded = sink.count;
+    CHECK(forwarded + async.getDroppedCount() == std::size_t(thread_count * message_count));
+    // Nothing is left to forward after a flush
+    async.flush();
+    CHECK(sink.count == int(forwarded));
+    plugin_loader::restorePreviousOutputHandler();
+  }
+  return 0;
+}
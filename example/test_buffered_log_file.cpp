@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// OutputHandlerBufferedFile must hold messages back until its buffer fills up, an error is logged
+// or it is destroyed
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "plugin_loader/console.h"
+
+#include "check.hpp"
+
+std::string readFile(const std::string & path)
+{
+  std::ifstream in(path);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+bool contains(const std::string & text, const std::string & part)
+{
+  return text.find(part) != std::string::npos;
+}
+
+int main()
+{
+  char path_template[] = "/tmp/buffered_log_testXXXXXX";
+  const int fd = mkstemp(path_template);
+  CHECK(fd >= 0);
+  close(fd);
+  const std::string path = path_template;
+  plugin_loader::setLogLevel(plugin_loader::CONSOLE_LOG_INFO);
+  plugin_loader::setLogRateLimit(0, std::chrono::milliseconds(0));
+
+  {
+    // Only the buffer, errors and the destructor write, never the interval
+    plugin_loader::OutputHandlerBufferedFile handler(
+      path.c_str(), 256, std::chrono::hours(1), plugin_loader::CONSOLE_LOG_ERROR);
+    plugin_loader::useOutputHandler(&handler);
+
+    plugin_loader::logInform("message 0");
+    CHECK(readFile(path).empty());
+
+    // Filling the buffer writes all the messages buffered so far
+    int count = 1;
+    while (readFile(path).empty()) {
+      CHECK(count * 10 < 256);  // Messages are at least 10 bytes long
+      plugin_loader::logInform("message %d", count++);
+    }
+    std::string contents = readFile(path);
+    for (int i = 0; i < count; i++) {
+      CHECK(contains(contents, "Info:    message " + std::to_string(i) + "\n"));
+    }
+
+    // An error writes the pending messages along with it
+    plugin_loader::logInform("pending");
+    CHECK(!contains(readFile(path), "pending"));
+    plugin_loader::logError("failure");
+    contents = readFile(path);
+    CHECK(contains(contents, "Info:    pending\n"));
+    CHECK(contains(contents, "Error:   failure\n"));
+    CHECK(contents.find("pending") < contents.find("failure"));
+
+    // A message larger than the buffer is written right away
+    const std::string large(300, 'x');
+    plugin_loader::logInform("%s", large.c_str());
+    CHECK(contains(readFile(path), large));
+
+    plugin_loader::logInform("last");
+    CHECK(!contains(readFile(path), "last"));
+    plugin_loader::restorePreviousOutputHandler();
+  }
+  // The destructor writes the rest
+  CHECK(contains(readFile(path), "Info:    last\n"));
+
+  CHECK(0 == unlink(path.c_str()));
+  return 0;
+}
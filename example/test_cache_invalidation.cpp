@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// The cached class listings of MultiLibraryPluginLoader and the factory lookups cached by each
+// thread must not outlive an unload or reload of the library they were taken from
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "plugin_loader/multi_library_plugin_loader.hpp"
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "base.hpp"
+#include "check.hpp"
+#include "library_id.hpp"
+
+bool hasClass(const plugin_loader::ClassNameListPtr & classes, const std::string & name)
+{
+  return std::binary_search(classes->begin(), classes->end(), name);
+}
+
+bool throwsCreateClassException(
+  plugin_loader::MultiLibraryPluginLoader & loader, const std::string & class_name)
+{
+  try {
+    loader.createInstance<Base>(class_name);
+  } catch (const plugin_loader::CreateClassException &) {
+    return true;
+  }
+  return false;
+}
+
+int main()
+{
+  const std::string plugins_path = TEST_PLUGINS_LIBRARY;
+  const std::string plugins2_path = TEST_PLUGINS2_LIBRARY;
+
+  {
+    // The listing is shared until a library is bound or unbound
+    plugin_loader::MultiLibraryPluginLoader loader(false);
+    loader.loadLibrary(plugins_path);
+    plugin_loader::ClassNameListPtr classes = loader.getAvailableClassesSnapshot<Base>();
+    CHECK(classes == loader.getAvailableClassesSnapshot<Base>());
+    CHECK(hasClass(classes, "Dog") && !hasClass(classes, "Table"));
+
+    loader.loadLibrary(plugins2_path);
+    classes = loader.getAvailableClassesSnapshot<Base>();
+    CHECK(hasClass(classes, "Dog") && hasClass(classes, "Table"));
+    loader.createInstance<Base>("Table").reset();
+
+    loader.unloadLibrary(plugins2_path);
+    classes = loader.getAvailableClassesSnapshot<Base>();
+    CHECK(hasClass(classes, "Dog") && !hasClass(classes, "Table"));
+    CHECK(!loader.isClassAvailable<Base>("Table"));
+    CHECK(throwsCreateClassException(loader, "Table"));
+
+    loader.reloadLibrary(plugins2_path);
+    classes = loader.getAvailableClassesSnapshot<Base>();
+    CHECK(hasClass(classes, "Table"));
+    CHECK(nullptr != loader.createInstance<Base>("Table"));
+
+    // The factory of Dog was cached by this thread, it must not be used once unbound
+    CHECK(nullptr != loader.createInstance<Base>("Dog"));
+    loader.unloadLibrary(plugins_path);
+    CHECK(!hasClass(loader.getAvailableClassesSnapshot<Base>(), "Dog"));
+    CHECK(throwsCreateClassException(loader, "Dog"));
+    loader.loadLibrary(plugins_path);
+    CHECK(nullptr != loader.createInstance<Base>("Dog"));
+  }
+
+  {
+    // Unloaded and loaded again on the same thread, the class is created from the factory of the
+    // new load
+    plugin_loader::PluginLoader loader(plugins_path);
+    CHECK(1 == loader.createUniqueInstance<LibraryId>("Id")->get());
+    CHECK(0 == loader.unloadLibrary());
+    loader.loadLibrary();
+    CHECK(1 == loader.createUniqueInstance<LibraryId>("Id")->get());
+    CHECK(nullptr != loader.createSharedInstance<Base>("Dog"));
+  }
+
+  {
+    // A class loader of another library in the same storage looks up the same cache entries, the
+    // registry generation tells them apart
+    alignas(plugin_loader::PluginLoader) unsigned char storage[sizeof(plugin_loader::PluginLoader)];
+    plugin_loader::PluginLoader * loader = new (storage) plugin_loader::PluginLoader(plugins_path);
+    CHECK(1 == loader->createUniqueInstance<LibraryId>("Id")->get());
+    loader->~PluginLoader();
+    loader = new (storage) plugin_loader::PluginLoader(plugins2_path);
+    CHECK(2 == loader->createUniqueInstance<LibraryId>("Id")->get());
+    loader->~PluginLoader();
+  }
+  return 0;
+}
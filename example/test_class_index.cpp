@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// With on-demand load/unload, creating a plugin by class name must only keep the library of its
+// class open
+
+#include <dlfcn.h>
+
+#include <memory>
+#include <string>
+
+#include "plugin_loader/multi_library_plugin_loader.hpp"
+
+#include "base.hpp"
+#include "check.hpp"
+
+bool isLibraryMapped(const std::string & library_path)
+{
+  void * handle = dlopen(library_path.c_str(), RTLD_LAZY | RTLD_NOLOAD);
+  if (nullptr == handle) {
+    return false;
+  }
+  dlclose(handle);
+  return true;
+}
+
+int main()
+{
+  const std::string plugins_path = TEST_PLUGINS_LIBRARY;
+  const std::string plugins2_path = TEST_PLUGINS2_LIBRARY;
+
+  plugin_loader::MultiLibraryPluginLoader loader(true);
+  loader.loadLibrary(plugins_path);
+  loader.loadLibrary(plugins2_path);
+  CHECK(!isLibraryMapped(plugins_path));
+  CHECK(!isLibraryMapped(plugins2_path));
+
+  // The classes are not known yet, the libraries opened only to find them are closed again
+  std::shared_ptr<Base> table = loader.createInstance<Base>("Table");
+  CHECK(isLibraryMapped(plugins2_path));
+  CHECK(!isLibraryMapped(plugins_path));
+  table.reset();
+  CHECK(!isLibraryMapped(plugins2_path));
+
+  // Both libraries are indexed by now, a creation opens the library of its class only
+  std::shared_ptr<Base> dog = loader.createInstance<Base>("Dog");
+  CHECK(isLibraryMapped(plugins_path));
+  CHECK(!isLibraryMapped(plugins2_path));
+  CHECK(loader.isClassAvailable<Base>("Table"));
+  CHECK(!isLibraryMapped(plugins2_path));
+  dog.reset();
+  CHECK(!isLibraryMapped(plugins_path));
+
+  // An unknown class opens no library for good
+  bool threw = false;
+  try {
+    loader.createInstance<Base>("Nope");
+  } catch (const plugin_loader::CreateClassException &) {
+    threw = true;
+  }
+  CHECK(threw);
+  CHECK(!isLibraryMapped(plugins_path));
+  CHECK(!isLibraryMapped(plugins2_path));
+  return 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Plugins whose destruction is deferred to the reaper thread are destroyed by the flushes
+
+#include <thread>
+#include <vector>
+
+#include "plugin_loader/library_reaper.hpp"
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "base.hpp"
+#include "check.hpp"
+
+int main()
+{
+  plugin_loader::setDeferredDestructionEnabled(true);
+
+  {
+    plugin_loader::PluginLoader loader(TEST_PLUGINS_LIBRARY, true);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back(
+        [&loader] {
+          for (int i = 0; i < 100; i++) {
+            loader.createInstance<Base>("Dog");
+          }
+        });
+    }
+    for (auto & thread : threads) {
+      thread.join();
+    }
+    plugin_loader::flushDeferredDestruction();
+    CHECK(0 == loader.getPluginInstanceCount());
+    CHECK(!loader.isLibraryLoaded());
+  }
+
+  {
+    // unloadLibrary() waits for the plugins its loader released
+    plugin_loader::PluginLoader loader(TEST_PLUGINS2_LIBRARY);
+    loader.createInstance<Base>("Table");
+    CHECK(0 == loader.unloadLibrary());
+    CHECK(0 == loader.getPluginInstanceCount());
+    CHECK(!loader.isLibraryLoaded());
+  }
+
+  {
+    // So does the destructor
+    plugin_loader::PluginLoader loader(TEST_PLUGINS_LIBRARY);
+    loader.createInstance<Base>("Cat");
+  }
+  CHECK(!plugin_loader::PluginLoader(TEST_PLUGINS_LIBRARY, true).isLibraryLoadedByAnyClassloader());
+  return 0;
+}
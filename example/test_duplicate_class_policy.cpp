@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// A class registered by several libraries must resolve to the library the DuplicateClassPolicy
+// prefers, the other ones staying reachable through qualified class names
+
+#include <string>
+
+#include "plugin_loader/duplicate_class_policy.hpp"
+#include "plugin_loader/multi_library_plugin_loader.hpp"
+#include "plugin_loader/registry_snapshot.hpp"
+
+#include "check.hpp"
+#include "library_id.hpp"
+
+const std::string plugins_path = TEST_PLUGINS_LIBRARY;
+const std::string plugins2_path = TEST_PLUGINS2_LIBRARY;
+
+int resolvedLibrary(plugin_loader::MultiLibraryPluginLoader & loader)
+{
+  return loader.createInstance<LibraryId>("Id")->get();
+}
+
+// Whether the class Id of a library is shadowed, according to the registry snapshot
+bool isShadowed(const std::string & library_path)
+{
+  int found = 0;
+  bool shadowed = false;
+  for (const plugin_loader::FactorySnapshot & factory :
+    plugin_loader::getRegistrySnapshot().factories)
+  {
+    if (factory.class_name == "Id" && factory.library_path == library_path) {
+      ++found;
+      shadowed = factory.shadowed;
+    }
+  }
+  CHECK(1 == found);
+  return shadowed;
+}
+
+int main()
+{
+  plugin_loader::MultiLibraryPluginLoader loader(false);
+  loader.loadLibrary(plugins_path);
+  loader.loadLibrary(plugins2_path);
+
+  CHECK(plugin_loader::DuplicateClassPolicy::LastRegisteredWins ==
+    plugin_loader::getDuplicateClassPolicy());
+  CHECK(2 == resolvedLibrary(loader));
+  CHECK(isShadowed(plugins_path));
+  CHECK(!isShadowed(plugins2_path));
+
+  plugin_loader::setDuplicateClassPolicy(plugin_loader::DuplicateClassPolicy::FirstRegisteredWins);
+  CHECK(1 == resolvedLibrary(loader));
+  CHECK(!isShadowed(plugins_path));
+  CHECK(isShadowed(plugins2_path));
+
+  // Ties go to the most recently loaded library
+  plugin_loader::setDuplicateClassPolicy(plugin_loader::DuplicateClassPolicy::LibraryPriority);
+  CHECK(2 == resolvedLibrary(loader));
+  plugin_loader::setLibraryPriority(plugins_path, 1);
+  CHECK(1 == plugin_loader::getLibraryPriority(plugins_path));
+  CHECK(1 == resolvedLibrary(loader));
+  CHECK(!isShadowed(plugins_path));
+  CHECK(isShadowed(plugins2_path));
+  plugin_loader::setLibraryPriority(plugins_path, -1);
+  CHECK(2 == resolvedLibrary(loader));
+
+  // The shadowed class stays reachable
+  const std::string qualified_name = plugin_loader::qualifiedClassName(plugins_path, "Id");
+  CHECK(1 == loader.createInstance<LibraryId>(qualified_name)->get());
+  CHECK(1 == loader.createInstance<LibraryId>("Id", plugins_path)->get());
+
+  // The shadowed class takes over when the library of the preferred one is unloaded
+  plugin_loader::setDuplicateClassPolicy(plugin_loader::DuplicateClassPolicy::LastRegisteredWins);
+  CHECK(0 == loader.unloadLibrary(plugins2_path));
+  CHECK(1 == resolvedLibrary(loader));
+  CHECK(!isShadowed(plugins_path));
+  return 0;
+}
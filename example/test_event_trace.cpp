@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// The lifecycle events of a library must be recorded in order, and survive the round trip through
+// dumpEventTrace() and convertEventTraceToChromeJson()
+
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "plugin_loader/event_trace.hpp"
+#include "plugin_loader/exceptions.hpp"
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "base.hpp"
+#include "check.hpp"
+
+using plugin_loader::TraceEvent;
+using plugin_loader::TraceEventType;
+
+std::string readFile(const std::string & path)
+{
+  std::ifstream in(path);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+// Finds the first event of a type from an index on, returns the number of events if none
+std::size_t findEvent(
+  const std::vector<TraceEvent> & events, std::size_t from, TraceEventType type,
+  const std::string & name)
+{
+  for (std::size_t i = from; i < events.size(); i++) {
+    if (events[i].type == type && plugin_loader::getTraceName(events[i].name_id) == name) {
+      return i;
+    }
+  }
+  return events.size();
+}
+
+std::size_t countOccurrences(const std::string & text, const std::string & part)
+{
+  std::size_t count = 0;
+  for (std::size_t pos = text.find(part); pos != std::string::npos;
+    pos = text.find(part, pos + 1))
+  {
+    count++;
+  }
+  return count;
+}
+
+int main()
+{
+  char directory_template[] = "/tmp/event_trace_testXXXXXX";
+  CHECK(nullptr != mkdtemp(directory_template));
+  const std::string directory = directory_template;
+  const std::string trace_path = directory + "/trace";
+  const std::string json_path = directory + "/trace.json";
+
+  CHECK(!plugin_loader::isEventTraceEnabled());
+  plugin_loader::enableEventTrace(256);
+  CHECK(plugin_loader::isEventTraceEnabled());
+  {
+    plugin_loader::PluginLoader loader(TEST_PLUGINS_LIBRARY);
+    loader.createSharedInstance<Base>("Dog").reset();
+    loader.unloadLibrary();
+  }
+  // A name that has to be escaped in JSON, with a known time and duration
+  plugin_loader::impl::recordTraceEvent(
+    TraceEventType::Create, "quote\" backslash\\ newline\n", 123456789, 5000);
+  plugin_loader::disableEventTrace();
+  plugin_loader::impl::recordTraceEvent(TraceEventType::Create, "not recorded", 0, 0);
+
+  const std::vector<TraceEvent> events = plugin_loader::getEventTrace();
+  const std::string library = TEST_PLUGINS_LIBRARY;
+  const std::size_t load = findEvent(events, 0, TraceEventType::LibraryLoad, library);
+  const std::size_t create = findEvent(events, load, TraceEventType::Create, "Dog");
+  const std::size_t destroy = findEvent(events, create, TraceEventType::Destroy, library);
+  const std::size_t unload = findEvent(events, destroy, TraceEventType::Unload, library);
+  CHECK(unload < events.size());
+  CHECK(findEvent(events, 0, TraceEventType::Dlopen, library) < events.size());
+  CHECK(findEvent(events, 0, TraceEventType::Register, "Dog") < events.size());
+  CHECK(events.size() == findEvent(events, 0, TraceEventType::Create, "not recorded"));
+  const TraceEvent & escaped = events.back();
+  CHECK(TraceEventType::Create == escaped.type);
+  CHECK(123456789 == escaped.timestamp_ns && 5000 == escaped.duration_ns);
+  for (const TraceEvent & event : events) {
+    CHECK(event.duration_ns >= 0);
+    CHECK(escaped.thread_id == event.thread_id);
+  }
+
+  // Every event becomes a complete event of the Chrome trace named after its type and name, times
+  // in microseconds
+  plugin_loader::dumpEventTrace(trace_path);
+  plugin_loader::convertEventTraceToChromeJson(trace_path, json_path);
+  const std::string json = readFile(json_path);
+  CHECK(0 == json.find("{"));
+  CHECK(events.size() == countOccurrences(json, "\"ph\":\"X\""));
+  CHECK(std::string::npos != json.find("{\"name\":\"Create Dog\",\"cat\":\"plugin_loader\","));
+  char expected[160];
+  snprintf(
+    expected, sizeof(expected),
+    "{\"name\":\"Create quote\\\" backslash\\\\ newline\\u000a\","
+    "\"cat\":\"plugin_loader\",\"ph\":\"X\",\"ts\":123456.789,\"dur\":5.000,\"pid\":1,\"tid\":%u}",
+    escaped.thread_id);
+  CHECK(std::string::npos != json.find(expected));
+
+  // The ring keeps the newest events once full
+  plugin_loader::clearEventTrace();
+  CHECK(plugin_loader::getEventTrace().empty());
+  plugin_loader::enableEventTrace();
+  for (int i = 0; i < 300; i++) {
+    plugin_loader::impl::recordTraceEvent(TraceEventType::Create, "Dog", i, 0);
+  }
+  plugin_loader::disableEventTrace();
+  const std::vector<TraceEvent> ring = plugin_loader::getEventTrace();
+  CHECK(256 == ring.size());
+  CHECK(44 == ring.front().timestamp_ns && 299 == ring.back().timestamp_ns);
+
+  // Anything but a trace is refused
+  bool threw = false;
+  try {
+    plugin_loader::convertEventTraceToChromeJson(json_path, trace_path);
+  } catch (const plugin_loader::PluginLoaderException &) {
+    threw = true;
+  }
+  CHECK(threw);
+
+  CHECK(0 == unlink(trace_path.c_str()));
+  CHECK(0 == unlink(json_path.c_str()));
+  CHECK(0 == rmdir(directory.c_str()));
+  return 0;
+}
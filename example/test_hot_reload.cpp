@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// reloadLibrary() must rebind a library to the new version of its file while the plugins created
+// before keep running the previous version
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "plugin_loader/multi_library_plugin_loader.hpp"
+
+#include "base.hpp"
+#include "check.hpp"
+#include "library_id.hpp"
+
+// Replaces the file by renaming over it, as a deployment does, the mapped file is left intact
+void deployFile(const std::string & from, const std::string & to)
+{
+  const std::string staged = to + ".new";
+  {
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(staged, std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+    CHECK(in && out);
+  }
+  CHECK(0 == rename(staged.c_str(), to.c_str()));
+}
+
+bool hasClass(const std::vector<std::string> & classes, const std::string & name)
+{
+  return std::find(classes.begin(), classes.end(), name) != classes.end();
+}
+
+int main()
+{
+  char directory_template[] = "/tmp/hot_reload_testXXXXXX";
+  CHECK(nullptr != mkdtemp(directory_template));
+  const std::string directory = directory_template;
+  const std::string library_path = directory + "/libreload.so";
+  deployFile(TEST_PLUGINS_LIBRARY, library_path);
+
+  {
+    plugin_loader::MultiLibraryPluginLoader loader(false);
+    loader.loadLibrary(library_path);
+    std::shared_ptr<LibraryId> old_id = loader.createSharedInstance<LibraryId>("Id");
+    CHECK(1 == old_id->get());
+
+    // New creations use the new version, the plugin created before keeps the previous one
+    deployFile(TEST_PLUGINS2_LIBRARY, library_path);
+    loader.reloadLibrary(library_path);
+    std::shared_ptr<LibraryId> new_id = loader.createSharedInstance<LibraryId>("Id");
+    CHECK(2 == new_id->get());
+    CHECK(1 == old_id->get());
+    std::vector<std::string> classes = loader.getAvailableClassesForLibrary<Base>(library_path);
+    CHECK(hasClass(classes, "Table"));
+    CHECK(!hasClass(classes, "Dog"));
+    CHECK(loader.isClassAvailable<Base>("Table"));
+    CHECK(!loader.isClassAvailable<Base>("Dog"));
+    old_id.reset();
+
+    // Reloading while the plugins of the current version live swaps back as well
+    deployFile(TEST_PLUGINS_LIBRARY, library_path);
+    loader.reloadLibrary(library_path);
+    CHECK(1 == loader.createUniqueInstance<LibraryId>("Id")->get());
+    CHECK(2 == new_id->get());
+    CHECK(loader.isClassAvailable<Base>("Dog"));
+    CHECK(!loader.isClassAvailable<Base>("Table"));
+    new_id.reset();
+
+    // A failed reload keeps the version in use
+    std::ofstream(library_path + ".new", std::ios::trunc) << "not a library";
+    CHECK(0 == rename((library_path + ".new").c_str(), library_path.c_str()));
+    bool threw = false;
+    try {
+      loader.reloadLibrary(library_path);
+    } catch (const plugin_loader::LibraryLoadException &) {
+      threw = true;
+    }
+    CHECK(threw);
+    CHECK(1 == loader.createUniqueInstance<LibraryId>("Id")->get());
+  }
+
+  CHECK(0 == unlink(library_path.c_str()));
+  CHECK(0 == rmdir(directory.c_str()));
+  return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Tracked plugins must be reported while they live, oldest first, and forgotten once destroyed
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plugin_loader/multi_library_plugin_loader.hpp"
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "base.hpp"
+#include "check.hpp"
+
+// Keeps the creation times of consecutive plugins apart
+void waitForClockTick()
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+int main()
+{
+  plugin_loader::PluginLoader loader(TEST_PLUGINS_LIBRARY);
+  CHECK(!loader.isInstanceTrackingEnabled());
+  std::shared_ptr<Base> untracked = loader.createSharedInstance<Base>("Dog");
+  CHECK(loader.getLiveInstances().empty());
+
+  loader.setInstanceTrackingEnabled(true);
+  std::shared_ptr<Base> cat = loader.createSharedInstance<Base>("Cat");
+  waitForClockTick();
+  plugin_loader::PluginLoader::UniquePtr<Base> cow = loader.createUniqueInstance<Base>("Cow");
+  waitForClockTick();
+  std::shared_ptr<Base> duck;
+  std::thread::id creating_thread;
+  std::thread creator([&loader, &duck, &creating_thread]() {
+      duck = loader.createSharedInstance<Base>("Duck");
+      creating_thread = std::this_thread::get_id();
+    });
+  creator.join();
+
+  std::vector<plugin_loader::InstanceInfo> instances = loader.getLiveInstances();
+  CHECK(3 == instances.size());
+  CHECK("Cat" == instances[0].class_name && cat.get() == instances[0].object);
+  CHECK("Cow" == instances[1].class_name && cow.get() == instances[1].object);
+  CHECK("Duck" == instances[2].class_name && duck.get() == instances[2].object);
+  CHECK(std::this_thread::get_id() == instances[0].creating_thread);
+  CHECK(creating_thread == instances[2].creating_thread);
+  CHECK(TEST_PLUGINS_LIBRARY == instances[0].library_path);
+  CHECK(instances[0].creation_time < instances[1].creation_time);
+  CHECK(instances[1].creation_time < instances[2].creation_time);
+
+  // Destroyed plugins are removed, from any thread
+  cow.reset();
+  std::thread([&duck]() {duck.reset();}).join();
+  instances = loader.getLiveInstances();
+  CHECK(1 == instances.size());
+  CHECK("Cat" == instances[0].class_name);
+
+  // Disabling only stops tracking new plugins
+  loader.setInstanceTrackingEnabled(false);
+  std::shared_ptr<Base> sheep = loader.createSharedInstance<Base>("Sheep");
+  CHECK(1 == loader.getLiveInstances().size());
+  cat.reset();
+  CHECK(loader.getLiveInstances().empty());
+  sheep.reset();
+  untracked.reset();
+
+  // A MultiLibraryPluginLoader enables tracking for the libraries it binds later as well
+  plugin_loader::MultiLibraryPluginLoader multi_loader(false);
+  multi_loader.setInstanceTrackingEnabled(true);
+  multi_loader.loadLibrary(TEST_PLUGINS_LIBRARY);
+  std::shared_ptr<Base> dog = multi_loader.createInstance<Base>("Dog");
+  instances = multi_loader.getLiveInstances(TEST_PLUGINS_LIBRARY);
+  CHECK(1 == instances.size());
+  CHECK("Dog" == instances[0].class_name && dog.get() == instances[0].object);
+  dog.reset();
+  CHECK(multi_loader.getLiveInstances(TEST_PLUGINS_LIBRARY).empty());
+  return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Each isolated loader must get a copy of the library of its own, with its own static state
+
+#include <string>
+
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "check.hpp"
+#include "counter.hpp"
+
+int main()
+{
+  const std::string library_path = TEST_PLUGINS2_LIBRARY;
+
+  {
+    plugin_loader::PluginLoader first(library_path, false, true);
+    plugin_loader::PluginLoader second(library_path, false, true);
+    plugin_loader::PluginLoader shared(library_path);
+
+    // The copies are told apart by their keys, but they are loaded from the same file
+    CHECK(first.getLibraryPath() == library_path);
+    CHECK(second.getLibraryPath() == library_path);
+    CHECK(first.getLibraryKey() != second.getLibraryKey());
+    CHECK(first.getLibraryKey() != library_path);
+    CHECK(shared.getLibraryKey() == library_path);
+
+    auto first_counter = first.createInstance<Counter>("StaticCounter");
+    auto second_counter = second.createInstance<Counter>("StaticCounter");
+    auto shared_counter = shared.createInstance<Counter>("StaticCounter");
+    CHECK(1 == first_counter->increment());
+    CHECK(2 == first_counter->increment());
+    CHECK(1 == second_counter->increment());
+    CHECK(1 == shared_counter->increment());
+
+    CHECK(first.isClassAvailable<Counter>("StaticCounter"));
+    CHECK(1 == first.getAvailableClasses<Counter>().size());
+  }
+
+  {
+    // Unloading an isolated copy drops its state, the next load starts from a new copy
+    plugin_loader::PluginLoader loader(library_path, true, true);
+    for (int i = 0; i < 2; i++) {
+      auto counter = loader.createInstance<Counter>("StaticCounter");
+      CHECK(1 == counter->increment());
+    }
+    CHECK(!loader.isLibraryLoaded());
+  }
+  return 0;
+}
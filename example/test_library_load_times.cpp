@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// getLibraryLoadTimes() must report the load time breakdown of every library opened, and
+// getSlowestLibrariesReport() the slowest ones first
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "plugin_loader/metrics.hpp"
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "check.hpp"
+
+const plugin_loader::LibraryLoadTimes * findLoadTimes(
+  const std::vector<plugin_loader::LibraryLoadTimes> & load_times,
+  const std::string & library_path)
+{
+  const plugin_loader::LibraryLoadTimes * found = nullptr;
+  for (const plugin_loader::LibraryLoadTimes & library : load_times) {
+    if (library.library_path == library_path) {
+      CHECK(nullptr == found);  // Reported once
+      found = &library;
+    }
+  }
+  return found;
+}
+
+void checkBreakdown(const plugin_loader::LibraryLoadTimes & library, std::size_t factory_count)
+{
+  CHECK(factory_count == library.factory_count);
+  CHECK(library.dlopen_ns > 0 && library.registration_ns > 0);
+  CHECK(library.registration_ns <= library.dlopen_ns);
+  CHECK(library.dlopen_ns + library.revive_ns + library.purge_ns <= library.total_ns);
+}
+
+int main()
+{
+  const std::string plugins_path = TEST_PLUGINS_LIBRARY;
+  const std::string plugins2_path = TEST_PLUGINS2_LIBRARY;
+  CHECK(nullptr == findLoadTimes(plugin_loader::getLibraryLoadTimes(), plugins_path));
+
+  plugin_loader::PluginLoader loader(plugins_path);
+  plugin_loader::PluginLoader loader2(plugins2_path);
+  std::vector<plugin_loader::LibraryLoadTimes> load_times = plugin_loader::getLibraryLoadTimes();
+  const plugin_loader::LibraryLoadTimes * plugins = findLoadTimes(load_times, plugins_path);
+  const plugin_loader::LibraryLoadTimes * plugins2 = findLoadTimes(load_times, plugins2_path);
+  CHECK(nullptr != plugins && nullptr != plugins2);
+  checkBreakdown(*plugins, 6);  // Dog, Cat, Duck, Cow, Sheep and Id
+  checkBreakdown(*plugins2, 4);  // Table, StaticCounter, Buffer and Id
+  const std::int64_t plugins_total_ns = plugins->total_ns;
+
+  // Binding a library already open is not a load
+  {
+    plugin_loader::PluginLoader same_library(plugins_path);
+    load_times = plugin_loader::getLibraryLoadTimes();
+    plugins = findLoadTimes(load_times, plugins_path);
+    CHECK(nullptr != plugins && plugins_total_ns == plugins->total_ns);
+  }
+
+  // A library loaded again is reported for its last load only. Its factories are registered again,
+  // or revived from the graveyard if the library stayed mapped.
+  loader.unloadLibrary();
+  loader.loadLibrary();
+  load_times = plugin_loader::getLibraryLoadTimes();
+  plugins = findLoadTimes(load_times, plugins_path);
+  CHECK(nullptr != plugins && plugins_total_ns != plugins->total_ns);
+  CHECK(6 == plugins->factory_count);
+
+  // The report lists the slowest libraries first, with a header line
+  plugins2 = findLoadTimes(load_times, plugins2_path);
+  const bool plugins_slower = plugins->total_ns > plugins2->total_ns;
+  const std::string & slowest_path = plugins_slower ? plugins_path : plugins2_path;
+  const std::string & fastest_path = plugins_slower ? plugins2_path : plugins_path;
+  std::string report = plugin_loader::getSlowestLibrariesReport(1);
+  CHECK(0 == report.find("    total(ms)"));
+  CHECK(std::string::npos != report.find(slowest_path + "\n"));
+  CHECK(std::string::npos == report.find(fastest_path + "\n"));
+  report = plugin_loader::getSlowestLibrariesReport();
+  CHECK(report.find(slowest_path + "\n") < report.find(fastest_path + "\n"));
+  CHECK(std::string::npos != report.find(fastest_path + "\n"));
+  return 0;
+}
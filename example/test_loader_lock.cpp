@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Creations hold the lock of MultiLibraryPluginLoader shared and must run concurrently with each
+// other, while loads and unloads hold it exclusively and must not be starved by them
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plugin_loader/multi_library_plugin_loader.hpp"
+
+#include "base.hpp"
+#include "check.hpp"
+
+int main()
+{
+  const std::string plugins_path = TEST_PLUGINS_LIBRARY;
+  const std::string plugins2_path = TEST_PLUGINS2_LIBRARY;
+  const int reload_count = 50;
+
+  plugin_loader::MultiLibraryPluginLoader loader(false);
+  loader.loadLibrary(plugins_path);
+
+  // The creating threads keep going until the loads and unloads are done, so a starved writer
+  // never finishes
+  std::atomic<bool> done(false);
+  std::atomic<int> creations(0);
+  std::vector<std::thread> creators;
+  for (int i = 0; i < 4; i++) {
+    creators.emplace_back([&loader, &done, &creations, &plugins_path]() {
+        while (!done.load()) {
+          std::shared_ptr<Base> dog = loader.createInstance<Base>("Dog");
+          plugin_loader::PluginLoader::UniquePtr<Base> cat =
+            loader.createUniqueInstance<Base>("Cat", plugins_path);
+          CHECK(loader.isClassAvailable<Base>("Dog"));
+          creations += 2;
+        }
+      });
+  }
+
+  for (int i = 0; i < reload_count; i++) {
+    loader.loadLibrary(plugins2_path);
+    CHECK(loader.isLibraryAvailable(plugins2_path));
+    loader.createInstance<Base>("Table").reset();
+    CHECK(0 == loader.unloadLibrary(plugins2_path));
+    CHECK(!loader.isLibraryAvailable(plugins2_path));
+  }
+  done.store(true);
+  for (std::thread & creator : creators) {
+    creator.join();
+  }
+  CHECK(creations.load() > 0);
+
+  // Both kinds of lookups keep working once the threads are gone
+  CHECK(!loader.isClassAvailable<Base>("Table"));
+  CHECK(nullptr != loader.createInstance<Base>("Dog"));
+  return 0;
+}
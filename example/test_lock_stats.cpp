@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// getLockStats() must count the acquisitions of profiled mutexes, and the waits and hold times of
+// the contended ones
+
+// Profiles the mutexes of this test whether or not plugin_loader was built with the
+// PLUGIN_LOADER_LOCK_PROFILING option. Only a mutex type of the test is profiled, so that the
+// instantiations of ProfiledMutex are the same as in plugin_loader.
+#ifndef PLUGIN_LOADER_LOCK_PROFILING
+#define PLUGIN_LOADER_LOCK_PROFILING
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plugin_loader/lock_profiler.hpp"
+
+#include "check.hpp"
+
+class TestMutex : public std::recursive_mutex
+{
+};
+
+const plugin_loader::LockStats * findStats(
+  const std::vector<plugin_loader::LockStats> & stats, const std::string & name)
+{
+  for (const plugin_loader::LockStats & entry : stats) {
+    if (entry.name == name) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+int main()
+{
+  const std::int64_t hold_ns = std::chrono::nanoseconds(std::chrono::milliseconds(20)).count();
+  plugin_loader::impl::ProfiledMutex<TestMutex> quiet("test.quiet");
+  plugin_loader::impl::ProfiledMutex<TestMutex> busy("test.busy");
+  // Mutexes sharing a name share their statistics
+  plugin_loader::impl::ProfiledMutex<TestMutex> busy_too("test.busy");
+
+  // Recursive acquisitions count once
+  for (int i = 0; i < 3; i++) {
+    std::lock_guard<plugin_loader::impl::ProfiledMutex<TestMutex>> lock(quiet);
+    std::lock_guard<plugin_loader::impl::ProfiledMutex<TestMutex>> recursive_lock(quiet);
+  }
+  CHECK(quiet.try_lock());
+  quiet.unlock();
+
+  // The main thread waits for the one holding the mutex
+  std::atomic<bool> held(false);
+  std::thread holder([&busy, &held, hold_ns]() {
+      std::lock_guard<plugin_loader::impl::ProfiledMutex<TestMutex>> lock(busy);
+      held.store(true);
+      std::this_thread::sleep_for(std::chrono::nanoseconds(hold_ns));
+    });
+  while (!held.load()) {
+    std::this_thread::yield();
+  }
+  busy.lock();
+  busy.unlock();
+  holder.join();
+  busy_too.lock();
+  busy_too.unlock();
+
+  std::vector<plugin_loader::LockStats> stats = plugin_loader::getLockStats();
+  const plugin_loader::LockStats * quiet_stats = findStats(stats, "test.quiet");
+  CHECK(nullptr != quiet_stats);
+  CHECK(4 == quiet_stats->acquisitions);
+  CHECK(0 == quiet_stats->contended_acquisitions && 0 == quiet_stats->wait_ns);
+  const plugin_loader::LockStats * busy_stats = findStats(stats, "test.busy");
+  CHECK(nullptr != busy_stats);
+  CHECK(3 == busy_stats->acquisitions);
+  CHECK(1 == busy_stats->contended_acquisitions);
+  CHECK(busy_stats->wait_ns > 0 && busy_stats->wait_ns == busy_stats->max_wait_ns);
+  CHECK(busy_stats->max_hold_ns >= hold_ns && busy_stats->hold_ns >= busy_stats->max_hold_ns);
+  // The most waited for first
+  CHECK(busy_stats == &stats.front());
+
+  plugin_loader::resetLockStats();
+  stats = plugin_loader::getLockStats();
+  busy_stats = findStats(stats, "test.busy");
+  CHECK(nullptr != busy_stats);
+  CHECK(0 == busy_stats->acquisitions && 0 == busy_stats->wait_ns && 0 == busy_stats->hold_ns);
+  return 0;
+}
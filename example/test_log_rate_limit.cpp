@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// A call site must output at most the messages the rate limit allows per interval, and report
+// how many it suppressed
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plugin_loader/console.h"
+
+#include "check.hpp"
+
+class RecordingOutputHandler : public plugin_loader::OutputHandler
+{
+public:
+  virtual void log(const plugin_loader::LogRecord & record)
+  {
+    messages.push_back(std::string(record.text, record.size));
+  }
+
+  std::vector<std::string> messages;
+};
+
+void logWarnings(int count)
+{
+  for (int i = 0; i < count; i++) {
+    plugin_loader::logWarn("warning %d", i);
+  }
+}
+
+int main()
+{
+  RecordingOutputHandler handler;
+  plugin_loader::useOutputHandler(&handler);
+  plugin_loader::setLogRateLimit(3, std::chrono::milliseconds(100));
+
+  logWarnings(100);
+  CHECK(3 == handler.messages.size());
+  CHECK("warning 2" == handler.messages.back());
+
+  // Errors are never limited
+  for (int i = 0; i < 10; i++) {
+    plugin_loader::logError("error %d", i);
+  }
+  CHECK(13 == handler.messages.size());
+
+  plugin_loader::flushSuppressedLogMessages();
+  CHECK(14 == handler.messages.size());
+  CHECK("97 similar message(s) from this call site were suppressed" == handler.messages.back());
+  // Nothing more to report
+  plugin_loader::flushSuppressedLogMessages();
+  CHECK(14 == handler.messages.size());
+
+  // Past 16 suppressed messages, the end of the interval is only noticed every 16 messages. The
+  // next interval then reports what was suppressed since the flush and lets messages through.
+  logWarnings(5);
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  handler.messages.clear();
+  logWarnings(16);
+  CHECK(4 == handler.messages.size());
+  CHECK("15 similar message(s) from this call site were suppressed" == handler.messages[0]);
+  CHECK("warning 10" == handler.messages[1]);
+  CHECK("warning 12" == handler.messages[3]);
+
+  plugin_loader::setLogRateLimit(0, std::chrono::milliseconds(100));
+  handler.messages.clear();
+  logWarnings(100);
+  CHECK(100 == handler.messages.size());
+
+  plugin_loader::restorePreviousOutputHandler();
+  return 0;
+}
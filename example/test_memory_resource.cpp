@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// The memory resource overloads must allocate plugins, and the control blocks of shared plugins,
+// from the given resource and give the memory back to it when they are destroyed
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "plugin_loader/multi_library_plugin_loader.hpp"
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "check.hpp"
+#include "pooled.hpp"
+
+#ifdef PLUGIN_LOADER_HAS_MEMORY_RESOURCE
+
+#include <memory_resource>
+
+// Counts what is allocated from it and not given back yet
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+  std::size_t allocations = 0;
+  std::size_t outstanding_bytes = 0;
+
+private:
+  void * do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    ++allocations;
+    outstanding_bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void * p, std::size_t bytes, std::size_t alignment) override
+  {
+    outstanding_bytes -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+int main()
+{
+  int destructions = 0;
+  CountingResource resource;
+  {
+    plugin_loader::PluginLoader loader(TEST_PLUGINS2_LIBRARY);
+
+    // The object and the control block come from the resource
+    std::shared_ptr<Pooled> shared = loader.createSharedInstance<Pooled>("Buffer", &resource);
+    shared->destructions = &destructions;
+    CHECK(2 == resource.allocations);
+    CHECK(resource.outstanding_bytes >= sizeof(Pooled));
+    CHECK(1 == loader.getPluginInstanceCount());
+    std::shared_ptr<Pooled> copy = shared;
+    shared.reset();
+    CHECK(0 == destructions);
+    copy.reset();
+    CHECK(1 == destructions);
+    CHECK(0 == resource.outstanding_bytes);
+    CHECK(0 == loader.getPluginInstanceCount());
+
+    plugin_loader::PluginLoader::UniquePtr<Pooled> unique =
+      loader.createUniqueInstance<Pooled>("Buffer", &resource);
+    unique->destructions = &destructions;
+    CHECK(3 == resource.allocations);
+    CHECK(resource.outstanding_bytes >= sizeof(Pooled));
+    unique.reset();
+    CHECK(2 == destructions);
+    CHECK(0 == resource.outstanding_bytes);
+  }
+
+  // Plugins looked up by class name, with on-demand loading: the library stays loaded while a
+  // plugin allocated from the resource lives
+  plugin_loader::MultiLibraryPluginLoader loader(true);
+  loader.loadLibrary(TEST_PLUGINS2_LIBRARY);
+  std::shared_ptr<Pooled> shared = loader.createInstance<Pooled>("Buffer", &resource);
+  plugin_loader::PluginLoader::UniquePtr<Pooled> unique =
+    loader.createUniqueInstance<Pooled>("Buffer", &resource);
+  shared->destructions = &destructions;
+  unique->destructions = &destructions;
+  CHECK(6 == resource.allocations);
+  CHECK(loader.isLibraryAvailable(TEST_PLUGINS2_LIBRARY));
+  unique.reset();
+  shared.reset();
+  CHECK(4 == destructions);
+  CHECK(0 == resource.outstanding_bytes);
+  return 0;
+}
+
+#else
+
+int main()
+{
+  return 77;  // Skipped, std::pmr is not available
+}
+
+#endif
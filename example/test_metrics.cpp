@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// The counters and latency histograms of getMetrics() must follow a load, create, destroy and
+// unload cycle, whichever thread records them
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plugin_loader/metrics.hpp"
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "base.hpp"
+#include "check.hpp"
+
+const plugin_loader::LibraryMetrics * findLibrary(
+  const plugin_loader::Metrics & metrics, const std::string & library_path)
+{
+  for (const plugin_loader::LibraryMetrics & library : metrics.libraries) {
+    if (library.library_path == library_path) {
+      return &library;
+    }
+  }
+  return nullptr;
+}
+
+const plugin_loader::ClassMetrics * findClass(
+  const plugin_loader::Metrics & metrics, const std::string & class_name)
+{
+  for (const plugin_loader::ClassMetrics & class_metrics : metrics.classes) {
+    if (class_metrics.class_name == class_name) {
+      return &class_metrics;
+    }
+  }
+  return nullptr;
+}
+
+int main()
+{
+  CHECK(1000 == plugin_loader::LatencyHistogram::getBucketUpperBound(0));
+  CHECK(2000 == plugin_loader::LatencyHistogram::getBucketUpperBound(1));
+  CHECK(std::numeric_limits<std::int64_t>::max() ==
+    plugin_loader::LatencyHistogram::getBucketUpperBound(
+      plugin_loader::LatencyHistogram::kBucketCount - 1));
+
+  plugin_loader::resetMetrics();
+  {
+    plugin_loader::PluginLoader loader(TEST_PLUGINS_LIBRARY);
+    std::vector<std::shared_ptr<Base>> plugins;
+    plugins.push_back(loader.createSharedInstance<Base>("Dog"));
+    plugins.push_back(loader.createSharedInstance<Base>("Cat"));
+    // Threads count in shards of their own, which getMetrics() sums up
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; i++) {
+      threads.emplace_back([&loader]() {loader.createSharedInstance<Base>("Dog").reset();});
+    }
+    for (std::thread & thread : threads) {
+      thread.join();
+    }
+    bool threw = false;
+    try {
+      loader.createSharedInstance<Base>("Nope");
+    } catch (const plugin_loader::CreateClassException &) {
+      threw = true;
+    }
+    CHECK(threw);
+    plugins.clear();
+    loader.unloadLibrary();
+  }
+
+  plugin_loader::Metrics metrics = plugin_loader::getMetrics();
+  const plugin_loader::LibraryMetrics * library = findLibrary(metrics, TEST_PLUGINS_LIBRARY);
+  CHECK(nullptr != library);
+  CHECK(1 == library->loads && 0 == library->load_failures);
+  CHECK(1 == library->unloads && 0 == library->unload_failures);
+  CHECK(5 == library->creations && 1 == library->creation_failures);
+  CHECK(5 == library->destructions);
+  const plugin_loader::ClassMetrics * dog = findClass(metrics, "Dog");
+  CHECK(nullptr != dog && 4 == dog->creations && 0 == dog->creation_failures);
+  const plugin_loader::ClassMetrics * cat = findClass(metrics, "Cat");
+  CHECK(nullptr != cat && 1 == cat->creations);
+  const plugin_loader::ClassMetrics * nope = findClass(metrics, "Nope");
+  CHECK(nullptr != nope && 0 == nope->creations && 1 == nope->creation_failures);
+
+  // Failed creations are timed as well
+  const plugin_loader::LatencyHistogram & create_instance = metrics.create_instance;
+  CHECK(6 == create_instance.count);
+  std::uint64_t bucket_sum = 0;
+  for (std::uint64_t bucket : create_instance.buckets) {
+    bucket_sum += bucket;
+  }
+  CHECK(create_instance.count == bucket_sum);
+  CHECK(create_instance.max_ns > 0 && create_instance.total_ns >= create_instance.max_ns);
+  CHECK(create_instance.getPercentileUpperBound(50) > 0);
+  CHECK(create_instance.getPercentileUpperBound(50) <=
+    create_instance.getPercentileUpperBound(100));
+  CHECK(1 == metrics.dlopen.count);
+  CHECK(6 == metrics.registration.count);  // Dog, Cat, Duck, Cow, Sheep and Id
+  CHECK(metrics.registry_lock_wait.count > 0);
+
+  // Reset zeroes the values, the library and its classes stay listed
+  plugin_loader::resetMetrics();
+  metrics = plugin_loader::getMetrics();
+  library = findLibrary(metrics, TEST_PLUGINS_LIBRARY);
+  CHECK(nullptr != library && 0 == library->loads && 0 == library->creations);
+  dog = findClass(metrics, "Dog");
+  CHECK(nullptr != dog && 0 == dog->creations);
+  CHECK(0 == metrics.create_instance.count && 0 == metrics.create_instance.max_ns);
+  CHECK(0 == metrics.create_instance.getPercentileUpperBound(50));
+  return 0;
+}
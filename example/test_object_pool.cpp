@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// createPooledInstance() must recycle released plugins after resetting them, destroy the ones
+// beyond the capacity of the pool, and destroy the pooled ones before the library is unloaded
+
+#include <string>
+
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "check.hpp"
+#include "pooled.hpp"
+
+using PooledPtr = plugin_loader::PluginLoader::UniquePtr<Pooled>;
+
+int main()
+{
+  int destructions = 0;
+  plugin_loader::PluginLoader loader(TEST_PLUGINS2_LIBRARY);
+
+  // A released plugin is reset and handed out again instead of destroyed
+  PooledPtr first = loader.createPooledInstance<Pooled>("Buffer");
+  first->destructions = &destructions;
+  first->uses = 3;
+  Pooled * recycled = first.get();
+  first.reset();
+  CHECK(0 == destructions);
+  CHECK(0 == loader.getPluginInstanceCount());
+  first = loader.createPooledInstance<Pooled>("Buffer");
+  CHECK(recycled == first.get());
+  CHECK(0 == first->uses);
+  CHECK(&destructions == first->destructions);
+
+  // The pool being empty, a new plugin is created
+  PooledPtr second = loader.createPooledInstance<Pooled>("Buffer");
+  PooledPtr third = loader.createPooledInstance<Pooled>("Buffer");
+  CHECK(recycled != second.get() && second.get() != third.get());
+  second->destructions = &destructions;
+  third->destructions = &destructions;
+
+  // With a capacity of one the thread keeps one plugin, the overflow another one, the third one
+  // is destroyed
+  loader.setObjectPoolCapacity(1);
+  first.reset();
+  second.reset();
+  third.reset();
+  CHECK(1 == destructions);
+  CHECK(0 == loader.getPluginInstanceCount());
+
+  // The pooled plugins are destroyed while their code is still mapped
+  CHECK(0 == loader.unloadLibrary());
+  CHECK(3 == destructions);
+  CHECK(!loader.isLibraryLoaded());
+
+  // Pooling disabled, released plugins are destroyed right away
+  loader.loadLibrary();
+  loader.setObjectPoolCapacity(0);
+  first = loader.createPooledInstance<Pooled>("Buffer");
+  first->destructions = &destructions;
+  first.reset();
+  CHECK(4 == destructions);
+  return 0;
+}
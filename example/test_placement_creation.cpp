@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// createInstanceIn() must construct plugins in the storage of the caller and only run their
+// destructor when they are destroyed
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "plugin_loader/plugin_loader.hpp"
+
+#include "check.hpp"
+#include "pooled.hpp"
+
+using PlacedPtr = plugin_loader::PluginLoader::UniquePtr<Pooled>;
+
+bool throwsCreateClassException(
+  plugin_loader::PluginLoader & loader, void * storage, std::size_t size)
+{
+  try {
+    loader.createInstanceIn<Pooled>("Buffer", storage, size);
+  } catch (const plugin_loader::CreateClassException &) {
+    return true;
+  }
+  return false;
+}
+
+int main()
+{
+  int destructions = 0;
+  plugin_loader::PluginLoader loader(TEST_PLUGINS2_LIBRARY);
+
+  const plugin_loader::ObjectLayout layout = loader.getObjectLayout<Pooled>("Buffer");
+  CHECK(layout.size >= sizeof(Pooled));
+  CHECK(layout.alignment >= alignof(Pooled));
+  CHECK(0 == loader.getPluginInstanceCount());
+
+  // Several plugins side by side in one slab
+  const std::size_t stride = (layout.size + layout.alignment - 1) / layout.alignment *
+    layout.alignment;
+  alignas(std::max_align_t) unsigned char slab[4 * 64];
+  CHECK(4 * stride <= sizeof(slab));
+  PlacedPtr placed[4];
+  for (std::size_t i = 0; i < 4; i++) {
+    placed[i] = loader.createInstanceIn<Pooled>("Buffer", slab + i * stride, stride);
+    CHECK(static_cast<void *>(placed[i].get()) == slab + i * stride);
+    placed[i]->destructions = &destructions;
+    placed[i]->uses = static_cast<int>(i);
+  }
+  CHECK(4 == loader.getPluginInstanceCount());
+  for (std::size_t i = 0; i < 4; i++) {
+    CHECK(static_cast<int>(i) == placed[i]->uses);
+  }
+
+  // Destroying runs the destructor and keeps the storage usable
+  placed[1].reset();
+  CHECK(1 == destructions);
+  CHECK(3 == loader.getPluginInstanceCount());
+  placed[1] = loader.createInstanceIn<Pooled>("Buffer", slab + stride, stride);
+  CHECK(0 == placed[1]->uses);
+  placed[1]->destructions = &destructions;
+  for (PlacedPtr & ptr : placed) {
+    ptr.reset();
+  }
+  CHECK(5 == destructions);
+  CHECK(0 == loader.getPluginInstanceCount());
+
+  // Storage too small or misaligned is refused
+  CHECK(throwsCreateClassException(loader, slab, layout.size - 1));
+  if (layout.alignment > 1) {
+    CHECK(throwsCreateClassException(loader, slab + 1, sizeof(slab) - 1));
+  }
+  CHECK(0 == loader.getPluginInstanceCount());
+  return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// A PluginIndex must survive a round trip through its file and only reopen modified libraries
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <typeinfo>
+
+#include "plugin_loader/plugin_index.hpp"
+
+#include "base.hpp"
+#include "check.hpp"
+
+void copyFile(const std::string & from, const std::string & to)
+{
+  std::ifstream in(from, std::ios::binary);
+  std::ofstream out(to, std::ios::binary | std::ios::trunc);
+  out << in.rdbuf();
+  CHECK(in && out);
+}
+
+bool hasClass(const plugin_loader::PluginIndex::LibraryEntry & library, const std::string & name)
+{
+  return std::any_of(library.classes.begin(), library.classes.end(),
+           [&name](const plugin_loader::PluginIndex::ClassEntry & entry) {
+             return entry.class_name == name && entry.base_class_name == typeid(Base).name();
+           });
+}
+
+bool isSameIndex(const plugin_loader::PluginIndex & a, const plugin_loader::PluginIndex & b)
+{
+  if (a.getLibraries().size() != b.getLibraries().size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < a.getLibraries().size(); i++) {
+    const plugin_loader::PluginIndex::LibraryEntry & x = a.getLibraries()[i];
+    const plugin_loader::PluginIndex::LibraryEntry & y = b.getLibraries()[i];
+    if (x.library_path != y.library_path || x.device != y.device || x.inode != y.inode ||
+      x.size != y.size || x.mtime_ns != y.mtime_ns || x.classes.size() != y.classes.size())
+    {
+      return false;
+    }
+    for (std::size_t j = 0; j < x.classes.size(); j++) {
+      if (x.classes[j].base_class_name != y.classes[j].base_class_name ||
+        x.classes[j].class_name != y.classes[j].class_name)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main()
+{
+  char directory_template[] = "/tmp/plugin_index_testXXXXXX";
+  CHECK(nullptr != mkdtemp(directory_template));
+  const std::string directory = directory_template;
+  const std::string plugins_path = directory + "/libplugins.so";
+  const std::string plugins2_path = directory + "/libplugins2.so";
+  const std::string index_path = directory + "/index";
+  copyFile(TEST_PLUGINS_LIBRARY, plugins_path);
+  copyFile(TEST_PLUGINS2_LIBRARY, plugins2_path);
+
+  plugin_loader::PluginIndex index;
+  CHECK(2 == index.scanDirectory(directory));
+  CHECK(2 == index.getLibraries().size());
+  CHECK(plugins_path == index.getLibraries()[0].library_path);
+  CHECK(hasClass(index.getLibraries()[0], "Dog"));
+  CHECK(hasClass(index.getLibraries()[0], "Sheep"));
+  CHECK(hasClass(index.getLibraries()[1], "Table"));
+  index.save(index_path);
+
+  plugin_loader::PluginIndex loaded;
+  CHECK(loaded.load(index_path));
+  CHECK(isSameIndex(index, loaded));
+
+  // Nothing changed, the libraries are not opened again nor the index written back
+  plugin_loader::PluginIndex updated;
+  CHECK(0 == updated.update(directory, index_path));
+  CHECK(isSameIndex(index, updated));
+
+  // Only the modified library is opened, and the removed one dropped. The modification changes
+  // the size, as the modification time may not change within the resolution of the clock.
+  std::ofstream(plugins_path, std::ios::binary | std::ios::app) << '\0';
+  CHECK(0 == unlink(plugins2_path.c_str()));
+  CHECK(1 == updated.update(directory, index_path));
+  CHECK(1 == updated.getLibraries().size());
+  CHECK(hasClass(updated.getLibraries()[0], "Dog"));
+  CHECK(loaded.load(index_path));
+  CHECK(isSameIndex(updated, loaded));
+
+  // An invalid file leaves the index empty
+  std::ofstream(index_path, std::ios::trunc) << "not an index";
+  CHECK(!loaded.load(index_path));
+  CHECK(loaded.getLibraries().empty());
+  CHECK(!loaded.load(directory + "/missing"));
+
+  CHECK(0 == unlink(index_path.c_str()));
+  CHECK(0 == unlink(plugins_path.c_str()));
+  CHECK(0 == rmdir(directory.c_str()));
+  return 0;
+}
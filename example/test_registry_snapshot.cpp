@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// getRegistrySnapshot() must capture the libraries and factories of the registry, and toJson()
+// serialize a known snapshot exactly
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "plugin_loader/plugin_loader.hpp"
+#include "plugin_loader/registry_snapshot.hpp"
+
+#include "check.hpp"
+
+const plugin_loader::FactorySnapshot * findFactory(
+  const std::vector<plugin_loader::FactorySnapshot> & factories, const std::string & class_name)
+{
+  for (const plugin_loader::FactorySnapshot & factory : factories) {
+    if (factory.class_name == class_name) {
+      return &factory;
+    }
+  }
+  return nullptr;
+}
+
+int main()
+{
+  plugin_loader::RegistrySnapshot known;
+  known.time = std::chrono::system_clock::time_point(std::chrono::milliseconds(1234));
+  known.generation = 7;
+  known.non_pure_library_opened = false;
+  const std::string quoted_path = "/lib/\"quoted\"\\path.so";
+  known.libraries.push_back(
+    plugin_loader::LibrarySnapshot{quoted_path, reinterpret_cast<const void *>(0xab)});
+  known.factories.push_back(
+    plugin_loader::FactorySnapshot{reinterpret_cast<const void *>(0x10), "Meta", "Dog", "Base",
+      "4Base", quoted_path, {reinterpret_cast<const void *>(0x20), nullptr}, true});
+  CHECK(
+    known.toJson() ==
+    "{\n"
+    "  \"time_ms\": 1234,\n"
+    "  \"generation\": 7,\n"
+    "  \"non_pure_library_opened\": false,\n"
+    "  \"libraries\": [\n"
+    "    {\"library_path\": \"/lib/\\\"quoted\\\"\\\\path.so\", \"handle\": \"0xab\"}\n"
+    "  ],\n"
+    "  \"factories\": [\n"
+    "    {\"address\": \"0x10\", \"type_name\": \"Meta\", \"class_name\": \"Dog\", "
+    "\"base_class_name\": \"Base\", \"typeid_base_class_name\": \"4Base\", "
+    "\"library_path\": \"/lib/\\\"quoted\\\"\\\\path.so\", \"owners\": [\"0x20\", null], "
+    "\"shadowed\": true}\n"
+    "  ],\n"
+    "  \"graveyard\": []\n"
+    "}\n");
+
+  // The live registry: the factories of a loaded library are owned by its class loader
+  const std::string library_path = TEST_PLUGINS_LIBRARY;
+  plugin_loader::PluginLoader loader(library_path);
+  plugin_loader::RegistrySnapshot snapshot = plugin_loader::getRegistrySnapshot();
+  CHECK(snapshot.time <= std::chrono::system_clock::now());
+  CHECK(std::any_of(snapshot.libraries.begin(), snapshot.libraries.end(),
+    [&library_path](const plugin_loader::LibrarySnapshot & library) {
+      return library.library_path == library_path && nullptr != library.handle;
+    }));
+  const plugin_loader::FactorySnapshot * dog = findFactory(snapshot.factories, "Dog");
+  CHECK(nullptr != dog);
+  CHECK(library_path == dog->library_path);
+  CHECK("Base" == dog->base_class_name);
+  CHECK(!dog->type_name.empty() && !dog->shadowed);
+  CHECK(1 == dog->owners.size() && &loader == dog->owners[0]);
+  CHECK(std::string::npos != snapshot.toJson().find("\"class_name\": \"Dog\""));
+
+  // Unloading moves the factories to the graveyard and changes the generation
+  loader.unloadLibrary();
+  plugin_loader::RegistrySnapshot unloaded = plugin_loader::getRegistrySnapshot();
+  CHECK(unloaded.generation != snapshot.generation);
+  CHECK(nullptr == findFactory(unloaded.factories, "Dog"));
+  CHECK(nullptr != findFactory(unloaded.graveyard, "Dog"));
+  return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// A residency budget must unload the least recently used libraries without live plugins first,
+// and the next creation must load them again
+
+#include <dlfcn.h>
+
+#include <memory>
+#include <string>
+
+#include "plugin_loader/multi_library_plugin_loader.hpp"
+
+#include "base.hpp"
+#include "check.hpp"
+
+bool isLibraryMapped(const std::string & library_path)
+{
+  void * handle = dlopen(library_path.c_str(), RTLD_LAZY | RTLD_NOLOAD);
+  if (nullptr == handle) {
+    return false;
+  }
+  dlclose(handle);
+  return true;
+}
+
+int main()
+{
+  const std::string plugins_path = TEST_PLUGINS_LIBRARY;
+  const std::string plugins2_path = TEST_PLUGINS2_LIBRARY;
+
+  plugin_loader::MultiLibraryPluginLoader loader(false);
+  loader.loadLibrary(plugins_path);
+  loader.loadLibrary(plugins2_path);
+
+  // Used in the opposite order of loading, the library loaded last becomes the least recently used
+  loader.createInstance<Base>("Table").reset();
+  loader.createInstance<Base>("Dog").reset();
+  plugin_loader::ResidencyStatistics statistics = loader.getResidencyStatistics();
+  CHECK(2 == statistics.hits);
+  CHECK(0 == statistics.misses);
+  CHECK(0 == statistics.evictions);
+  CHECK(statistics.resident_bytes > 0);
+
+  // One byte over the budget only evicts the least recently used library. Loaded last, nothing
+  // binds to its symbols, so that it is unmapped as well.
+  loader.setResidencyBudget(statistics.resident_bytes - 1);
+  statistics = loader.getResidencyStatistics();
+  CHECK(1 == statistics.evictions);
+  CHECK(!isLibraryMapped(plugins2_path));
+  CHECK(isLibraryMapped(plugins_path));
+
+  // The evicted library is loaded again on demand, which in turn evicts the other one. The
+  // dynamic linker may keep that one mapped for the symbols the reloaded library binds to, the
+  // miss of its next creation tells it was evicted.
+  std::shared_ptr<Base> table = loader.createInstance<Base>("Table");
+  statistics = loader.getResidencyStatistics();
+  CHECK(1 == statistics.misses);
+  CHECK(2 == statistics.evictions);
+  CHECK(isLibraryMapped(plugins2_path));
+  std::shared_ptr<Base> dog = loader.createInstance<Base>("Dog");
+  statistics = loader.getResidencyStatistics();
+  CHECK(2 == statistics.hits);
+  CHECK(2 == statistics.misses);
+
+  // A library with live plugins is never evicted
+  dog.reset();
+  loader.setResidencyBudget(1);
+  CHECK(3 == loader.getResidencyStatistics().evictions);
+  loader.createInstance<Base>("Table").reset();
+  CHECK(3 == loader.getResidencyStatistics().hits);
+  table.reset();
+  loader.setResidencyBudget(1);
+  statistics = loader.getResidencyStatistics();
+  CHECK(4 == statistics.evictions);
+  CHECK(0 == statistics.resident_bytes);
+
+  // Without budget the libraries stay resident once loaded again
+  loader.setResidencyBudget(0);
+  loader.createInstance<Base>("Dog").reset();
+  loader.createInstance<Base>("Table").reset();
+  loader.createInstance<Base>("Dog").reset();
+  statistics = loader.getResidencyStatistics();
+  CHECK(4 == statistics.hits);
+  CHECK(4 == statistics.misses);
+  CHECK(4 == statistics.evictions);
+  return 0;
+}
@@ -37,7 +37,19 @@
 #ifndef CONSOLE_CONSOLE_
 #define CONSOLE_CONSOLE_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstddef>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 namespace plugin_loader {
 
@@ -78,6 +90,25 @@ enum LogLevel
     CONSOLE_LOG_NONE
   };
 
+/** \brief A formatted log message and where it comes from. The
+    text is only valid during the call it is passed to. */
+struct LogRecord
+{
+    const char     *text;      ///< The message, null terminated
+    std::size_t     size;      ///< The length of the message
+    LogLevel        level;
+    const char     *filename;
+    int             line;
+    std::thread::id thread;    ///< The thread that logged the message
+
+#if __cplusplus >= 201703L
+    std::string_view view(void) const
+    {
+        return std::string_view(text, size);
+    }
+#endif
+};
+
 /** \brief Generic class to handle output from a piece of
     code.
     
@@ -98,8 +129,29 @@ public:
   }
   
   /** \brief log a message to the output handler with the given text
-      and logging level from a specific file and line number */
-  virtual void log(const std::string &text, LogLevel level, const char *filename, int line) = 0;
+      and logging level from a specific file and line number. By
+      default it calls log(const LogRecord &) */
+  virtual void log(const std::string &text, LogLevel level, const char *filename, int line);
+
+  /** \brief log a message to the output handler. This is what the
+      logging functions call, without allocating anything. By default
+      it copies the text and calls the version above. A handler that
+      overrides neither writes its messages to the console. */
+  virtual void log(const LogRecord &record);
+
+  /** \brief Whether log() may be called from several threads at
+      once. The logging functions serialize the calls to the handlers
+      that are not. */
+  virtual bool isThreadSafe(void) const
+  {
+    return false;
+  }
+
+protected:
+
+  /** \brief Writes a message to the console, warnings and errors to
+      stderr along with where they come from, the others to stdout */
+  static void writeToConsole(const LogRecord &record);
 };
 
 /** \brief Default implementation of OutputHandler. This sends
@@ -112,7 +164,9 @@ public:
   {
   }
   
-  virtual void log(const std::string &text, LogLevel level, const char *filename, int line);
+  using OutputHandler::log;
+
+  virtual void log(const LogRecord &record);
   
 };
 
@@ -126,7 +180,9 @@ public:
   
   virtual ~OutputHandlerFile(void);
   
-  virtual void log(const std::string &text, LogLevel level, const char *filename, int line);
+  using OutputHandler::log;
+
+  virtual void log(const LogRecord &record);
   
 private:
   
@@ -135,6 +191,128 @@ private:
   
 };
 
+/** \brief Implementation of OutputHandler that saves messages in a
+    file through a write buffer of its own.
+
+    The buffer is written out when it is full, when a message of
+    flush_level or above is logged, when a message is logged more than
+    flush_interval after the last write and by flush(). A message that
+    does not fit in the buffer is written along with it in a single
+    writev() call, without being copied. */
+class OutputHandlerBufferedFile : public OutputHandler
+{
+public:
+
+  /** \brief Opens the file in which to save the message data
+      \param filename The name of the file, messages are appended to it
+      \param buffer_size The size of the write buffer in bytes
+      \param flush_interval How old the buffered messages may get, they are only written when another message is logged or flush() is called
+      \param flush_level The level of the messages that are written immediately, along with the buffered ones */
+  OutputHandlerBufferedFile(const char *filename, std::size_t buffer_size = 64 * 1024,
+                            std::chrono::milliseconds flush_interval = std::chrono::milliseconds(1000),
+                            LogLevel flush_level = CONSOLE_LOG_ERROR);
+
+  /** \brief Writes out the buffered messages and closes the file */
+  virtual ~OutputHandlerBufferedFile(void);
+
+  using OutputHandler::log;
+
+  virtual void log(const LogRecord &record);
+
+  virtual bool isThreadSafe(void) const
+  {
+    return true;
+  }
+
+  /** \brief Writes out the buffered messages
+      \param sync Also waits until the file data has been written to the storage device */
+  void flush(bool sync = false);
+
+private:
+
+  void write(const char *text, std::size_t text_size, const char *suffix, std::size_t suffix_size);
+
+  FILE                                 *file_;
+  std::string                           buffer_;
+  std::string                           suffix_;  // Of the message being logged, kept to reuse its capacity
+  std::size_t                           buffer_size_;
+  std::chrono::milliseconds             flush_interval_;
+  LogLevel                              flush_level_;
+  std::chrono::steady_clock::time_point last_write_;
+  std::mutex                            mutex_;
+};
+
+/** \brief What OutputHandlerAsync does with a message when its queue is full */
+enum AsyncOverflowPolicy
+  {
+    CONSOLE_ASYNC_DROP = 0,   ///< The message is dropped, and the number of dropped messages reported later
+    CONSOLE_ASYNC_BLOCK       ///< The logging thread waits until there is room in the queue
+  };
+
+/** \brief Implementation of OutputHandler that forwards messages to
+    another OutputHandler from a background thread.
+
+    Logging threads only copy the message into a bounded lock-free
+    queue, so they never wait for I/O. The background thread forwards
+    the queued messages in batches. The destructor forwards the
+    remaining messages, so the handler must be replaced with
+    useOutputHandler() before it is destroyed. */
+class OutputHandlerAsync : public OutputHandler
+{
+public:
+
+  /** \brief Starts the background thread
+      \param sink The handler the messages are forwarded to, it must outlive this one
+      \param queue_depth The maximum number of queued messages, rounded up to a power of two
+      \param overflow_policy What to do with a message when the queue is full */
+  OutputHandlerAsync(OutputHandler *sink, std::size_t queue_depth = 1024,
+                     AsyncOverflowPolicy overflow_policy = CONSOLE_ASYNC_DROP);
+
+  virtual ~OutputHandlerAsync(void);
+
+  using OutputHandler::log;
+
+  virtual void log(const LogRecord &record);
+
+  virtual bool isThreadSafe(void) const
+  {
+    return true;
+  }
+
+  /** \brief Waits until the messages logged before the call have been forwarded */
+  void flush(void);
+
+  /** \brief The number of messages dropped since the handler was created */
+  std::size_t getDroppedCount(void) const
+  {
+    return dropped_count_.load();
+  }
+
+private:
+
+  struct Record;
+
+  bool tryPush(const LogRecord &record);
+  bool isEmpty(void) const;
+  void run(void);
+
+  OutputHandler               *sink_;
+  AsyncOverflowPolicy          overflow_policy_;
+  std::size_t                  mask_;
+  std::unique_ptr<Record[]>    records_;
+  std::atomic<std::size_t>     enqueue_position_;
+  std::atomic<std::size_t>     dequeue_position_;
+  std::atomic<std::size_t>     dropped_count_;
+  std::atomic<std::size_t>     unreported_drops_;
+  std::atomic<bool>            waiting_;   // The background thread is about to wait or waiting
+  bool                         stop_;
+  std::size_t                  forwarded_count_;
+  std::mutex                   mutex_;     // Guards stop_ and forwarded_count_
+  std::condition_variable      condition_;
+  std::condition_variable      forwarded_condition_;
+  std::thread                  thread_;
+};
+
 /** \brief This function instructs ompl that no messages should be outputted. Equivalent to useOutputHandler(NULL) */
  void noOutputHandler(void);
 
@@ -155,30 +333,72 @@ private:
     with lower logging levels will not be recorded. */
  LogLevel getLogLevel(void);
 
+/** \brief Limit how many messages each call site outputs. Once a
+    call site has logged max_messages messages within interval, its
+    next messages are only counted until the interval is over. The
+    next message it logs after that is preceded by the number of
+    messages suppressed. Debug and error messages are never limited.
+    By default, a call site outputs 100 messages every 10 seconds. A
+    call site that suppressed 16 messages within an interval only looks
+    for its end every 16 messages, so up to 15 more messages may be
+    suppressed after it.
+    \param max_messages The number of messages per interval, 0 disables the limit */
+ void setLogRateLimit(std::size_t max_messages, std::chrono::milliseconds interval);
+
+/** \brief Output the number of messages suppressed by the rate limit
+    of each call site that has not logged a message since, e.g. before
+    exiting. It is done at exit when the default output handler is used. */
+ void flushSuppressedLogMessages(void);
+
 /** \brief Root level logging function.  This should not be invoked directly,
     but rather used via a \ref logging "logging macro".  Formats the message
-    string given the arguments and forwards the string to the output handler */
+    string given the arguments, in a buffer of the calling thread that grows
+    as needed, and forwards it to the output handler */
  void log(const char *file, int line, LogLevel level, const char* m, ...);
 
+#if defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1926)
+#define CONSOLE_CALL_SITE_FILE __builtin_FILE()
+#define CONSOLE_CALL_SITE_LINE __builtin_LINE()
+#else
+#define CONSOLE_CALL_SITE_FILE __FILE__
+#define CONSOLE_CALL_SITE_LINE __LINE__
+#endif
+
+/** \brief The format string of a logging function, along with the
+    file and line it is called from, which its implicit conversion
+    from const char* records where supported. */
+struct LogFormat
+{
+    LogFormat(const char *fmt, const char *file = CONSOLE_CALL_SITE_FILE,
+              int line = CONSOLE_CALL_SITE_LINE)
+        : fmt(fmt), file(file), line(line)
+    {
+    }
+
+    const char *fmt;
+    const char *file;
+    int         line;
+};
+
 
  template<typename... Args> inline
- void logError(const char* fmt, Args... args) {
-     plugin_loader::log(__FILE__, __LINE__, plugin_loader::CONSOLE_LOG_ERROR, fmt, args...);
+ void logError(LogFormat fmt, Args... args) {
+     plugin_loader::log(fmt.file, fmt.line, plugin_loader::CONSOLE_LOG_ERROR, fmt.fmt, args...);
  }
 
  template<typename... Args> inline
- void logWarn(const char* fmt, Args... args) {
-     plugin_loader::log(__FILE__, __LINE__, plugin_loader::CONSOLE_LOG_WARN, fmt, args...);
+ void logWarn(LogFormat fmt, Args... args) {
+     plugin_loader::log(fmt.file, fmt.line, plugin_loader::CONSOLE_LOG_WARN, fmt.fmt, args...);
  }
 
  template<typename... Args> inline
- void logInform(const char* fmt, Args... args) {
-     plugin_loader::log(__FILE__, __LINE__, plugin_loader::CONSOLE_LOG_INFO, fmt, args...);
+ void logInform(LogFormat fmt, Args... args) {
+     plugin_loader::log(fmt.file, fmt.line, plugin_loader::CONSOLE_LOG_INFO, fmt.fmt, args...);
  }
 
  template<typename... Args> inline
- void logDebug(const char* fmt, Args... args) {
-     plugin_loader::log(__FILE__, __LINE__, plugin_loader::CONSOLE_LOG_DEBUG, fmt, args...);
+ void logDebug(LogFormat fmt, Args... args) {
+     plugin_loader::log(fmt.file, fmt.line, plugin_loader::CONSOLE_LOG_DEBUG, fmt.fmt, args...);
  }
 
 
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PLUGIN_LOADER_DUPLICATE_CLASS_POLICY_HPP_
+#define PLUGIN_LOADER_DUPLICATE_CLASS_POLICY_HPP_
+
+#include <string>
+
+#include "plugin_loader/visibility_control.hpp"
+
+namespace plugin_loader
+{
+
+/**
+ * @brief Decides which library provides a class when several loaded libraries register the same class name for the same base class.
+ *
+ * The factories of all the libraries are kept: the one chosen by the policy resolves the plain
+ * class name and shadows the other ones, which stay reachable through their qualified class name
+ * (@see qualifiedClassName()) and take over when the winning library is unloaded. A PluginLoader
+ * always creates the class of its own library.
+ */
+enum class DuplicateClassPolicy
+{
+  LastRegisteredWins,   ///< The most recently loaded library wins (default)
+  FirstRegisteredWins,  ///< The first loaded library wins
+  LibraryPriority       ///< The library with the highest priority wins, ties go to the most recently loaded one
+};
+
+/**
+ * @brief Sets the policy used to resolve class names registered by several libraries. Classes that are already registered are resolved again.
+ * @param policy - The new policy
+ */
+PLUGIN_LOADER_PUBLIC
+void setDuplicateClassPolicy(DuplicateClassPolicy policy);
+
+/**
+ * @brief Gets the policy used to resolve class names registered by several libraries
+ */
+PLUGIN_LOADER_PUBLIC
+DuplicateClassPolicy getDuplicateClassPolicy();
+
+/**
+ * @brief Sets the priority of a library for the DuplicateClassPolicy::LibraryPriority policy
+ * @param library_path - The fully qualified path to the runtime library, as passed to the PluginLoader
+ * @param priority - The priority, libraries default to 0
+ */
+PLUGIN_LOADER_PUBLIC
+void setLibraryPriority(const std::string & library_path, int priority);
+
+/**
+ * @brief Gets the priority of a library for the DuplicateClassPolicy::LibraryPriority policy
+ * @param library_path - The fully qualified path to the runtime library
+ */
+PLUGIN_LOADER_PUBLIC
+int getLibraryPriority(const std::string & library_path);
+
+/**
+ * @brief Gets the name that designates the class of a specific library, even when another library shadows it. It can be passed wherever a class name is expected.
+ * @param library_path - The fully qualified path to the runtime library
+ * @param class_name - The literal name of the class
+ * @return library_path + "::" + class_name
+ */
+PLUGIN_LOADER_PUBLIC
+std::string qualifiedClassName(const std::string & library_path, const std::string & class_name);
+
+}  // namespace plugin_loader
+
+#endif  // PLUGIN_LOADER_DUPLICATE_CLASS_POLICY_HPP_
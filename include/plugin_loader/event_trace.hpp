@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLUGIN_LOADER_EVENT_TRACE_HPP_
+#define PLUGIN_LOADER_EVENT_TRACE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "plugin_loader/visibility_control.hpp"
+
+namespace plugin_loader
+{
+
+/**
+ * @brief The lifecycle events recorded by the event trace
+ */
+enum class TraceEventType : std::uint8_t
+{
+  LibraryLoad,  ///< impl::loadLibrary(), including the events below it
+  Dlopen,       ///< Opening the library, including the registration of its plugins
+  Register,     ///< Registration of a plugin class by the static initializers of its library
+  Revive,       ///< Reviving the factories of a library from the graveyard
+  Purge,        ///< Purging the factories of a library from the graveyard
+  Create,       ///< Creation of a plugin, named after its class
+  Destroy,      ///< Destruction of a plugin, named after its library
+  Unload        ///< impl::unloadLibrary()
+};
+
+/**
+ * @brief Gets the name of an event type, e.g. "LibraryLoad"
+ */
+PLUGIN_LOADER_PUBLIC
+const char * toString(TraceEventType type);
+
+/**
+ * @brief An event of the event trace
+ */
+struct TraceEvent
+{
+  std::int64_t timestamp_ns;  ///< steady_clock time when the event started
+  std::int64_t duration_ns;   ///< How long it took
+  std::uint32_t name_id;      ///< The library or class the event is about, @see getTraceName()
+  std::uint32_t thread_id;    ///< Small number identifying the thread, in the order threads first traced
+  TraceEventType type;
+};
+
+/**
+ * @brief Starts recording lifecycle events into a ring of fixed-size records shared by all threads. Recording an event takes no lock. Once the ring is full the oldest events are overwritten.
+ * @param capacity - Number of events the ring holds, rounded up to a power of two. Only the first call allocates the ring, later calls keep its capacity.
+ */
+PLUGIN_LOADER_PUBLIC
+void enableEventTrace(std::size_t capacity = 65536);
+
+/**
+ * @brief Stops recording lifecycle events, the recorded ones are kept
+ */
+PLUGIN_LOADER_PUBLIC
+void disableEventTrace();
+
+/**
+ * @brief Indicates if lifecycle events are being recorded
+ */
+PLUGIN_LOADER_PUBLIC
+bool isEventTraceEnabled();
+
+/**
+ * @brief Discards the recorded events
+ */
+PLUGIN_LOADER_PUBLIC
+void clearEventTrace();
+
+/**
+ * @brief Gets the events still in the ring, in the order they were recorded. Events being recorded meanwhile may be missing.
+ */
+PLUGIN_LOADER_PUBLIC
+std::vector<TraceEvent> getEventTrace();
+
+/**
+ * @brief Gets the library or class name of an event from its name_id
+ */
+PLUGIN_LOADER_PUBLIC
+std::string getTraceName(std::uint32_t name_id);
+
+/**
+ * @brief Writes the recorded events to a binary file, along with their names
+ * @param path - The file to write
+ * @throws PluginLoaderException if the file cannot be written
+ */
+PLUGIN_LOADER_PUBLIC
+void dumpEventTrace(const std::string & path);
+
+/**
+ * @brief Converts a file written by dumpEventTrace() to the JSON format of the Chrome trace viewer (chrome://tracing, Perfetto)
+ * @param trace_path - The file written by dumpEventTrace()
+ * @param json_path - The JSON file to write
+ * @throws PluginLoaderException if a file cannot be read or written, or is not an event trace
+ */
+PLUGIN_LOADER_PUBLIC
+void convertEventTraceToChromeJson(const std::string & trace_path, const std::string & json_path);
+
+namespace impl
+{
+
+/**
+ * @brief Gets the clock of the event trace, steady_clock in nanoseconds
+ */
+PLUGIN_LOADER_PUBLIC
+std::int64_t getTraceClock();
+
+/**
+ * @brief Records an event if the event trace is enabled
+ * @param type - The event type
+ * @param name - The library or class the event is about
+ * @param timestamp_ns - When the event started, @see getTraceClock()
+ * @param duration_ns - How long it took
+ */
+PLUGIN_LOADER_PUBLIC
+void recordTraceEvent(
+  TraceEventType type, const std::string & name, std::int64_t timestamp_ns,
+  std::int64_t duration_ns);
+
+/**
+ * @class TraceScope
+ * @brief Records an event lasting from its construction to its destruction, if the event trace was enabled on construction
+ */
+class TraceScope
+{
+public:
+  /**
+   * @param type - The event type
+   * @param name - The library or class the event is about, must outlive the scope
+   */
+  TraceScope(TraceEventType type, const std::string & name)
+  : type_(type), name_(name), start_ns_(isEventTraceEnabled() ? getTraceClock() : -1)
+  {
+  }
+
+  ~TraceScope()
+  {
+    if (start_ns_ >= 0) {
+      recordTraceEvent(type_, name_, start_ns_, getTraceClock() - start_ns_);
+    }
+  }
+
+  // The name is kept by reference, a temporary would be gone by the time the event is recorded
+  TraceScope(TraceEventType type, std::string && name) = delete;
+  TraceScope(const TraceScope &) = delete;
+  TraceScope & operator=(const TraceScope &) = delete;
+
+private:
+  TraceEventType type_;
+  const std::string & name_;
+  std::int64_t start_ns_;  ///< -1 if not recording
+};
+
+}  // namespace impl
+}  // namespace plugin_loader
+
+#endif  // PLUGIN_LOADER_EVENT_TRACE_HPP_
@@ -98,5 +98,17 @@ public:
   {}
 };
 
+/**
+ * @class PluginIndexException
+ * @brief An exception class thrown when a plugin index cannot be read from or written to disk
+ */
+class PluginIndexException : public PluginLoaderException
+{
+public:
+  explicit inline PluginIndexException(const std::string & error_desc)
+  : PluginLoaderException(error_desc)
+  {}
+};
+
 }  // namespace plugin_loader
 #endif  // PLUGIN_LOADER_EXCEPTIONS_HPP_
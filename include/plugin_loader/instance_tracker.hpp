@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLUGIN_LOADER_INSTANCE_TRACKER_HPP_
+#define PLUGIN_LOADER_INSTANCE_TRACKER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plugin_loader/visibility_control.hpp"
+
+namespace plugin_loader
+{
+
+/**
+ * @brief Describes a live managed plugin, @see PluginLoader::setInstanceTrackingEnabled()
+ */
+struct InstanceInfo
+{
+  std::string class_name;
+  std::string library_path;
+  const void * object;
+  std::chrono::system_clock::time_point creation_time;
+  std::thread::id creating_thread;
+};
+
+namespace impl
+{
+
+/**
+ * @brief Links a tracked plugin into the list of its shard
+ */
+struct InstanceNode
+{
+  InstanceInfo info;
+  InstanceNode * prev;
+  InstanceNode * next;
+  std::size_t shard;
+};
+
+/**
+ * @class InstanceTracker
+ * @brief Keeps the live managed plugins of a PluginLoader in intrusive lists.
+ *
+ * Each thread adds the plugins it creates to one of a fixed number of shards, so that threads
+ * creating plugins concurrently rarely contend. A node knows its shard, so a plugin can be removed
+ * from any thread. Adding and removing are both O(1).
+ */
+class PLUGIN_LOADER_PUBLIC InstanceTracker
+{
+public:
+  InstanceTracker();
+
+  /**
+   * @brief Destructor for the class, frees the nodes of the plugins still tracked
+   */
+  ~InstanceTracker();
+
+  InstanceTracker(const InstanceTracker &) = delete;
+  InstanceTracker & operator=(const InstanceTracker &) = delete;
+
+  /**
+   * @brief Enables or disables tracking, the plugins already tracked stay tracked until destroyed
+   */
+  void setEnabled(bool enabled) {enabled_.store(enabled, std::memory_order_relaxed);}
+
+  /**
+   * @brief Indicates if newly created plugins are tracked
+   */
+  bool isEnabled() const {return enabled_.load(std::memory_order_relaxed);}
+
+  /**
+   * @brief Starts tracking a plugin created by the calling thread
+   * @param object - The plugin
+   * @param class_name - The name of its class
+   * @param library_path - The library it was created from
+   * @return The node to pass to untrack() when the plugin is destroyed, nullptr if tracking is disabled
+   */
+  InstanceNode * track(
+    const void * object, const std::string & class_name, const std::string & library_path);
+
+  /**
+   * @brief Stops tracking a plugin
+   * @param node - What track() returned for it, nothing is done if nullptr
+   */
+  void untrack(InstanceNode * node);
+
+  /**
+   * @brief Gets the tracked plugins, oldest first
+   */
+  std::vector<InstanceInfo> getInstances() const;
+
+private:
+  static const std::size_t kShardCount = 16;
+
+  struct Shard
+  {
+    std::mutex mutex;
+    InstanceNode * head = nullptr;
+  };
+
+  std::atomic<bool> enabled_;
+  mutable Shard shards_[kShardCount];
+};
+
+}  // namespace impl
+}  // namespace plugin_loader
+
+#endif  // PLUGIN_LOADER_INSTANCE_TRACKER_HPP_
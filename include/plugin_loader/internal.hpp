@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLUGIN_LOADER_INTERNAL_HPP_
+#define PLUGIN_LOADER_INTERNAL_HPP_
+
+// Helpers shared by the plugin_loader translation units, not part of the public interface
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+namespace plugin_loader
+{
+namespace impl
+{
+
+/**
+ * @brief Gets a small number identifying the calling thread
+ *
+ * Threads are numbered in the order in which they first call this function, so the index
+ * spreads threads round robin over a fixed number of shards when taken modulo the shard count.
+ * @return The index of the calling thread
+ */
+inline std::size_t getThreadIndex()
+{
+  static std::atomic<std::size_t> thread_count(0);
+  static thread_local const std::size_t index = thread_count.fetch_add(1);
+  return index;
+}
+
+/**
+ * @brief Appends a string to a JSON document as a quoted and escaped JSON string
+ * @param json The JSON document to append to
+ * @param str The string to append
+ */
+inline void appendJsonString(std::string & json, const std::string & str)
+{
+  json += '"';
+  for (char c : str) {
+    if ('"' == c || '\\' == c) {
+      json += '\\';
+      json += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char code[8];
+      snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned int>(c));
+      json += code;
+    } else {
+      json += c;
+    }
+  }
+  json += '"';
+}
+
+}  // namespace impl
+}  // namespace plugin_loader
+
+#endif  // PLUGIN_LOADER_INTERNAL_HPP_
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLUGIN_LOADER_LIBRARY_REAPER_HPP_
+#define PLUGIN_LOADER_LIBRARY_REAPER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "plugin_loader/visibility_control.hpp"
+
+namespace plugin_loader
+{
+
+class PluginLoader;  // Forward declaration
+
+/**
+ * @brief Describes how long libraries of PluginLoaders in on-demand (lazy) load/unload mode stay mapped once their last plugin has been destroyed.
+ *
+ * With the default policy a library is unloaded as soon as its last plugin is destroyed. With a
+ * non-zero min_idle_time the library is kept loaded and only unloaded by a background reaper
+ * thread once it stayed idle for that long, so that creating a plugin again does not have to
+ * reopen it. The number of idle libraries and the bytes they occupy can be capped, in which case
+ * the least recently used idle libraries are unloaded first.
+ */
+struct UnloadRetentionPolicy
+{
+  /// How long a library must stay idle before it is unloaded, zero disables retention and
+  /// milliseconds::max() keeps idle libraries loaded until the caps below are exceeded
+  std::chrono::milliseconds min_idle_time = std::chrono::milliseconds::zero();
+  /// Maximum number of idle libraries kept loaded, zero means unlimited
+  std::size_t max_idle_libraries = 0;
+  /// Maximum size in bytes of the idle libraries kept loaded, zero means unlimited
+  std::size_t max_idle_bytes = 0;
+};
+
+/**
+ * @brief Sets the unload retention policy used by all the PluginLoaders of the process
+ * @param policy - The new policy, it also applies to the libraries that are already idle
+ */
+PLUGIN_LOADER_PUBLIC
+void setUnloadRetentionPolicy(const UnloadRetentionPolicy & policy);
+
+/**
+ * @brief Gets the unload retention policy used by all the PluginLoaders of the process
+ */
+PLUGIN_LOADER_PUBLIC
+UnloadRetentionPolicy getUnloadRetentionPolicy();
+
+/**
+ * @brief Enables or disables deferred destruction for all the PluginLoaders of the process.
+ *
+ * When enabled, destroying a managed plugin only queues it, in constant time and without taking a
+ * lock, and a background reaper thread deletes it and unloads its library when needed (e.g. in
+ * on-demand mode). Threads releasing plugins then never run plugin destructors or dlclose().
+ * Plugin destructors must not wait for threads that destroy plugins or flush the queue.
+ */
+PLUGIN_LOADER_PUBLIC
+void setDeferredDestructionEnabled(bool enabled);
+
+/**
+ * @brief Indicates if destroying a managed plugin is deferred to the reaper thread
+ */
+PLUGIN_LOADER_PUBLIC
+bool isDeferredDestructionEnabled();
+
+/**
+ * @brief Waits until the plugins whose destruction was deferred before the call have been destroyed, e.g. at shutdown. PluginLoader::unloadLibrary() and the destructor of PluginLoader only wait for the plugins of their loader.
+ */
+PLUGIN_LOADER_PUBLIC
+void flushDeferredDestruction();
+
+namespace impl
+{
+
+/**
+ * @class LibraryReaper
+ * @brief Keeps track of the idle libraries retained by the UnloadRetentionPolicy and unloads them from a background thread.
+ */
+class PLUGIN_LOADER_PUBLIC LibraryReaper
+{
+public:
+  /**
+   * @brief Gets the process wide reaper. It is never destroyed so it can be used from static destructors.
+   */
+  static LibraryReaper & instance();
+
+  /**
+   * @brief Indicates if libraries are retained rather than unloaded as soon as they become idle
+   */
+  bool isRetentionEnabled() const {return retention_enabled_.load(std::memory_order_relaxed);}
+
+  /**
+   * @brief Sets the retention policy and wakes up the reaper so it is applied to idle libraries
+   */
+  void setPolicy(const UnloadRetentionPolicy & policy);
+
+  /**
+   * @brief Gets the retention policy
+   */
+  UnloadRetentionPolicy getPolicy();
+
+  /**
+   * @brief Records that the last plugin of a loader was destroyed. The loader becomes the most recently used idle one.
+   * @param loader - The loader whose library became idle
+   */
+  void markIdle(PluginLoader * loader);
+
+  /**
+   * @brief Records that a plugin is about to be created by a loader, which prevents its library from being reaped. Blocks while the library is being unloaded by the reaper.
+   * @param loader - The loader that is creating a plugin
+   */
+  void markBusy(PluginLoader * loader);
+
+  /**
+   * @brief Forgets about a loader that is being destroyed. Blocks while its library is being unloaded by the reaper.
+   * @param loader - The loader being destroyed
+   */
+  void forget(PluginLoader * loader);
+
+  /**
+   * @brief Indicates if destroying a managed plugin is deferred to the reaper thread
+   */
+  bool isDeferredDestructionEnabled() const
+  {
+    return deferred_destruction_enabled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Enables or disables deferred destruction, the work already queued is done anyway
+   */
+  void setDeferredDestructionEnabled(bool enabled);
+
+  /**
+   * @brief Queues the destruction of a plugin, the reaper thread then destroys it and drops the reference it held on the library of its loader. Lock-free, except when the queue was empty and the reaper is woken up, which never waits for an unload.
+   * @param loader - The loader that created the plugin
+   * @param object - The plugin, nullptr to only drop the reference
+   * @param destroy - Destroys object
+   */
+  void defer(PluginLoader * loader, void * object, void (* destroy)(void *));
+
+  /**
+   * @brief Waits until the work deferred before the call is done. Called from the reaper thread, it does the work queued so far instead.
+   */
+  void flush();
+
+  /**
+   * @brief Waits until the work deferred for a loader is done, so that the plugins it already released do not keep its library loaded. Called from the reaper thread, it does the work queued so far instead.
+   * @param loader - The loader whose work is waited for
+   */
+  void flush(PluginLoader * loader);
+
+private:
+  struct IdleLibrary
+  {
+    PluginLoader * loader;
+    std::chrono::steady_clock::time_point idle_since;
+    std::size_t bytes;
+  };
+  typedef std::list<IdleLibrary> IdleLibraryList;
+
+  struct DeferredWork
+  {
+    PluginLoader * loader;
+    void * object;
+    void (* destroy)(void *);
+    DeferredWork * next;
+  };
+
+  LibraryReaper();
+
+  void run();
+  void wake();
+  bool isReaperThread() const;
+  void remove(PluginLoader * loader);
+  void reapFront(std::unique_lock<std::mutex> & lock);
+  void waitUntilUnloaded(std::unique_lock<std::mutex> & lock, PluginLoader * loader);
+  void doDeferredWork();
+
+  std::mutex mutex_;
+  UnloadRetentionPolicy policy_;
+  std::atomic<bool> retention_enabled_;
+  IdleLibraryList idle_libraries_;  // Least recently used first
+  std::unordered_map<PluginLoader *, IdleLibraryList::iterator> idle_library_index_;
+  std::size_t idle_bytes_;
+  PluginLoader * unloading_loader_;  // Loader whose library the reaper is unloading, if any
+  std::condition_variable unloaded_condition_;
+  std::atomic<bool> deferred_destruction_enabled_;
+  std::atomic<DeferredWork *> deferred_work_;  // Lock-free stack, most recently deferred first
+  std::atomic<std::size_t> deferred_count_;
+  std::size_t done_count_;  // Deferred work done, guarded by mutex_
+  std::condition_variable done_condition_;
+  // Wakes up the reaper, never held while unloading unlike mutex_
+  std::mutex wake_mutex_;
+  std::condition_variable wake_condition_;
+  bool wake_requested_;  // Guarded by wake_mutex_
+  std::once_flag thread_started_;
+  std::thread thread_;
+  std::atomic<std::thread::id> thread_id_;
+};
+
+}  // namespace impl
+}  // namespace plugin_loader
+
+#endif  // PLUGIN_LOADER_LIBRARY_REAPER_HPP_
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PLUGIN_LOADER_LIBRARY_WATCHER_HPP_
+#define PLUGIN_LOADER_LIBRARY_WATCHER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "plugin_loader/visibility_control.hpp"
+
+namespace plugin_loader
+{
+namespace impl
+{
+
+/**
+ * @class LibraryWatcher
+ * @brief Watches runtime library files with inotify and reports when they have been rewritten or replaced.
+ *
+ * The directories containing the libraries are watched rather than the files themselves, so that
+ * libraries replaced by a rename keep being watched. A change is only reported once the file has
+ * not been modified for a settle delay, so that a library being copied is not reported half written.
+ */
+class PLUGIN_LOADER_PUBLIC LibraryWatcher
+{
+public:
+  typedef std::function<void (const std::string & library_path)> ChangeCallback;
+  typedef std::function<void ()> TickCallback;
+
+  /**
+   * @brief Constructor for the class, starts the watching thread
+   * @param on_change - Called from the watching thread with the path of a library that changed
+   * @param on_tick - Called from the watching thread every tick_period, may be empty
+   * @param tick_period - How often on_tick is called, also the settle delay of the changes
+   * @throws LibraryLoadException if inotify is not available
+   */
+  LibraryWatcher(
+    const ChangeCallback & on_change, const TickCallback & on_tick,
+    std::chrono::milliseconds tick_period = std::chrono::milliseconds(100));
+
+  /**
+   * @brief Destructor for the class, stops the watching thread. It must not be destroyed from one of its callbacks.
+   */
+  ~LibraryWatcher();
+
+  /**
+   * @brief Starts watching a library
+   * @param library_path - The fully qualified path to the runtime library
+   * @throws LibraryLoadException if the directory of the library cannot be watched
+   */
+  void watch(const std::string & library_path);
+
+  /**
+   * @brief Stops watching a library
+   * @param library_path - The fully qualified path to the runtime library
+   */
+  void unwatch(const std::string & library_path);
+
+private:
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  void run();
+  void readEvents();
+
+  ChangeCallback on_change_;
+  TickCallback on_tick_;
+  std::chrono::milliseconds tick_period_;
+  int inotify_fd_;
+  int wakeup_fd_[2];
+  std::mutex mutex_;
+  std::map<int, std::string> watched_directories_;  // Watch descriptor to directory
+  std::map<std::string, std::string> watched_libraries_;  // Directory + '/' + file name to path
+  std::map<std::string, TimePoint> pending_changes_;  // Library to time of its last change
+  std::atomic<bool> stop_;
+  std::thread thread_;
+};
+
+}  // namespace impl
+}  // namespace plugin_loader
+
+#endif  // PLUGIN_LOADER_LIBRARY_WATCHER_HPP_
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLUGIN_LOADER_LOCK_PROFILER_HPP_
+#define PLUGIN_LOADER_LOCK_PROFILER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "plugin_loader/metrics.hpp"
+#include "plugin_loader/visibility_control.hpp"
+
+namespace plugin_loader
+{
+
+/**
+ * @brief The contention statistics of a named mutex, or of all the mutexes sharing a name such as the ones of every PluginLoader
+ */
+struct LockStats
+{
+  std::string name;
+  std::uint64_t acquisitions;            ///< Outermost acquisitions, recursive ones are not counted
+  std::uint64_t contended_acquisitions;  ///< Acquisitions that had to wait for another thread
+  std::int64_t wait_ns;                  ///< Time spent waiting in contended acquisitions
+  std::int64_t max_wait_ns;
+  std::int64_t hold_ns;                  ///< Time held, from an acquisition to the matching unlock
+  std::int64_t max_hold_ns;
+};
+
+/**
+ * @brief Indicates if plugin_loader was built with the PLUGIN_LOADER_LOCK_PROFILING option, without which its mutexes are not profiled and getLockStats() reports nothing
+ */
+PLUGIN_LOADER_PUBLIC
+bool isLockProfilingEnabled();
+
+/**
+ * @brief Gets the contention statistics of the mutexes of plugin_loader since startup or the last resetLockStats(), the most waited for first
+ */
+PLUGIN_LOADER_PUBLIC
+std::vector<LockStats> getLockStats();
+
+/**
+ * @brief Zeroes the contention statistics
+ */
+PLUGIN_LOADER_PUBLIC
+void resetLockStats();
+
+namespace impl
+{
+
+/**
+ * @brief The statistics shared by the mutexes of a name, which live until the process exits
+ */
+struct LockStatsEntry;
+
+/**
+ * @brief Gets the statistics of a name, creating them if needed
+ */
+PLUGIN_LOADER_PUBLIC
+LockStatsEntry * getLockStatsEntry(const char * name);
+
+PLUGIN_LOADER_PUBLIC
+void recordLockAcquisition(LockStatsEntry * entry, bool contended, std::int64_t wait_ns);
+
+PLUGIN_LOADER_PUBLIC
+void recordLockRelease(LockStatsEntry * entry, std::int64_t hold_ns);
+
+/**
+ * @class ProfiledMutex
+ * @brief A mutex that records its contention statistics under a name when plugin_loader is built with PLUGIN_LOADER_LOCK_PROFILING, and otherwise only forwards to Mutex. Its layout does not depend on the option.
+ */
+template<class Mutex>
+class ProfiledMutex
+{
+public:
+  /**
+   * @param name - The name to report the statistics under, @see getLockStats()
+   */
+  explicit ProfiledMutex(const char * name)
+  : stats_(nullptr), depth_(0), acquire_ns_(0)
+  {
+#ifdef PLUGIN_LOADER_LOCK_PROFILING
+    stats_ = getLockStatsEntry(name);
+#else
+    (void)name;
+#endif
+  }
+
+  ProfiledMutex(const ProfiledMutex &) = delete;
+  ProfiledMutex & operator=(const ProfiledMutex &) = delete;
+
+  void lock()
+  {
+#ifdef PLUGIN_LOADER_LOCK_PROFILING
+    if (mutex_.try_lock()) {
+      onAcquired(false, 0, getMetricsClock());
+      return;
+    }
+    const std::int64_t start_ns = getMetricsClock();
+    mutex_.lock();
+    const std::int64_t now_ns = getMetricsClock();
+    onAcquired(true, now_ns - start_ns, now_ns);
+#else
+    mutex_.lock();
+#endif
+  }
+
+  bool try_lock()
+  {
+    if (!mutex_.try_lock()) {
+      return false;
+    }
+#ifdef PLUGIN_LOADER_LOCK_PROFILING
+    onAcquired(false, 0, getMetricsClock());
+#endif
+    return true;
+  }
+
+  void unlock()
+  {
+#ifdef PLUGIN_LOADER_LOCK_PROFILING
+    // Only the owner touches depth_ and acquire_ns_, which the mutex itself guards
+    if (0 == --depth_) {
+      recordLockRelease(stats_, getMetricsClock() - acquire_ns_);
+    }
+#endif
+    mutex_.unlock();
+  }
+
+private:
+  void onAcquired(bool contended, std::int64_t wait_ns, std::int64_t now_ns)
+  {
+    if (0 == depth_++) {
+      acquire_ns_ = now_ns;
+      recordLockAcquisition(stats_, contended, wait_ns);
+    }
+  }
+
+  Mutex mutex_;
+  LockStatsEntry * stats_;
+  std::size_t depth_;        ///< Recursion depth of the owner
+  std::int64_t acquire_ns_;  ///< When the owner acquired it
+};
+
+typedef ProfiledMutex<std::recursive_mutex> RecursiveMutex;
+
+}  // namespace impl
+}  // namespace plugin_loader
+
+#endif  // PLUGIN_LOADER_LOCK_PROFILER_HPP_
@@ -35,6 +35,11 @@
 #ifndef PLUGIN_LOADER_META_OBJECT_HPP_
 #define PLUGIN_LOADER_META_OBJECT_HPP_
 
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
 #include <typeinfo>
 #include <string>
 #include <vector>
@@ -47,6 +52,8 @@ class PluginLoader;  // Forward declaration
 namespace impl
 {
 
+struct MetricsEntry;  // Forward declaration
+
 typedef std::vector<plugin_loader::PluginLoader *> PluginLoaderVector;
 
 /**
@@ -61,11 +68,18 @@ public:
    */
   AbstractMetaObjectBase(const std::string & class_name, const std::string & base_class_name);
   /**
-   * @brief Destructor for the class. THIS MUST NOT BE VIRTUAL AND OVERRIDDEN BY
-   * TEMPLATE SUBCLASSES, OTHERWISE THEY WILL PULL IN A REDUNDANT METAOBJECT
-   * DESTRUCTOR OUTSIDE OF libplugin_loader WITHIN THE PLUGIN LIBRARY! T
+   * @brief Destructor for the class. The destructors of the template subclasses are in the
+   * plugin library, so the factories of a library that was unmapped are destroyed with
+   * destroyOrphaned() instead.
+   */
+  virtual ~AbstractMetaObjectBase();
+
+  /**
+   * @brief Destroys a factory whose library was unmapped, which leaves its vtable dangling. Only
+   * the destructor of this class runs, the subclass must hold nothing once
+   * releaseLibraryResources() was called.
    */
-  ~AbstractMetaObjectBase();
+  static void destroyOrphaned(AbstractMetaObjectBase * meta_obj);
 
   /**
    * @brief Gets the literal name of the class.
@@ -88,6 +102,11 @@ public:
    */
   std::string getAssociatedLibraryPath();
 
+  /**
+   * @brief Gets the counters of the class, looked up once when the factory is registered
+   */
+  MetricsEntry * getClassMetrics() const {return class_metrics_;}
+
   /**
    * @brief Sets the path to the library associated with this factory
    */
@@ -121,6 +140,13 @@ public:
    */
   PluginLoaderVector getAssociatedPluginLoaders();
 
+  /**
+   * @brief Releases what the factory keeps that needs the code of its library, called when the
+   * factory goes to the graveyard as the library may be unloaded next. The factory must still
+   * work if it is revived from the graveyard.
+   */
+  virtual void releaseLibraryResources() {}
+
 protected:
   /**
    * This is needed to make base class polymorphic (i.e. have a vtable)
@@ -133,6 +159,7 @@ protected:
   std::string base_class_name_;
   std::string class_name_;
   std::string typeid_base_class_name_;
+  MetricsEntry * class_metrics_;
 };
 
 /**
@@ -162,6 +189,29 @@ public:
   /// Create a new instance of a class.
   /// Cannot be used for singletons.
 
+  /**
+   * @brief Gets sizeof() the class this factory creates
+   */
+  virtual std::size_t objectSize() const = 0;
+
+  /**
+   * @brief Gets alignof() the class this factory creates
+   */
+  virtual std::size_t objectAlignment() const = 0;
+
+  /**
+   * @brief Constructs an object in caller provided storage instead of allocating it
+   * @param storage - At least objectSize() bytes aligned on objectAlignment()
+   * @return A pointer of parametric type B to the object constructed in storage
+   */
+  virtual B * constructAt(void * storage) const = 0;
+
+  /**
+   * @brief Destroys an object constructed by constructAt() without releasing its storage
+   * @param obj - The pointer constructAt() returned
+   */
+  virtual void destroyAt(B * obj) const = 0;
+
 private:
   AbstractMetaObject();
   AbstractMetaObject(const AbstractMetaObject &);
@@ -194,6 +244,127 @@ public:
   {
     return new C;
   }
+
+  std::size_t objectSize() const
+  {
+    return sizeof(C);
+  }
+
+  std::size_t objectAlignment() const
+  {
+    return alignof(C);
+  }
+
+  B * constructAt(void * storage) const
+  {
+    return new (storage) C;
+  }
+
+  void destroyAt(B * obj) const
+  {
+    static_cast<C *>(obj)->~C();
+  }
+};
+
+/**
+ * @class PrototypeMetaObject
+ * @brief A factory that copy constructs objects from a prototype, for classes whose default constructor is expensive.
+ * @parm C The derived class (the actual plugin), must be copy constructible
+ * @parm B The base class interface for the plugin
+ */
+template<class C, class B>
+class PrototypeMetaObject : public MetaObject<C, B>
+{
+  static_assert(
+    std::is_copy_constructible<C>::value,
+    "Classes registered with PLUGIN_LOADER_REGISTER_PROTOTYPE_CLASS must be copy constructible");
+
+public:
+  /**
+   * @brief Constructor for the class
+   */
+  PrototypeMetaObject(const std::string & class_name, const std::string & base_class_name)
+  : MetaObject<C, B>(class_name, base_class_name), prototype_(nullptr)
+  {
+  }
+
+  ~PrototypeMetaObject()
+  {
+    delete prototype_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief The factory interface to generate an object, copied from the prototype.
+   * @return A pointer to a newly created plugin with the base class type (type parameter B)
+   */
+  B * create() const
+  {
+    return new C(prototype());
+  }
+
+  B * constructAt(void * storage) const
+  {
+    return new (storage) C(prototype());
+  }
+
+  /**
+   * @brief Destroys the prototype before the library is unloaded, the next create() makes another
+   */
+  void releaseLibraryResources()
+  {
+    std::lock_guard<std::mutex> lock(prototype_mutex_);
+    delete prototype_.exchange(nullptr, std::memory_order_acq_rel);
+  }
+
+private:
+  /**
+   * @brief Gets the prototype, which the first call default constructs. It is owned by the
+   * factory rather than being a static of the plugin library: GCC makes function-local statics of
+   * templates STB_GNU_UNIQUE symbols, which keep a library from ever being unmapped.
+   */
+  const C & prototype() const
+  {
+    C * prototype = prototype_.load(std::memory_order_acquire);
+    if (nullptr == prototype) {
+      std::lock_guard<std::mutex> lock(prototype_mutex_);
+      prototype = prototype_.load(std::memory_order_relaxed);
+      if (nullptr == prototype) {
+        prototype = new C;
+        prototype_.store(prototype, std::memory_order_release);
+      }
+    }
+    return *prototype;
+  }
+
+  mutable std::atomic<C *> prototype_;
+  mutable std::mutex prototype_mutex_;
+};
+
+/**
+ * @class IsolatedMetaObject
+ * @brief Stands in the registry for a factory of a library loaded in its own link-map namespace.
+ *
+ * Such a library registered its factories into the copy of plugin_loader of its namespace. That
+ * factory is left untouched (it belongs to another allocator) and is only used to create objects,
+ * while ownership is tracked on this object.
+ */
+class IsolatedMetaObject final : public AbstractMetaObjectBase
+{
+public:
+  /**
+   * @brief Constructor for the class
+   * @param factory - The factory registered in the namespace of the isolated library
+   */
+  explicit IsolatedMetaObject(AbstractMetaObjectBase * factory);
+
+  /**
+   * @brief Gets the factory this object stands for. It is an AbstractMetaObject of the base class
+   * named by typeidBaseClassName(), though RTTI can not tell it as it lives in another namespace.
+   */
+  AbstractMetaObjectBase * getFactory() const {return factory_;}
+
+private:
+  AbstractMetaObjectBase * factory_;
 };
 
 }  // namespace impl
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLUGIN_LOADER_METRICS_HPP_
+#define PLUGIN_LOADER_METRICS_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "plugin_loader/visibility_control.hpp"
+
+namespace plugin_loader
+{
+
+/**
+ * @brief A latency distribution in fixed buckets: bucket 0 counts durations below 1 us and each following bucket doubles the bound, the last one counting everything above
+ */
+struct LatencyHistogram
+{
+  static const std::size_t kBucketCount = 20;
+
+  /**
+   * @brief Gets the exclusive upper bound of a bucket in nanoseconds, INT64_MAX for the last one
+   */
+  PLUGIN_LOADER_PUBLIC
+  static std::int64_t getBucketUpperBound(std::size_t bucket);
+
+  /**
+   * @brief Gets an upper bound of a percentile, i.e. the upper bound of the bucket it falls in
+   * @param percentile - Between 0 and 100
+   * @return The bound in nanoseconds, max_ns for the last bucket and 0 if nothing was recorded
+   */
+  PLUGIN_LOADER_PUBLIC
+  std::int64_t getPercentileUpperBound(double percentile) const;
+
+  std::uint64_t buckets[kBucketCount];
+  std::uint64_t count;   ///< Sum of the buckets
+  std::int64_t total_ns;
+  std::int64_t max_ns;
+};
+
+/**
+ * @brief The counters of a library, @see getMetrics()
+ */
+struct LibraryMetrics
+{
+  std::string library_path;
+  std::uint64_t loads;              ///< Times a PluginLoader bound the library, opening it if needed
+  std::uint64_t load_failures;
+  std::uint64_t unloads;            ///< Times a PluginLoader unbound the library
+  std::uint64_t unload_failures;
+  std::uint64_t creations;          ///< Plugins created, not counting the ones reused from a pool
+  std::uint64_t creation_failures;
+  std::uint64_t destructions;       ///< Plugins destroyed, not counting the ones returned to a pool
+};
+
+/**
+ * @brief The counters of a plugin class, @see getMetrics()
+ */
+struct ClassMetrics
+{
+  std::string class_name;
+  std::uint64_t creations;
+  std::uint64_t creation_failures;
+};
+
+/**
+ * @brief The metrics of the process, @see getMetrics()
+ */
+struct Metrics
+{
+  std::vector<LibraryMetrics> libraries;  ///< Sorted by path
+  std::vector<ClassMetrics> classes;      ///< Sorted by name
+  LatencyHistogram create_instance;       ///< Creating a plugin, including the factory lookup
+  LatencyHistogram dlopen;                ///< Opening a library, including its static initialization
+  LatencyHistogram registration;          ///< Registering a plugin class when its library is opened
+  LatencyHistogram registry_lock_wait;    ///< Waiting for the mutex of the global factory map
+};
+
+/**
+ * @brief Gets the counters and latency histograms collected since startup or the last resetMetrics().
+ * They are always collected: recording a value is a relaxed atomic increment in a shard of the
+ * calling thread, which getMetrics() sums up. Libraries and classes are never forgotten, so the
+ * ones no longer loaded are reported as well.
+ */
+PLUGIN_LOADER_PUBLIC
+Metrics getMetrics();
+
+/**
+ * @brief Zeroes the counters and latency histograms. Values recorded meanwhile may be lost.
+ */
+PLUGIN_LOADER_PUBLIC
+void resetMetrics();
+
+/**
+ * @brief Where the time went when a library was last opened, @see getLibraryLoadTimes()
+ */
+struct LibraryLoadTimes
+{
+  std::string library_path;
+  std::int64_t total_ns;         ///< impl::loadLibrary() as a whole, including the waits for its locks
+  std::int64_t dlopen_ns;        ///< Opening the library: file I/O, relocation and static initialization
+  std::int64_t registration_ns;  ///< Part of dlopen_ns spent registering plugin classes
+  std::size_t factory_count;     ///< Factories registered, revived or, for an isolated library, imported
+  std::int64_t revive_ns;        ///< Reviving the factories of a previous load from the graveyard
+  std::int64_t purge_ns;         ///< Purging the factories of a previous load from the graveyard
+};
+
+/**
+ * @brief Gets the load time breakdown of the libraries opened so far, by path. A library loaded again is reported for its last load; binding a library that is already open is not a load.
+ */
+PLUGIN_LOADER_PUBLIC
+std::vector<LibraryLoadTimes> getLibraryLoadTimes();
+
+/**
+ * @brief Formats the load time breakdown of the slowest libraries to load as a table, slowest first
+ * @param max_count - How many libraries to report at most
+ */
+PLUGIN_LOADER_PUBLIC
+std::string getSlowestLibrariesReport(std::size_t max_count = 10);
+
+namespace impl
+{
+
+enum class LibraryCounter
+{
+  Load,
+  LoadFailure,
+  Unload,
+  UnloadFailure,
+  Creation,
+  CreationFailure,
+  Destruction
+};
+
+enum class ClassCounter
+{
+  Creation,
+  CreationFailure
+};
+
+enum class LatencyMetric
+{
+  CreateInstance,
+  Dlopen,
+  Registration,
+  RegistryLockWait
+};
+
+/**
+ * @brief The sharded counters of a library or class, which live until the process exits
+ */
+struct MetricsEntry;
+
+/**
+ * @brief Gets the counters of a library, creating them if needed. Each thread caches the lookup.
+ */
+PLUGIN_LOADER_PUBLIC
+MetricsEntry * getLibraryMetrics(const std::string & library_path);
+
+/**
+ * @brief Gets the counters of a plugin class, creating them if needed. Each thread caches the lookup.
+ */
+PLUGIN_LOADER_PUBLIC
+MetricsEntry * getClassMetrics(const std::string & class_name);
+
+PLUGIN_LOADER_PUBLIC
+void incrementCounter(MetricsEntry * entry, LibraryCounter counter);
+
+PLUGIN_LOADER_PUBLIC
+void incrementCounter(MetricsEntry * entry, ClassCounter counter);
+
+/**
+ * @brief Adds a duration to a latency histogram
+ */
+PLUGIN_LOADER_PUBLIC
+void recordLatency(LatencyMetric metric, std::int64_t duration_ns);
+
+/**
+ * @brief Sets where the registrations of the calling thread are accounted, which is the library it is opening
+ * @param load_times - The breakdown of the library, nullptr once it is open
+ */
+PLUGIN_LOADER_PUBLIC
+void setCurrentLibraryLoadTimes(LibraryLoadTimes * load_times);
+
+/**
+ * @brief Records the registration of a plugin class in the latency histogram and the load time breakdown of the library being opened, if any
+ */
+PLUGIN_LOADER_PUBLIC
+void recordRegistration(std::int64_t duration_ns);
+
+/**
+ * @brief Stores the load time breakdown of a library once it is open, @see getLibraryLoadTimes()
+ */
+PLUGIN_LOADER_PUBLIC
+void recordLibraryLoadTimes(const LibraryLoadTimes & load_times);
+
+/**
+ * @brief Gets the clock of the latency histograms, steady_clock in nanoseconds
+ */
+inline std::int64_t getMetricsClock()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @class CreationMetricsScope
+ * @brief Records the creation of a plugin in the latency histogram and counters, as a failure unless succeeded() is called before it is destroyed
+ */
+class CreationMetricsScope
+{
+public:
+  /**
+   * @param library - The counters of the library of the plugin
+   * @param class_name - The class of the plugin, must outlive the scope
+   */
+  CreationMetricsScope(MetricsEntry * library, const std::string & class_name)
+  : library_(library), class_(nullptr), class_name_(class_name), start_ns_(getMetricsClock()),
+    succeeded_(false)
+  {
+  }
+
+  ~CreationMetricsScope()
+  {
+    recordLatency(LatencyMetric::CreateInstance, getMetricsClock() - start_ns_);
+    incrementCounter(
+      library_, succeeded_ ? LibraryCounter::Creation : LibraryCounter::CreationFailure);
+    // The counters are only looked up by name when no factory was found for the class
+    incrementCounter(
+      nullptr != class_ ? class_ : getClassMetrics(class_name_),
+      succeeded_ ? ClassCounter::Creation : ClassCounter::CreationFailure);
+  }
+
+  CreationMetricsScope(const CreationMetricsScope &) = delete;
+  CreationMetricsScope & operator=(const CreationMetricsScope &) = delete;
+
+  /**
+   * @brief Sets the counters of the class, @see AbstractMetaObjectBase::getClassMetrics()
+   */
+  void setClassMetrics(MetricsEntry * class_metrics) {class_ = class_metrics;}
+
+  void succeeded() {succeeded_ = true;}
+
+private:
+  MetricsEntry * library_;
+  MetricsEntry * class_;
+  const std::string & class_name_;
+  std::int64_t start_ns_;
+  bool succeeded_;
+};
+
+}  // namespace impl
+}  // namespace plugin_loader
+
+#endif  // PLUGIN_LOADER_METRICS_HPP_
@@ -32,12 +32,22 @@
 #ifndef PLUGIN_LOADER_MULTI_LIBRARY_plugin_loader_HPP_
 #define PLUGIN_LOADER_MULTI_LIBRARY_plugin_loader_HPP_
 
+#include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <cstddef>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <shared_mutex>
 #include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "plugin_loader/library_watcher.hpp"
+#include "plugin_loader/plugin_index.hpp"
 #include "plugin_loader/plugin_loader.hpp"
 #include "plugin_loader/visibility_control.hpp"
 
@@ -47,6 +57,23 @@ namespace plugin_loader
 typedef std::string LibraryPath;
 typedef std::map<LibraryPath, plugin_loader::PluginLoader *> LibraryToPluginLoaderMap;
 typedef std::vector<PluginLoader *> PluginLoaderVector;
+typedef std::unordered_map<impl::ClassName, LibraryPath> ClassToLibraryMap;
+typedef std::unordered_map<impl::BaseClassName, ClassToLibraryMap> BaseToClassToLibraryMap;
+typedef std::unordered_map<impl::ClassName, std::vector<LibraryPath>> ClassToLibrariesMap;
+typedef std::unordered_map<impl::BaseClassName, ClassToLibrariesMap> BaseToClassToLibrariesMap;
+typedef std::vector<std::pair<impl::BaseClassName, impl::ClassName>> BaseAndClassNameVector;
+typedef std::shared_ptr<const std::vector<std::string>> ClassNameListPtr;
+
+/**
+ * @brief Counters of the residency manager of a MultiLibraryPluginLoader
+ */
+struct ResidencyStatistics
+{
+  std::size_t hits;            ///< Plugins created from a library that was resident
+  std::size_t misses;          ///< Plugins whose library had to be loaded (again)
+  std::size_t evictions;       ///< Libraries unloaded to stay within the budget
+  std::size_t resident_bytes;  ///< Mapped size of the resident libraries
+};
 
 /**
 * @class MultiLibraryPluginLoader
@@ -68,7 +95,7 @@ public:
 
   /**
    * @brief Creates an instance of an object of given class name with ancestor class Base
-   * This version does not look in a specific library for the factory, but rather the first open library that defines the classs
+   * This version does not look in a specific library for the factory, but rather the open library that defines the class and is preferred by the DuplicateClassPolicy. class_name may also be a qualified class name (@see qualifiedClassName())
    * @param Base - polymorphic type indicating base class
    * @param class_name - the name of the concrete plugin class we want to instantiate
    * @return A std::shared_ptr<Base> to newly created plugin
@@ -80,16 +107,17 @@ public:
       "plugin_loader::MultiLibraryPluginLoader: "
       "Attempting to create instance of class type %s.",
       class_name.c_str());
-    PluginLoader * loader = getPluginLoaderForClass<Base>(class_name);
-    if (nullptr == loader) {
-      throw plugin_loader::CreateClassException(
-              "MultiLibraryPluginLoader: Could not create object of class type " +
-              class_name +
-              " as no factory exists for it. Make sure that the library exists and "
-              "was explicitly loaded through MultiLibraryPluginLoader::loadLibrary()");
-    }
-
-    return loader->createSharedInstance<Base>(class_name);
+    return invokeWithPluginLoaderForClass<Base>(
+      class_name, [&class_name](PluginLoader * loader) {
+        if (nullptr == loader) {
+          throw plugin_loader::CreateClassException(
+                  "MultiLibraryPluginLoader: Could not create object of class type " +
+                  class_name +
+                  " as no factory exists for it. Make sure that the library exists and "
+                  "was explicitly loaded through MultiLibraryPluginLoader::loadLibrary()");
+        }
+        return loader->createSharedInstance<Base>(class_name);
+      });
   }
 
   /**
@@ -104,7 +132,10 @@ public:
   std::shared_ptr<Base>
   createSharedInstance(const std::string & class_name, const std::string & library_path)
   {
+    ResidencyScope residency(*this);
+    SharedLock lock(*this);
     PluginLoader * loader = getPluginLoaderForLibrary(library_path);
+    residency.touch(loader);
     if (nullptr == loader) {
       throw plugin_loader::NoPluginLoaderExistsException(
               "Could not create instance as there is no PluginLoader in "
@@ -125,16 +156,17 @@ public:
       "plugin_loader::MultiLibraryPluginLoader: "
       "Attempting to create instance of class type %s.",
       class_name.c_str());
-    PluginLoader * loader = getPluginLoaderForClass<Base>(class_name);
-    if (nullptr == loader) {
-      throw plugin_loader::CreateClassException(
-              "MultiLibraryPluginLoader: Could not create object of class type " +
-              class_name +
-              " as no factory exists for it. Make sure that the library exists and "
-              "was explicitly loaded through MultiLibraryPluginLoader::loadLibrary()");
-    }
-
-    return loader->createInstance<Base>(class_name);
+    return invokeWithPluginLoaderForClass<Base>(
+      class_name, [&class_name](PluginLoader * loader) {
+        if (nullptr == loader) {
+          throw plugin_loader::CreateClassException(
+                  "MultiLibraryPluginLoader: Could not create object of class type " +
+                  class_name +
+                  " as no factory exists for it. Make sure that the library exists and "
+                  "was explicitly loaded through MultiLibraryPluginLoader::loadLibrary()");
+        }
+        return loader->createInstance<Base>(class_name);
+      });
   }
 
   /**
@@ -145,7 +177,10 @@ public:
   std::shared_ptr<Base>
   createInstance(const std::string & class_name, const std::string & library_path)
   {
+    ResidencyScope residency(*this);
+    SharedLock lock(*this);
     PluginLoader * loader = getPluginLoaderForLibrary(library_path);
+    residency.touch(loader);
     if (nullptr == loader) {
       throw plugin_loader::NoPluginLoaderExistsException(
               "Could not create instance as there is no PluginLoader in "
@@ -165,15 +200,17 @@ public:
     logDebug(
       "plugin_loader::MultiLibraryPluginLoader: Attempting to create instance of class type %s.",
       class_name.c_str());
-    PluginLoader * loader = getPluginLoaderForClass<Base>(class_name);
-    if (nullptr == loader) {
-      throw plugin_loader::CreateClassException(
-              "MultiLibraryPluginLoader: Could not create object of class type " + class_name +
-              " as no factory exists for it. "
-              "Make sure that the library exists and was explicitly loaded through "
-              "MultiLibraryPluginLoader::loadLibrary()");
-    }
-    return loader->createUniqueInstance<Base>(class_name);
+    return invokeWithPluginLoaderForClass<Base>(
+      class_name, [&class_name](PluginLoader * loader) {
+        if (nullptr == loader) {
+          throw plugin_loader::CreateClassException(
+                  "MultiLibraryPluginLoader: Could not create object of class type " + class_name +
+                  " as no factory exists for it. "
+                  "Make sure that the library exists and was explicitly loaded through "
+                  "MultiLibraryPluginLoader::loadLibrary()");
+        }
+        return loader->createUniqueInstance<Base>(class_name);
+      });
   }
 
   /**
@@ -184,7 +221,10 @@ public:
   PluginLoader::UniquePtr<Base>
   createUniqueInstance(const std::string & class_name, const std::string & library_path)
   {
+    ResidencyScope residency(*this);
+    SharedLock lock(*this);
     PluginLoader * loader = getPluginLoaderForLibrary(library_path);
+    residency.touch(loader);
     if (nullptr == loader) {
       throw plugin_loader::NoPluginLoaderExistsException(
               "Could not create instance as there is no PluginLoader in "
@@ -194,9 +234,72 @@ public:
     return loader->createUniqueInstance<Base>(class_name);
   }
 
+#ifdef PLUGIN_LOADER_HAS_MEMORY_RESOURCE
+  /**
+   * @brief Creates an instance of an object of given class name with ancestor class Base, allocated from a memory resource
+   * Same as createSharedInstance() except the object and the control block of the std::shared_ptr are allocated from resource (@see PluginLoader::createSharedInstance())
+   */
+  template<class Base>
+  std::shared_ptr<Base>
+  createSharedInstance(const std::string & class_name, std::pmr::memory_resource * resource)
+  {
+    logDebug(
+      "plugin_loader::MultiLibraryPluginLoader: "
+      "Attempting to create instance of class type %s.",
+      class_name.c_str());
+    return invokeWithPluginLoaderForClass<Base>(
+      class_name, [&class_name, resource](PluginLoader * loader) {
+        if (nullptr == loader) {
+          throw plugin_loader::CreateClassException(
+                  "MultiLibraryPluginLoader: Could not create object of class type " +
+                  class_name +
+                  " as no factory exists for it. Make sure that the library exists and "
+                  "was explicitly loaded through MultiLibraryPluginLoader::loadLibrary()");
+        }
+        return loader->createSharedInstance<Base>(class_name, resource);
+      });
+  }
+
+  /**
+   * @brief Creates an instance of an object of given class name with ancestor class Base, allocated from a memory resource
+   * Same as createSharedInstance() except it returns a std::shared_ptr.
+   */
+  template<class Base>
+  std::shared_ptr<Base>
+  createInstance(const std::string & class_name, std::pmr::memory_resource * resource)
+  {
+    return createSharedInstance<Base>(class_name, resource);
+  }
+
+  /**
+   * @brief Creates an instance of an object of given class name with ancestor class Base, allocated from a memory resource
+   * Same as createSharedInstance() except it returns a std::unique_ptr.
+   */
+  template<class Base>
+  PluginLoader::UniquePtr<Base>
+  createUniqueInstance(const std::string & class_name, std::pmr::memory_resource * resource)
+  {
+    logDebug(
+      "plugin_loader::MultiLibraryPluginLoader: "
+      "Attempting to create instance of class type %s.",
+      class_name.c_str());
+    return invokeWithPluginLoaderForClass<Base>(
+      class_name, [&class_name, resource](PluginLoader * loader) {
+        if (nullptr == loader) {
+          throw plugin_loader::CreateClassException(
+                  "MultiLibraryPluginLoader: Could not create object of class type " +
+                  class_name +
+                  " as no factory exists for it. Make sure that the library exists and "
+                  "was explicitly loaded through MultiLibraryPluginLoader::loadLibrary()");
+        }
+        return loader->createUniqueInstance<Base>(class_name, resource);
+      });
+  }
+#endif
+
   /**
    * @brief Creates an instance of an object of given class name with ancestor class Base
-   * This version does not look in a specific library for the factory, but rather the first open library that defines the classs
+   * This version does not look in a specific library for the factory, but rather the open library that defines the class and is preferred by the DuplicateClassPolicy. class_name may also be a qualified class name (@see qualifiedClassName())
    * This version should not be used as the plugin system cannot do automated safe loading/unloadings
    * @param Base - polymorphic type indicating base class
    * @param class_name - the name of the concrete plugin class we want to instantiate
@@ -205,12 +308,14 @@ public:
   template<class Base>
   Base * createUnmanagedInstance(const std::string & class_name)
   {
-    PluginLoader * loader = getPluginLoaderForClass<Base>(class_name);
-    if (nullptr == loader) {
-      throw plugin_loader::CreateClassException(
-              "MultiLibraryPluginLoader: Could not create class of type " + class_name);
-    }
-    return loader->createUnmanagedInstance<Base>(class_name);
+    return invokeWithPluginLoaderForClass<Base>(
+      class_name, [&class_name](PluginLoader * loader) {
+        if (nullptr == loader) {
+          throw plugin_loader::CreateClassException(
+                  "MultiLibraryPluginLoader: Could not create class of type " + class_name);
+        }
+        return loader->createUnmanagedInstance<Base>(class_name);
+      });
   }
 
   /**
@@ -224,7 +329,10 @@ public:
   template<class Base>
   Base * createUnmanagedInstance(const std::string & class_name, const std::string & library_path)
   {
+    ResidencyScope residency(*this);
+    SharedLock lock(*this);
     PluginLoader * loader = getPluginLoaderForLibrary(library_path);
+    residency.touch(loader);
     if (nullptr == loader) {
       throw plugin_loader::NoPluginLoaderExistsException(
               "Could not create instance as there is no PluginLoader in MultiLibraryPluginLoader "
@@ -243,9 +351,14 @@ public:
   template<class Base>
   bool isClassAvailable(const std::string & class_name)
   {
-    std::vector<std::string> available_classes = getAvailableClasses<Base>();
-    return available_classes.end() != std::find(
-      available_classes.begin(), available_classes.end(), class_name);
+    {
+      SharedLock lock(*this);
+      if (nullptr != findIndexedClass(typeid(Base).name(), class_name)) {
+        return true;
+      }
+    }
+    ClassNameListPtr available_classes = getAvailableClassesSnapshot<Base>();
+    return std::binary_search(available_classes->begin(), available_classes->end(), class_name);
   }
 
   /**
@@ -258,18 +371,65 @@ public:
   /**
    * @brief Gets a list of all classes that are loaded by the class loader
    * @param Base - polymorphic type indicating Base class
-   * @return A vector<string> of the available classes
+   * @return A vector<string> of the available classes, sorted and without duplicates
    */
   template<class Base>
   std::vector<std::string> getAvailableClasses()
   {
+    return *getAvailableClassesSnapshot<Base>();
+  }
+
+  /**
+   * @brief Same as getAvailableClasses() but returns a shared immutable list instead of a copy.
+   * The list is cached per Base class and only rebuilt after a library was loaded, unloaded or
+   * indexed, so it is cheap to call repeatedly.
+   * @param Base - polymorphic type indicating Base class
+   * @return A pointer to the sorted list of the available classes, without duplicates
+   */
+  template<class Base>
+  ClassNameListPtr getAvailableClassesSnapshot()
+  {
+    SharedLock lock(*this);
+    const impl::BaseClassName base_class_name = typeid(Base).name();
+    // Read before building the list, so that a change made meanwhile invalidates it
+    const std::size_t registry_generation = impl::getRegistryGeneration();
+    {
+      std::lock_guard<std::mutex> cache_lock(class_list_cache_mutex_);
+      auto cached = class_list_cache_.find(base_class_name);
+      if (cached != class_list_cache_.end() && cached->second.generation == generation_ &&
+        cached->second.registry_generation == registry_generation)
+      {
+        return cached->second.classes;
+      }
+    }
+
     std::vector<std::string> available_classes;
     for (auto & loader : getAllAvailablePluginLoaders()) {
       std::vector<std::string> loader_classes = loader->getAvailableClasses<Base>();
       available_classes.insert(
         available_classes.end(), loader_classes.begin(), loader_classes.end());
     }
-    return available_classes;
+
+    // Classes known from a PluginIndex or from a library unloaded on demand
+    auto indexed = class_index_.find(base_class_name);
+    if (indexed != class_index_.end()) {
+      for (auto & it : indexed->second) {
+        available_classes.push_back(it.first);
+      }
+    }
+
+    std::sort(available_classes.begin(), available_classes.end());
+    available_classes.erase(
+      std::unique(available_classes.begin(), available_classes.end()), available_classes.end());
+
+    CachedClassList cached_list;
+    cached_list.generation = generation_;
+    cached_list.registry_generation = registry_generation;
+    cached_list.classes = std::make_shared<const std::vector<std::string>>(
+      std::move(available_classes));
+    std::lock_guard<std::mutex> cache_lock(class_list_cache_mutex_);
+    class_list_cache_[base_class_name] = cached_list;
+    return cached_list.classes;
   }
 
   /**
@@ -280,6 +440,7 @@ public:
   template<class Base>
   std::vector<std::string> getAvailableClassesForLibrary(const std::string & library_path)
   {
+    SharedLock lock(*this);
     PluginLoader * loader = getPluginLoaderForLibrary(library_path);
     if (nullptr == loader) {
       throw plugin_loader::NoPluginLoaderExistsException(
@@ -308,12 +469,100 @@ public:
    */
   int unloadLibrary(const std::string & library_path);
 
+  /**
+   * @brief Reloads a library from its file, binding it if it is not bound yet.
+   *
+   * The library is copied to a private staging directory and the copy is loaded in the calling
+   * thread without blocking plugin creation. Then the library is atomically rebound to the new
+   * copy: plugins created from then on use the new code, while the plugins created before keep the
+   * previous copy mapped until the last of them is destroyed. The copy is loaded in isolation (see
+   * PluginLoader::PluginLoader()) when the library links against plugin_loader as a shared library.
+   * Otherwise plugin classes should have hidden visibility (e.g. -fvisibility=hidden), or the
+   * dynamic linker binds the new copy to the definitions of the previous one.
+   *
+   * @param library_path - the fully qualified path to the runtime library
+   * @throws LibraryLoadException if the new version cannot be loaded, the previous one then stays in use
+   */
+  void reloadLibrary(const std::string & library_path);
+
+  /**
+   * @brief Watches the file of a library with inotify and calls reloadLibrary() whenever it is rewritten or replaced while the library is bound. The library is bound (through reloadLibrary()) if needed, so that it is loaded from a staged copy that can safely be overwritten.
+   * @param library_path - the fully qualified path to the runtime library
+   * @throws LibraryLoadException if the library cannot be loaded or watched
+   */
+  void enableHotReload(const std::string & library_path);
+
+  /**
+   * @brief Stops watching the file of a library, the library stays bound
+   * @param library_path - the fully qualified path to the runtime library
+   */
+  void disableHotReload(const std::string & library_path);
+
+  /**
+   * @brief Makes the classes of an index known to this class loader without loading their libraries. A library of the index is loaded the first time one of its classes is requested.
+   * @param index - An index of plugin libraries, @see PluginIndex
+   */
+  void loadIndex(const PluginIndex & index);
+
+  /**
+   * @brief Sets the memory budget of the bound libraries. Whenever their mapped size exceeds it, the least recently used libraries without live plugins are unloaded until it fits again. They stay bound and their classes stay known, the next creation of one of their plugins loads them again. Nothing is unloaded once an unmanaged plugin has been created. Meant for loaders without on-demand load/unload, whose libraries already leave memory with their last plugin.
+   * @param budget_bytes - The budget in bytes, 0 (the default) disables it
+   */
+  void setResidencyBudget(std::size_t budget_bytes);
+
+  /**
+   * @brief Gets the memory budget of the bound libraries, 0 if disabled
+   */
+  std::size_t getResidencyBudget() const {return residency_budget_.load();}
+
+  /**
+   * @brief Gets the counters of the residency manager, @see setResidencyBudget()
+   */
+  ResidencyStatistics getResidencyStatistics();
+
+  /**
+   * @brief Enables or disables tracking of the managed plugins in all the class loaders, including the ones of libraries bound later, @see PluginLoader::setInstanceTrackingEnabled()
+   */
+  void setInstanceTrackingEnabled(bool enabled);
+
+  /**
+   * @brief Gets the tracked plugins of a library that have not been destroyed yet, oldest first. Plugins created while tracking was disabled are not reported, nor the ones created before the library was last reloaded.
+   * @param library_path - the fully qualified path to the runtime library
+   */
+  std::vector<InstanceInfo> getLiveInstances(const std::string & library_path);
+
 private:
   /**
    * @brief Indicates if on-demand (lazy) load/unload is enabled so libraries are loaded/unloaded automatically as needed
    */
   bool isOnDemandLoadUnloadEnabled() {return enable_ondemand_loadunload_;}
 
+  /**
+   * @brief Calls a function with the class loader corresponding to a specific class while holding loader_mutex_, so that the class loader cannot be destroyed meanwhile. Classes of the class index whose library is bound are resolved under a shared lock so that concurrent calls never wait on each other, other classes may need to load or index libraries and are resolved under an exclusive lock.
+   * @param class_name - name of class for which we want to create instance
+   * @param function - the function to call, receives nullptr if the class was not found
+   * @return What the function returns
+   */
+  template<typename Base, typename Function>
+  auto invokeWithPluginLoaderForClass(const std::string & class_name, Function function)
+  -> decltype(function(static_cast<PluginLoader *>(nullptr)))
+  {
+    ResidencyScope residency(*this);
+    {
+      SharedLock lock(*this);
+      PluginLoader * loader = getPluginLoaderForIndexedClass(typeid(Base).name(), class_name);
+      if (nullptr != loader) {
+        residency.touch(loader);
+        return function(loader);
+      }
+    }
+    ExclusiveLock lock(*this);
+    PluginLoader * loader = getPluginLoaderForClass<Base>(class_name);
+    residency.touch(loader);
+    residency.checkBudget();  // Libraries may have been loaded to find the class
+    return function(loader);
+  }
+
   /**
    * @brief Gets a handle to the class loader corresponding to a specific runtime library
    * @param library_path - the library from which we want to create the plugin
@@ -321,6 +570,13 @@ private:
    */
   PluginLoader * getPluginLoaderForLibrary(const std::string & library_path);
 
+  /**
+   * @brief Gets a handle to the class loader corresponding to a class of the class index, without loading or binding any library
+   * @return A pointer to the PluginLoader*, == nullptr if the class is not indexed or its library is not bound to a PluginLoader yet
+   */
+  PluginLoader * getPluginLoaderForIndexedClass(
+    const std::string & base_class_name, const std::string & class_name);
+
   /**
    * @brief Gets a handle to the class loader corresponding to a specific class
    * @param class_name - name of class for which we want to create instance
@@ -329,32 +585,235 @@ private:
   template<typename Base>
   PluginLoader * getPluginLoaderForClass(const std::string & class_name)
   {
-    PluginLoaderVector loaders = getAllAvailablePluginLoaders();
-    for (PluginLoaderVector::iterator i = loaders.begin(); i != loaders.end(); ++i) {
-      if (!(*i)->isLibraryLoaded()) {
-        (*i)->loadLibrary();
-      }
-      if ((*i)->isClassAvailable<Base>(class_name)) {
-        return *i;
-      }
-    }
-    return nullptr;
+    return getPluginLoaderForClass(typeid(Base).name(), class_name);
   }
 
+  /**
+   * @brief Gets a handle to the class loader corresponding to a specific class. Only the library that owns the class is loaded if the class is in the class index, otherwise the libraries whose classes are still unknown are loaded and indexed one at a time until the class is found.
+   * @param base_class_name - typeid name of the base class
+   * @param class_name - name of class for which we want to create instance
+   * @return A pointer to the PluginLoader*, == nullptr if not found
+   */
+  PluginLoader * getPluginLoaderForClass(
+    const std::string & base_class_name, const std::string & class_name);
+
+  /**
+   * @brief Looks up the library that provides a class in the class index
+   * @param class_name - The literal or qualified name of the class
+   * @return A pointer to the library path, == nullptr if the class is not indexed
+   */
+  const LibraryPath * findIndexedClass(
+    const std::string & base_class_name, const std::string & class_name);
+
+  /**
+   * @brief Chooses the library the DuplicateClassPolicy prefers among the indexed libraries that provide the same class
+   * @param libraries - The libraries providing the class, in index order
+   * @return A pointer to one of the libraries
+   */
+  const LibraryPath * findPreferredLibrary(
+    const std::string & base_class_name, const std::string & class_name,
+    const std::vector<LibraryPath> & libraries);
+
+  /**
+   * @brief Adds the classes of a library to the class index, replacing the ones it previously had. Classes already provided by another library resolve to the library the DuplicateClassPolicy prefers, the qualified class names always resolve to their library.
+   */
+  void indexLibrary(const std::string & library_path, const BaseAndClassNameVector & classes);
+
+  /**
+   * @brief Removes the classes of a library from the class index. Classes that are also provided by another indexed library resolve to it from then on.
+   */
+  void forgetLibrary(const std::string & library_path);
+
   /**
    * @brief Gets all class loaders loaded within scope
    */
   PluginLoaderVector getAllAvailablePluginLoaders();
 
+  /**
+   * @brief Implementation of loadLibrary(), loader_mutex_ must be locked exclusively
+   */
+  void loadLibraryInternal(const std::string & library_path);
+
+  /**
+   * @brief Implementation of unloadLibrary(), loader_mutex_ must be locked exclusively
+   */
+  int unloadLibraryInternal(const std::string & library_path);
+
   /**
    * @brief Destroys all PluginLoaders
    */
   void shutdownAllPluginLoaders();
 
+  /**
+   * @brief Copies a library to the staging directory, creating the directory if needed
+   * @return The path of the copy
+   * @throws LibraryLoadException if the library cannot be copied
+   */
+  std::string stageLibrary(const std::string & library_path);
+
+  /**
+   * @brief Records that a plugin is about to be created by a class loader, loader_mutex_ must be locked
+   * @return false if its library is not resident and is about to be loaded
+   */
+  bool touchLibrary(const PluginLoader * loader);
+
+  /**
+   * @brief Starts tracking the residency of a newly bound class loader, loader_mutex_ must be locked exclusively
+   */
+  void trackResidency(const PluginLoader * loader);
+
+  /**
+   * @brief Unloads the least recently used idle libraries while the resident ones exceed the budget
+   */
+  void enforceResidencyBudget();
+
+  /**
+   * @brief Destroys the PluginLoaders replaced by reloadLibrary() whose plugins have all been destroyed
+   * @param force - Destroy them even if some of their plugins still exist
+   */
+  void collectRetiredPluginLoaders(bool force);
+
+  /**
+   * @brief A PluginLoader replaced by reloadLibrary(), kept until its plugins are destroyed
+   */
+  struct RetiredPluginLoader
+  {
+    PluginLoader * loader;
+    std::string staged_path;  ///< The staged copy of the library it uses, if any
+  };
+
+  /**
+   * @brief Locks loader_mutex_ shared. Waits first while an exclusive lock is pending, so that a steady flow of creations cannot starve loads and unloads.
+   */
+  class SharedLock
+  {
+public:
+    explicit SharedLock(MultiLibraryPluginLoader & owner)
+    : lock_(owner.loader_mutex_, std::defer_lock)
+    {
+      if (owner.pending_exclusive_locks_.load() > 0) {
+        std::lock_guard<std::mutex> gate(owner.exclusive_gate_);
+      }
+      lock_.lock();
+    }
+
+private:
+    std::shared_lock<std::shared_timed_mutex> lock_;
+  };
+
+  /**
+   * @brief Locks loader_mutex_ exclusively, holding exclusive_gate_ meanwhile so that new shared locks wait
+   */
+  class ExclusiveLock
+  {
+public:
+    explicit ExclusiveLock(MultiLibraryPluginLoader & owner)
+    : owner_(owner)
+    {
+      ++owner_.pending_exclusive_locks_;
+      owner_.exclusive_gate_.lock();
+      owner_.loader_mutex_.lock();
+    }
+
+    ~ExclusiveLock()
+    {
+      owner_.loader_mutex_.unlock();
+      owner_.exclusive_gate_.unlock();
+      --owner_.pending_exclusive_locks_;
+    }
+
+private:
+    MultiLibraryPluginLoader & owner_;
+  };
+
+  /**
+   * @brief Records the libraries used by a creation and calls enforceResidencyBudget() when destroyed if one of them had to be loaded. Must be constructed before the lock of the creation is taken, so that it is released by then.
+   */
+  class ResidencyScope
+  {
+public:
+    explicit ResidencyScope(MultiLibraryPluginLoader & owner)
+    : owner_(owner), check_budget_(false)
+    {
+    }
+
+    ~ResidencyScope()
+    {
+      if (check_budget_) {
+        owner_.enforceResidencyBudget();
+      }
+    }
+
+    void touch(const PluginLoader * loader)
+    {
+      if (nullptr != loader && !owner_.touchLibrary(loader)) {
+        check_budget_ = true;
+      }
+    }
+
+    void checkBudget() {check_budget_ = true;}
+
+private:
+    MultiLibraryPluginLoader & owner_;
+    bool check_budget_;
+  };
+
+  /**
+   * @brief Residency of the library of a bound class loader
+   */
+  struct LibraryResidency
+  {
+    LibraryResidency()
+    : resident(false), last_use(0), mapped_bytes(0)
+    {
+    }
+
+    std::atomic<bool> resident;
+    std::atomic<std::int64_t> last_use;  ///< steady_clock ticks of the last creation
+    std::atomic<std::size_t> mapped_bytes;  ///< 0 until measured
+  };
+
+  /**
+   * @brief A list of available classes cached by getAvailableClassesSnapshot()
+   */
+  struct CachedClassList
+  {
+    std::size_t generation;           ///< generation_ when the list was built
+    std::size_t registry_generation;  ///< impl::getRegistryGeneration() when the list was built
+    ClassNameListPtr classes;
+  };
+
 private:
   bool enable_ondemand_loadunload_;
   LibraryToPluginLoaderMap active_plugin_loaders_;
-  std::mutex loader_mutex_;
+  BaseToClassToLibraryMap class_index_;
+  BaseToClassToLibraryMap qualified_class_index_;  // Keyed by qualifiedClassName()
+  BaseToClassToLibrariesMap duplicate_class_index_;  // Classes provided by several libraries
+  std::vector<std::pair<LibraryPath, BaseAndClassNameVector>> indexed_libraries_;  // Index order
+  // Creations hold it shared, loads and unloads exclusively. Private methods expect it to be held.
+  std::shared_timed_mutex loader_mutex_;
+  std::mutex exclusive_gate_;
+  std::atomic<int> pending_exclusive_locks_;
+  // Changes whenever a library is bound, unbound, indexed or forgotten, under loader_mutex_
+  std::size_t generation_;
+  std::unordered_map<impl::BaseClassName, CachedClassList> class_list_cache_;
+  std::mutex class_list_cache_mutex_;
+  // Staged copy used by the PluginLoader of a hot reloaded library, under loader_mutex_
+  std::unordered_map<LibraryPath, std::string> staged_libraries_;
+  std::mutex reload_mutex_;  // Serializes reloadLibrary()
+  // The members below are guarded by hot_reload_mutex_
+  std::mutex hot_reload_mutex_;
+  std::string staging_directory_;
+  std::size_t staged_library_count_;
+  std::vector<RetiredPluginLoader> retired_plugin_loaders_;
+  std::unique_ptr<impl::LibraryWatcher> library_watcher_;
+  // Residency manager, residency_ is guarded by loader_mutex_
+  std::unordered_map<const PluginLoader *, LibraryResidency> residency_;
+  std::atomic<std::size_t> residency_budget_;
+  std::atomic<std::size_t> residency_hits_;
+  std::atomic<std::size_t> residency_misses_;
+  std::atomic<std::size_t> residency_evictions_;
+  std::atomic<bool> instance_tracking_enabled_;
 };
 
 
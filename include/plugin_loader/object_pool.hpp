@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PLUGIN_LOADER_OBJECT_POOL_HPP_
+#define PLUGIN_LOADER_OBJECT_POOL_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "plugin_loader/console.h"
+#include "plugin_loader/visibility_control.hpp"
+
+namespace plugin_loader
+{
+namespace impl
+{
+
+/**
+ * @class ObjectPoolBase
+ * @brief Keeps idle plugin objects of one class for reuse, regardless of their type.
+ *
+ * Each thread keeps a few idle objects of its own, so that a thread releasing and acquiring
+ * objects does not contend with the others. The objects a thread cannot keep go to an overflow
+ * shared by all threads, up to the capacity of the pool; the ones beyond are destroyed.
+ */
+class PLUGIN_LOADER_PUBLIC ObjectPoolBase
+{
+public:
+  /**
+   * @brief Constructor for the class
+   * @param capacity - Maximum number of idle objects in the shared overflow
+   */
+  explicit ObjectPoolBase(std::size_t capacity);
+
+  /**
+   * @brief Destructor for the class. Subclasses must call shutdown() from their own destructor.
+   */
+  virtual ~ObjectPoolBase();
+
+  /**
+   * @brief Destroys all the idle objects, including the ones kept by threads
+   */
+  void drain();
+
+  /**
+   * @brief Sets the maximum number of idle objects in the shared overflow, 0 disables pooling
+   */
+  void setCapacity(std::size_t capacity);
+
+protected:
+  /**
+   * @brief Takes an idle object out of the pool
+   * @return The object, nullptr if the pool is empty
+   */
+  void * acquireObject();
+
+  /**
+   * @brief Puts an object back into the pool
+   * @return false if the pool is full, the object then belongs to the caller again
+   */
+  bool releaseObject(void * obj);
+
+  /**
+   * @brief Detaches the pool from the threads and drains it
+   */
+  void shutdown();
+
+  /**
+   * @brief Destroys an object the pool no longer keeps
+   */
+  virtual void destroyObject(void * obj) = 0;
+
+private:
+  struct ThreadCache;
+  struct ThreadCacheRegistry;
+
+  ThreadCache & getThreadCache();
+  void adoptThreadCache(const std::shared_ptr<ThreadCache> & cache);
+
+  const std::uint64_t id_;
+  std::atomic<std::size_t> capacity_;
+  std::mutex mutex_;  // Taken before the mutexes of the thread caches
+  std::vector<void *> overflow_;
+  std::vector<std::shared_ptr<ThreadCache>> thread_caches_;
+};
+
+template<class T, class = void>
+struct HasResetMethod : std::false_type {};
+
+template<class T>
+struct HasResetMethod<T, decltype(std::declval<T &>().reset(), void())>: std::true_type {};
+
+template<class Base>
+bool resetPooledObject(Base * obj, std::true_type)
+{
+  try {
+    obj->reset();
+  } catch (...) {
+    logWarn("%s",
+      "plugin_loader.impl.ObjectPool: reset() threw, the object is destroyed instead of pooled.");
+    return false;
+  }
+  return true;
+}
+
+template<class Base>
+bool resetPooledObject(Base *, std::false_type)
+{
+  return true;
+}
+
+/**
+ * @class ObjectPool
+ * @brief Keeps idle plugin objects of one class derived from Base for reuse. When Base has a reset() method it is called on objects before they are pooled.
+ */
+template<class Base>
+class ObjectPool final : public ObjectPoolBase
+{
+public:
+  explicit ObjectPool(std::size_t capacity)
+  : ObjectPoolBase(capacity)
+  {
+  }
+
+  ~ObjectPool() override
+  {
+    shutdown();
+  }
+
+  /**
+   * @brief Takes an idle object out of the pool
+   * @return The object, nullptr if the pool is empty
+   */
+  Base * acquire()
+  {
+    return static_cast<Base *>(acquireObject());
+  }
+
+  /**
+   * @brief Resets an object and puts it back into the pool
+   * @return false if it could not be reset or the pool is full, the object then has to be deleted
+   */
+  bool release(Base * obj)
+  {
+    return resetPooledObject(obj, HasResetMethod<Base>()) && releaseObject(obj);
+  }
+
+protected:
+  void destroyObject(void * obj) override
+  {
+    delete static_cast<Base *>(obj);
+  }
+};
+
+}  // namespace impl
+}  // namespace plugin_loader
+
+#endif  // PLUGIN_LOADER_OBJECT_POOL_HPP_
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLUGIN_LOADER_PLUGIN_INDEX_HPP_
+#define PLUGIN_LOADER_PLUGIN_INDEX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "plugin_loader/visibility_control.hpp"
+
+namespace plugin_loader
+{
+
+/**
+ * @class PluginIndex
+ * @brief An index of the plugin classes exported by the runtime libraries of a directory.
+ *
+ * Discovering the classes of a library requires opening it, which is expensive when a directory
+ * holds many libraries. A PluginIndex remembers, for every library, the classes it registered
+ * together with the identity of the file (device, inode, size and modification time), so that it
+ * can be persisted with save(), memory mapped back with load() and revalidated by scanDirectory(),
+ * which only opens the libraries that were added or modified since the index was built.
+ */
+class PLUGIN_LOADER_PUBLIC PluginIndex
+{
+public:
+  /**
+   * @brief A class registered by an indexed library
+   */
+  struct ClassEntry
+  {
+    std::string base_class_name;  ///< The base class name as typeid(Base).name() returns it
+    std::string class_name;       ///< The literal name of the derived class
+  };
+
+  /**
+   * @brief An indexed library and the identity of the file it was discovered from
+   */
+  struct LibraryEntry
+  {
+    std::string library_path;
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::uint64_t size;
+    std::int64_t mtime_ns;
+    std::vector<ClassEntry> classes;
+  };
+
+  typedef std::vector<LibraryEntry> LibraryEntryVector;
+
+  /**
+   * @brief Constructor for the class, the index is initially empty
+   */
+  PluginIndex();
+
+  /**
+   * @brief Replaces the content of the index with the one of a file written by save()
+   * @param index_path - The path of the index file
+   * @return true if the file was read, false if it does not exist or is not a valid index (the index is then left empty)
+   */
+  bool load(const std::string & index_path);
+
+  /**
+   * @brief Writes the index to a file. The file is replaced atomically.
+   * @param index_path - The path of the index file
+   * @throws PluginIndexException if the file cannot be written
+   */
+  void save(const std::string & index_path) const;
+
+  /**
+   * @brief Revalidates the index against the runtime libraries of a directory. Libraries whose file identity did not change keep their entry, new or modified ones are opened to discover their classes and the entries of removed libraries are dropped.
+   * @param directory_path - The directory containing the runtime libraries
+   * @return The number of libraries that had to be opened
+   * @throws PluginIndexException if the directory cannot be read
+   */
+  std::size_t scanDirectory(const std::string & directory_path);
+
+  /**
+   * @brief Loads the index from a file, revalidates it against a directory and writes it back if anything changed
+   * @param directory_path - The directory containing the runtime libraries
+   * @param index_path - The path of the index file
+   * @return The number of libraries that had to be opened
+   */
+  std::size_t update(const std::string & directory_path, const std::string & index_path);
+
+  /**
+   * @brief Gets the indexed libraries
+   */
+  const LibraryEntryVector & getLibraries() const {return libraries_;}
+
+private:
+  LibraryEntryVector libraries_;
+};
+
+}  // namespace plugin_loader
+
+#endif  // PLUGIN_LOADER_PLUGIN_INDEX_HPP_
@@ -32,15 +32,32 @@
 #ifndef plugin_loader_plugin_loader_HPP_
 #define plugin_loader_plugin_loader_HPP_
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <cstddef>
 #include <string>
+#include <utility>
 #include <vector>
 #include <algorithm>
 #include <assert.h>
 
+// std::pmr is only available from C++17 on, the rest of the library only needs C++14
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define PLUGIN_LOADER_HAS_MEMORY_RESOURCE 1
+#endif
+#endif
+
+#include "plugin_loader/event_trace.hpp"
+#include "plugin_loader/instance_tracker.hpp"
+#include "plugin_loader/library_reaper.hpp"
+#include "plugin_loader/metrics.hpp"
+#include "plugin_loader/object_pool.hpp"
 #include "plugin_loader/plugin_loader_core.hpp"
 #include "plugin_loader/register_macro.hpp"
 #include "plugin_loader/visibility_control.hpp"
@@ -48,6 +65,15 @@
 namespace plugin_loader
 {
 
+/**
+ * @brief Size and alignment of a plugin class, @see PluginLoader::createInstanceIn()
+ */
+struct ObjectLayout
+{
+  std::size_t size;
+  std::size_t alignment;
+};
+
 /**
  * @class PluginLoader
  * @brief This class allows loading and unloading of dynamically linked libraries which contain class definitions from which objects can be created/destroyed during runtime (i.e. plugin_loader). Libraries loaded by a PluginLoader are only accessible within scope of that PluginLoader object.
@@ -65,9 +91,13 @@ public:
    * @brief  Constructor for PluginLoader
    * @param library_path - The path of the runtime library to load
    * @param ondemand_load_unload - Indicates if on-demand (lazy) unloading/loading of libraries occurs as plugins are created/destroyed
+   * @param isolated - Loads the library with dlmopen() into a link-map namespace of its own, so that
+   * this copy shares no symbols and no static state with any other. The plugins must link against
+   * plugin_loader as a shared library; see getLibraryKey() for how such a copy is told apart.
    */
   PLUGIN_LOADER_PUBLIC
-  explicit PluginLoader(const std::string & library_path, bool ondemand_load_unload = false);
+  explicit PluginLoader(
+    const std::string & library_path, bool ondemand_load_unload = false, bool isolated = false);
 
   /**
    * @brief  Destructor for PluginLoader. All libraries opened by this PluginLoader are unloaded automatically.
@@ -86,10 +116,23 @@ public:
   }
 
   /**
-   * @brief Gets the full-qualified path and name of the library associated with this class loader
+   * @brief Gets the full-qualified path and name of the library associated with this class loader.
+   */
+  PLUGIN_LOADER_PUBLIC
+  std::string getLibraryPath() const {return library_path_;}
+
+  /**
+   * @brief Gets the name the library is registered under by plugin_loader::impl. It is the library
+   * path, followed for an isolated loader by '@' and a number telling its copy apart from the others.
+   */
+  PLUGIN_LOADER_PUBLIC
+  const std::string & getLibraryKey() const {return library_key_;}
+
+  /**
+   * @brief Indicates if the library is loaded into a link-map namespace of its own
    */
   PLUGIN_LOADER_PUBLIC
-  std::string getLibraryPath() {return library_path_;}
+  bool isIsolated() const {return isolated_;}
 
   /**
    * @brief  Generates an instance of loadable classes (i.e. plugin_loader).
@@ -103,9 +146,13 @@ public:
   template<class Base>
   std::shared_ptr<Base> createSharedInstance(const std::string & derived_class_name)
   {
+    Base * obj = createRawInstance<Base>(derived_class_name, true);
+    impl::InstanceNode * node = instance_tracker_.track(obj, derived_class_name, library_path_);
     return std::shared_ptr<Base>(
-      createRawInstance<Base>(derived_class_name, true),
-      std::bind(&PluginLoader::onPluginDeletion<Base>, this, std::placeholders::_1));
+      obj, [this, node](Base * obj) {
+        instance_tracker_.untrack(node);
+        onPluginDeletion<Base>(obj);
+      });
   }
 
   /**
@@ -116,9 +163,7 @@ public:
   template<class Base>
   std::shared_ptr<Base> createInstance(const std::string & derived_class_name)
   {
-    return std::shared_ptr<Base>(
-      createRawInstance<Base>(derived_class_name, true),
-      std::bind(&PluginLoader::onPluginDeletion<Base>, this, std::placeholders::_1));
+    return createSharedInstance<Base>(derived_class_name);
   }
 
   /**
@@ -137,11 +182,201 @@ public:
   UniquePtr<Base> createUniqueInstance(const std::string & derived_class_name)
   {
     Base * raw = createRawInstance<Base>(derived_class_name, true);
+    impl::InstanceNode * node = instance_tracker_.track(raw, derived_class_name, library_path_);
     return std::unique_ptr<Base, DeleterType<Base>>(
-      raw,
-      std::bind(&PluginLoader::onPluginDeletion<Base>, this, std::placeholders::_1));
+      raw, [this, node](Base * obj) {
+        instance_tracker_.untrack(node);
+        onPluginDeletion<Base>(obj);
+      });
+  }
+
+#ifdef PLUGIN_LOADER_HAS_MEMORY_RESOURCE
+  /**
+   * @brief  Generates an instance of loadable classes (i.e. plugin_loader) allocated from a memory resource.
+   *
+   * The object is constructed in memory allocated from resource, along with the control block of
+   * the std::shared_ptr, and the memory is returned to resource when the object is destroyed.
+   * resource must outlive the returned pointer. Only available from C++17 on.
+   *
+   * @param  derived_class_name The name of the class we want to create (@see getAvailableClasses())
+   * @param  resource The memory resource to allocate from
+   * @return A std::shared_ptr<Base> to newly created plugin object
+   */
+  template<class Base>
+  std::shared_ptr<Base>
+  createSharedInstance(const std::string & derived_class_name, std::pmr::memory_resource * resource)
+  {
+    ResourceBlock<Base> * block = nullptr;
+    Base * obj = createRawInstanceFrom<Base>(derived_class_name, resource, block);
+    return std::shared_ptr<Base>(
+      obj, [this, block](Base * obj) {onResourcePluginDeletion<Base>(block, obj);},
+      std::pmr::polymorphic_allocator<char>(resource));
+  }
+
+  /**
+   * @brief  Generates an instance of loadable classes (i.e. plugin_loader) allocated from a memory resource.
+   *
+   * Same as createSharedInstance() except it returns a std::shared_ptr.
+   */
+  template<class Base>
+  std::shared_ptr<Base>
+  createInstance(const std::string & derived_class_name, std::pmr::memory_resource * resource)
+  {
+    return createSharedInstance<Base>(derived_class_name, resource);
+  }
+
+  /**
+   * @brief  Generates an instance of loadable classes (i.e. plugin_loader) allocated from a memory resource.
+   *
+   * Same as createSharedInstance() except it returns a std::unique_ptr.
+   */
+  template<class Base>
+  UniquePtr<Base>
+  createUniqueInstance(const std::string & derived_class_name, std::pmr::memory_resource * resource)
+  {
+    ResourceBlock<Base> * block = nullptr;
+    Base * obj = createRawInstanceFrom<Base>(derived_class_name, resource, block);
+    // Capturing two pointers keeps the std::function from allocating
+    return UniquePtr<Base>(
+      obj, [this, block](Base * obj) {onResourcePluginDeletion<Base>(block, obj);});
+  }
+#endif
+
+  /**
+   * @brief  Generates an instance of loadable classes (i.e. plugin_loader), reusing an idle one if possible.
+   *
+   * Destroying the returned pointer returns the instance to a pool of its class rather than
+   * deleting it, after calling its reset() method if Base has one. Each thread keeps a few idle
+   * instances, the other ones are shared by all threads up to getObjectPoolCapacity() and the ones
+   * beyond are deleted. The pools are drained before the library is unloaded.
+   *
+   * @param  derived_class_name The name of the class we want to create (@see getAvailableClasses())
+   * @return A std::unique_ptr<Base> to a new or recycled plugin object
+   */
+  template<class Base>
+  UniquePtr<Base> createPooledInstance(const std::string & derived_class_name)
+  {
+    impl::ObjectPool<Base> * pool = &getObjectPool<Base>(derived_class_name);
+    if (isOnDemandLoadUnloadEnabled() && impl::LibraryReaper::instance().isRetentionEnabled()) {
+      impl::LibraryReaper::instance().markBusy(this);
+    }
+    // Taking a reference first keeps the library loaded, and so the pool from being drained,
+    // while an idle instance is taken out of it
+    {
+      std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+      ++plugin_ref_count_;
+    }
+    Base * obj = pool->acquire();
+    if (nullptr == obj) {
+      try {
+        obj = createRawInstance<Base>(derived_class_name, true);
+      } catch (...) {
+        std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+        --plugin_ref_count_;
+        throw;
+      }
+      // createRawInstance() took a reference of its own
+      std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+      --plugin_ref_count_;
+    }
+    impl::InstanceNode * node = instance_tracker_.track(obj, derived_class_name, library_path_);
+    if (nullptr != node) {
+      return UniquePtr<Base>(
+        obj, [this, pool, node](Base * obj) {
+          instance_tracker_.untrack(node);
+          onPooledPluginDeletion<Base>(pool, obj);
+        });
+    }
+    // Capturing two pointers keeps the std::function from allocating
+    return UniquePtr<Base>(
+      obj, [this, pool](Base * obj) {onPooledPluginDeletion<Base>(pool, obj);});
+  }
+
+  /**
+   * @brief  Gets the size and alignment of a plugin class, which is what createInstanceIn() needs. The library is loaded if needed.
+   * @param  derived_class_name The name of the class (@see getAvailableClasses())
+   */
+  template<class Base>
+  ObjectLayout getObjectLayout(const std::string & derived_class_name)
+  {
+    loadLibraryForCreation();
+    impl::AbstractMetaObject<Base> * factory = nullptr;
+    try {
+      factory = impl::getFactory<Base>(derived_class_name, this);
+    } catch (...) {
+      releaseCreationReference();
+      throw;
+    }
+    {
+      // No plugin was created, but the library stays loaded for createInstanceIn()
+      std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+      --plugin_ref_count_;
+    }
+    return ObjectLayout{factory->objectSize(), factory->objectAlignment()};
+  }
+
+  /**
+   * @brief  Generates an instance of loadable classes (i.e. plugin_loader) in caller provided storage.
+   *
+   * Nothing is allocated: the object is constructed in storage, and destroying the returned
+   * pointer only runs its destructor. The storage must outlive the returned pointer.
+   *
+   * @param  derived_class_name The name of the class we want to create (@see getAvailableClasses())
+   * @param  storage Where to construct the object, @see getObjectLayout() for its requirements
+   * @param  size The size of storage in bytes
+   * @return A std::unique_ptr<Base> to the plugin object constructed in storage
+   * @throws CreateClassException if storage is too small or misaligned for the class
+   */
+  template<class Base>
+  UniquePtr<Base>
+  createInstanceIn(const std::string & derived_class_name, void * storage, std::size_t size)
+  {
+    loadLibraryForCreation();
+    impl::AbstractMetaObject<Base> * factory = nullptr;
+    Base * obj = nullptr;
+    try {
+      impl::TraceScope trace(TraceEventType::Create, derived_class_name);
+      impl::CreationMetricsScope metrics(library_metrics_, derived_class_name);
+      factory = impl::getFactory<Base>(derived_class_name, this);
+      metrics.setClassMetrics(factory->getClassMetrics());
+      if (size < factory->objectSize() ||
+        0 != reinterpret_cast<std::uintptr_t>(storage) % factory->objectAlignment())
+      {
+        throw plugin_loader::CreateClassException(
+                "Could not create instance of type " + derived_class_name + " as it needs " +
+                std::to_string(factory->objectSize()) + " bytes aligned on " +
+                std::to_string(factory->objectAlignment()) + " bytes");
+      }
+      obj = factory->constructAt(storage);
+      metrics.succeeded();
+    } catch (...) {
+      releaseCreationReference();
+      throw;
+    }
+    impl::InstanceNode * node = instance_tracker_.track(obj, derived_class_name, library_path_);
+    if (nullptr != node) {
+      return UniquePtr<Base>(
+        obj, [this, factory, node](Base * obj) {
+          instance_tracker_.untrack(node);
+          onPlacedPluginDeletion<Base>(factory, obj);
+        });
+    }
+    return UniquePtr<Base>(
+      obj, [this, factory](Base * obj) {onPlacedPluginDeletion<Base>(factory, obj);});
   }
 
+  /**
+   * @brief Sets how many idle instances of each class the pools of createPooledInstance() share between threads, 0 disables pooling
+   */
+  PLUGIN_LOADER_PUBLIC
+  void setObjectPoolCapacity(std::size_t capacity);
+
+  /**
+   * @brief Gets how many idle instances of each class the pools of createPooledInstance() share between threads
+   */
+  PLUGIN_LOADER_PUBLIC
+  std::size_t getObjectPoolCapacity();
+
   /**
    * @brief  Generates an instance of loadable classes (i.e. plugin_loader).
    *
@@ -209,6 +444,39 @@ public:
   PLUGIN_LOADER_PUBLIC
   int unloadLibrary();
 
+  /**
+   * @brief Gets the number of managed plugins (i.e. smart pointers) created by this class loader that have not been destroyed yet
+   */
+  PLUGIN_LOADER_PUBLIC
+  int getPluginInstanceCount();
+
+  /**
+   * @brief Enables or disables tracking of the managed plugins created by this class loader, which
+   * getLiveInstances() then reports along with their creation time and thread. It is disabled by
+   * default; when enabled, creating and destroying a plugin cost an allocation and a lock that
+   * threads rarely contend for.
+   */
+  PLUGIN_LOADER_PUBLIC
+  void setInstanceTrackingEnabled(bool enabled) {instance_tracker_.setEnabled(enabled);}
+
+  /**
+   * @brief Indicates if the managed plugins created by this class loader are tracked
+   */
+  PLUGIN_LOADER_PUBLIC
+  bool isInstanceTrackingEnabled() const {return instance_tracker_.isEnabled();}
+
+  /**
+   * @brief Gets the tracked plugins that have not been destroyed yet, oldest first. Plugins created while tracking was disabled are not reported, @see setInstanceTrackingEnabled()
+   */
+  PLUGIN_LOADER_PUBLIC
+  std::vector<InstanceInfo> getLiveInstances() const {return instance_tracker_.getInstances();}
+
+  /**
+  * @brief Getter for if an unmanaged (i.e. unsafe) instance has been created flag
+  */
+  PLUGIN_LOADER_PUBLIC
+  static bool hasUnmanagedInstanceBeenCreated();
+
 private:
   /**
    * @brief Callback method when a plugin created by this class loader is destroyed
@@ -223,24 +491,196 @@ private:
     if (nullptr == obj) {
       return;
     }
-    std::unique_lock<std::recursive_mutex> lock(plugin_ref_count_mutex_);
+    impl::LibraryReaper & reaper = impl::LibraryReaper::instance();
+    if (reaper.isDeferredDestructionEnabled()) {
+      reaper.defer(this, obj, &PluginLoader::deletePlugin<Base>);
+      return;
+    }
+    impl::TraceScope trace(TraceEventType::Destroy, library_path_);
+    std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
     delete (obj);
-    plugin_ref_count_ = plugin_ref_count_ - 1;
-    assert(plugin_ref_count_ >= 0);
-    if (0 == plugin_ref_count_ && isOnDemandLoadUnloadEnabled()) {
-      if (!PluginLoader::hasUnmanagedInstanceBeenCreated()) {
-        unloadLibraryInternal(false);
-      } else {
-        logWarn(
-          "plugin_loader::PluginLoader: "
-          "Cannot unload library %s even though last shared pointer went out of scope. "
-          "This is because createUnmanagedInstance was used within the scope of this process,"
-          " perhaps by a different PluginLoader. Library will NOT be closed.",
-          getLibraryPath().c_str());
+    impl::incrementCounter(library_metrics_, impl::LibraryCounter::Destruction);
+    onPluginReleased(lock);
+  }
+
+  /**
+   * @brief Deletes a plugin whose destruction was deferred, @see setDeferredDestructionEnabled()
+   */
+  template<class Base>
+  static void deletePlugin(void * obj)
+  {
+    delete static_cast<Base *>(obj);
+  }
+
+  /**
+   * @brief Callback method when a plugin created by createPooledInstance() is destroyed
+   * @param pool - The pool of its class
+   * @param obj - A pointer to the released object
+   */
+  template<class Base>
+  void onPooledPluginDeletion(impl::ObjectPool<Base> * pool, Base * obj)
+  {
+    if (nullptr == obj) {
+      return;
+    }
+    if (!pool->release(obj)) {
+      onPluginDeletion(obj);
+      return;
+    }
+    std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+    onPluginReleased(lock);
+  }
+
+  /**
+   * @brief Callback method when a plugin created by createInstanceIn() is destroyed
+   * @param factory - The factory that constructed it
+   * @param obj - A pointer to the destroyed object, its storage is left to the caller
+   */
+  template<class Base>
+  void onPlacedPluginDeletion(impl::AbstractMetaObject<Base> * factory, Base * obj)
+  {
+    if (nullptr == obj) {
+      return;
+    }
+    impl::TraceScope trace(TraceEventType::Destroy, library_path_);
+    std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+    factory->destroyAt(obj);
+    impl::incrementCounter(library_metrics_, impl::LibraryCounter::Destruction);
+    onPluginReleased(lock);
+  }
+
+#ifdef PLUGIN_LOADER_HAS_MEMORY_RESOURCE
+  /**
+   * @brief Heads the memory allocated from a memory resource for a plugin, which follows it
+   */
+  template<class Base>
+  struct ResourceBlock
+  {
+    impl::AbstractMetaObject<Base> * factory;
+    std::pmr::memory_resource * resource;
+    std::size_t size;
+    std::size_t alignment;
+    impl::InstanceNode * node;  ///< nullptr if the plugin is not tracked
+  };
+
+  /**
+   * @brief Generates an instance of loadable classes in memory allocated from a memory resource
+   * @param block - Set to the memory block of the object, which onResourcePluginDeletion() needs
+   * @return A Base* to newly created plugin object, holding a reference on the library
+   */
+  template<class Base>
+  Base * createRawInstanceFrom(
+    const std::string & derived_class_name, std::pmr::memory_resource * resource,
+    ResourceBlock<Base> * & block)
+  {
+    loadLibraryForCreation();
+    Base * obj = nullptr;
+    try {
+      impl::TraceScope trace(TraceEventType::Create, derived_class_name);
+      impl::CreationMetricsScope metrics(library_metrics_, derived_class_name);
+      impl::AbstractMetaObject<Base> * factory =
+        impl::getFactory<Base>(derived_class_name, this);
+      metrics.setClassMetrics(factory->getClassMetrics());
+      const std::size_t alignment =
+        std::max(factory->objectAlignment(), alignof(ResourceBlock<Base>));
+      const std::size_t offset =
+        (sizeof(ResourceBlock<Base>) + alignment - 1) / alignment * alignment;
+      const std::size_t size = offset + factory->objectSize();
+      void * storage = resource->allocate(size, alignment);
+      block = new (storage) ResourceBlock<Base>{factory, resource, size, alignment, nullptr};
+
+      try {
+        obj = factory->constructAt(static_cast<char *>(storage) + offset);
+      } catch (...) {
+        resource->deallocate(storage, size, alignment);
+        throw;
       }
+      metrics.succeeded();
+    } catch (...) {
+      releaseCreationReference();
+      throw;
     }
+    block->node = instance_tracker_.track(obj, derived_class_name, library_path_);
+    return obj;
   }
 
+  /**
+   * @brief Callback method when a plugin allocated from a memory resource is destroyed
+   * @param block - The memory block of the object
+   * @param obj - A pointer to the deleted object
+   */
+  template<class Base>
+  void onResourcePluginDeletion(ResourceBlock<Base> * block, Base * obj)
+  {
+    if (nullptr == obj) {
+      return;
+    }
+    instance_tracker_.untrack(block->node);
+    impl::TraceScope trace(TraceEventType::Destroy, library_path_);
+    std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+    block->factory->destroyAt(obj);
+    impl::incrementCounter(library_metrics_, impl::LibraryCounter::Destruction);
+    ResourceBlock<Base> released_block = *block;
+    released_block.resource->deallocate(block, released_block.size, released_block.alignment);
+    onPluginReleased(lock);
+  }
+#endif
+
+  /**
+   * @brief Loads the library if needed before a plugin is created, and takes the reference the plugin will hold on it so that it cannot be unloaded meanwhile
+   */
+  PLUGIN_LOADER_PUBLIC
+  void loadLibraryForCreation();
+
+  /**
+   * @brief Drops the reference taken by loadLibraryForCreation() when the plugin could not be created
+   */
+  PLUGIN_LOADER_PUBLIC
+  void releaseCreationReference();
+
+  /**
+   * @brief Drops the reference a plugin held on the library, or has the reaper do it if destruction is deferred
+   * @param lock - Holds plugin_ref_count_mutex_, may be unlocked on return
+   */
+  PLUGIN_LOADER_PUBLIC
+  void onPluginReleased(std::unique_lock<impl::RecursiveMutex> & lock);
+
+  /**
+   * @brief Drops the reference a plugin held on the library, unloading it in on-demand mode if it was the last one
+   * @param lock - Holds plugin_ref_count_mutex_, may be unlocked on return
+   */
+  PLUGIN_LOADER_PUBLIC
+  void releasePluginReference(std::unique_lock<impl::RecursiveMutex> & lock);
+
+  /**
+   * @brief Called by the LibraryReaper to destroy a plugin whose destruction was deferred and drop its reference on the library
+   * @param obj - The plugin, nullptr if it was already destroyed
+   * @param destroy - Destroys obj
+   */
+  PLUGIN_LOADER_PUBLIC
+  void reclaimDeferredPlugin(void * obj, void (* destroy)(void *));
+
+  /**
+   * @brief Gets the pool of a class for createPooledInstance(), creating it if needed
+   */
+  template<class Base>
+  impl::ObjectPool<Base> & getObjectPool(const std::string & derived_class_name)
+  {
+    std::unique_lock<std::mutex> lock(object_pools_mutex_);
+    std::unique_ptr<impl::ObjectPoolBase> & pool =
+      object_pools_[std::make_pair(std::string(typeid(Base).name()), derived_class_name)];
+    if (!pool) {
+      pool.reset(new impl::ObjectPool<Base>(object_pool_capacity_));
+    }
+    return static_cast<impl::ObjectPool<Base> &>(*pool);
+  }
+
+  /**
+   * @brief Destroys the idle instances of all pools, done before the library is unloaded
+   */
+  PLUGIN_LOADER_PUBLIC
+  void drainObjectPools();
+
   /**
    * @brief  Generates an instance of loadable classes (i.e. plugin_loader).
    *
@@ -271,27 +711,32 @@ private:
         "final plugin destruction if on demand (lazy) loading/unloading mode is used."
       );
     }
-    if (!isLibraryLoaded()) {
-      loadLibrary();
+    loadLibraryForCreation();
+
+    Base * obj = nullptr;
+    try {
+      impl::TraceScope trace(TraceEventType::Create, derived_class_name);
+      impl::CreationMetricsScope metrics(library_metrics_, derived_class_name);
+      impl::AbstractMetaObject<Base> * factory =
+        impl::getFactory<Base>(derived_class_name, this);
+      metrics.setClassMetrics(factory->getClassMetrics());
+      obj = plugin_loader::impl::createInstance<Base>(factory, derived_class_name);
+      assert(obj != nullptr);  // Unreachable assertion if createInstance() throws on failure
+      metrics.succeeded();
+    } catch (...) {
+      releaseCreationReference();
+      throw;
     }
 
-    Base * obj = plugin_loader::impl::createInstance<Base>(derived_class_name, this);
-    assert(obj != nullptr);  // Unreachable assertion if createInstance() throws on failure
-
-    if (managed) {
-      std::unique_lock<std::recursive_mutex> lock(plugin_ref_count_mutex_);
-      ++plugin_ref_count_;
+    if (!managed) {
+      // Unmanaged plugins hold no reference, they keep the library from ever being unloaded
+      std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+      --plugin_ref_count_;
     }
 
     return obj;
   }
 
-  /**
-  * @brief Getter for if an unmanaged (i.e. unsafe) instance has been created flag
-  */
-  PLUGIN_LOADER_PUBLIC
-  static bool hasUnmanagedInstanceBeenCreated();
-
   /**
    * @brief As the library may be unloaded in "on-demand load/unload" mode, unload maybe called from createInstance(). The problem is that createInstance() locks the plugin_ref_count as does unloadLibrary(). This method is the implementation of unloadLibrary but with a parameter to decide if plugin_ref_mutex_ should be locked
    * @param lock_plugin_ref_count - Set to true if plugin_ref_count_mutex_ should be locked, else false
@@ -300,14 +745,38 @@ private:
   PLUGIN_LOADER_PUBLIC
   int unloadLibraryInternal(bool lock_plugin_ref_count);
 
+  /**
+   * @brief Called by the LibraryReaper to unload a library retained by the UnloadRetentionPolicy. The library is only unloaded if no plugin was created since it became idle.
+   */
+  PLUGIN_LOADER_PUBLIC
+  void unloadIdleLibrary();
+
+  /**
+   * @brief Warns about the tracked plugins that keep the library from being unloaded
+   */
+  PLUGIN_LOADER_PUBLIC
+  void logLiveInstances();
+
+  friend class impl::LibraryReaper;
+
 private:
   bool ondemand_load_unload_;
+  bool isolated_;
   std::string library_path_;
+  std::string library_key_;
   int load_ref_count_;
-  std::recursive_mutex load_ref_count_mutex_;
+  impl::RecursiveMutex load_ref_count_mutex_;
   int plugin_ref_count_;
-  std::recursive_mutex plugin_ref_count_mutex_;
+  impl::RecursiveMutex plugin_ref_count_mutex_;
+  std::atomic<std::size_t> deferred_plugin_count_;  ///< Plugins queued on the LibraryReaper
   static bool has_unmananged_instance_been_created_;
+  // Pools of createPooledInstance(), keyed by typeid name of the base class and class name
+  std::map<std::pair<impl::BaseClassName, impl::ClassName>,
+    std::unique_ptr<impl::ObjectPoolBase>> object_pools_;
+  std::size_t object_pool_capacity_;
+  std::mutex object_pools_mutex_;
+  impl::InstanceTracker instance_tracker_;
+  impl::MetricsEntry * library_metrics_;  ///< The counters of library_path_, @see getMetrics()
 };
 
 }  // namespace plugin_loader
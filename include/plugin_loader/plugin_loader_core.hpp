@@ -32,20 +32,27 @@
 #ifndef PLUGIN_LOADER_plugin_loader_CORE_HPP_
 #define PLUGIN_LOADER_plugin_loader_CORE_HPP_
 
+#include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <cstddef>
 #include <cstdio>
 #include <map>
 #include <string>
 #include <typeinfo>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "plugin_loader/console.h"
 #include "plugin_loader/shared_library.hpp"
 
+#include "plugin_loader/duplicate_class_policy.hpp"
+#include "plugin_loader/event_trace.hpp"
 #include "plugin_loader/exceptions.hpp"
+#include "plugin_loader/lock_profiler.hpp"
 #include "plugin_loader/meta_object.hpp"
+#include "plugin_loader/metrics.hpp"
 #include "plugin_loader/visibility_control.hpp"
 
 /**
@@ -64,13 +71,18 @@ namespace impl
 typedef std::string LibraryPath;
 typedef std::string ClassName;
 typedef std::string BaseClassName;
-typedef std::map<ClassName, impl::AbstractMetaObjectBase *> FactoryMap;
+typedef std::unordered_map<ClassName, impl::AbstractMetaObjectBase *> FactoryMap;
 typedef std::map<BaseClassName, FactoryMap> BaseToFactoryMapMap;
 typedef std::pair<LibraryPath, SharedLibrary *> LibraryPair;
 typedef std::vector<LibraryPair> LibraryVector;
 typedef std::vector<AbstractMetaObjectBase *> MetaObjectVector;
+typedef std::unordered_map<ClassName, MetaObjectVector> CandidateFactoryMap;
+typedef std::map<BaseClassName, CandidateFactoryMap> BaseToCandidateFactoryMapMap;
 
 // Debug
+/**
+ * @brief Prints the open libraries and the factories to stdout, @see getRegistrySnapshot() for a machine-readable equivalent
+ */
 PLUGIN_LOADER_PUBLIC
 void printDebugInfoToScreen();
 
@@ -83,6 +95,20 @@ void printDebugInfoToScreen();
 PLUGIN_LOADER_PUBLIC
 BaseToFactoryMapMap & getGlobalPluginBaseToFactoryMapMap();
 
+/**
+ * @brief Gets a handle to a global data structure that holds, for every base class, all the factories registered for each class name in registration order, including the ones shadowed by another library (@see DuplicateClassPolicy). The global Base-to-FactoryMap map only holds the factory that wins.
+ * @return A reference to the global base to candidate factory map
+ */
+PLUGIN_LOADER_PUBLIC
+BaseToCandidateFactoryMapMap & getGlobalPluginBaseToCandidateFactoryMapMap();
+
+/**
+ * @brief Gets a handle to a global data structure that holds, for every base class, the factories indexed by their qualified class name (@see qualifiedClassName())
+ * @return A reference to the global base to qualified factory map
+ */
+PLUGIN_LOADER_PUBLIC
+BaseToFactoryMapMap & getGlobalPluginBaseToQualifiedFactoryMapMap();
+
 /**
  * @brief Gets a handle to a list of open libraries in the form of LibraryPairs which encode the library path+name and the handle to the underlying Poco::SharedLibrary
  * @return A reference to the global vector that tracks loaded libraries
@@ -138,15 +164,98 @@ FactoryMap & getFactoryMapForBaseClass()
   return getFactoryMapForBaseClass(typeid(Base).name());
 }
 
+/**
+ * @brief Gets all the factories registered for each class name of a base class, in registration order
+ * @return A reference to the CandidateFactoryMap contained within the global Base-to-CandidateFactoryMap map.
+ */
+PLUGIN_LOADER_PUBLIC
+CandidateFactoryMap & getCandidateFactoryMapForBaseClass(const std::string & typeid_base_class_name);
+
+/**
+ * @brief Adds a factory to the registry. If other libraries registered the same class name, the DuplicateClassPolicy decides which one the class name resolves to. The caller must hold getPluginBaseToFactoryMapMapMutex().
+ * @param meta_obj - The factory, its class, base class and library must be set
+ */
+PLUGIN_LOADER_PUBLIC
+void insertMetaObject(AbstractMetaObjectBase * meta_obj);
+
+/**
+ * @brief Removes a factory from the registry without destroying it. A factory of another library shadowed by it takes over its class name. The caller must hold getPluginBaseToFactoryMapMapMutex().
+ * @param meta_obj - The factory
+ */
+PLUGIN_LOADER_PUBLIC
+void removeMetaObject(AbstractMetaObjectBase * meta_obj);
+
+/**
+ * @brief Finds the factory a PluginLoader creates a class with. The class name resolves to the winning factory unless the loader's own library also provides the class, qualified class names resolve to the factory of their library.
+ * @param typeid_base_class_name - The result of typeid(Base).name()
+ * @param class_name - The literal or qualified name of the class
+ * @param loader - The PluginLoader whose scope we are within
+ * @return The factory, nullptr if the class is not registered
+ */
+PLUGIN_LOADER_PUBLIC
+AbstractMetaObjectBase * findMetaObject(
+  const std::string & typeid_base_class_name, const std::string & class_name,
+  const PluginLoader * loader);
+
+/**
+ * @brief Applies the DuplicateClassPolicy to two libraries providing the same class
+ * @param later_library_path - The library that registered the class last
+ * @param earlier_library_path - The library that registered the class first
+ * @return true if the class of later_library_path wins
+ */
+PLUGIN_LOADER_PUBLIC
+bool isLaterLibraryPreferred(
+  const std::string & later_library_path, const std::string & earlier_library_path);
+
 /**
  * @brief To provide thread safety, all exposed plugin functions can only be run serially by multiple threads. This is implemented by using critical sections enforced by a single mutex which is locked and released with the following two functions
  * @return A reference to the global mutex
  */
 PLUGIN_LOADER_PUBLIC
-std::recursive_mutex & getLoadedLibraryVectorMutex();
+RecursiveMutex & getLoadedLibraryVectorMutex();
+
+PLUGIN_LOADER_PUBLIC
+RecursiveMutex & getPluginBaseToFactoryMapMapMutex();
 
+/**
+ * @brief Locks getPluginBaseToFactoryMapMapMutex(), recording how long it had to wait in the registry lock wait histogram, @see getMetrics()
+ * @return The lock
+ */
 PLUGIN_LOADER_PUBLIC
-std::recursive_mutex & getPluginBaseToFactoryMapMapMutex();
+std::unique_lock<RecursiveMutex> lockPluginBaseToFactoryMapMapMutex();
+
+/**
+ * @brief Gets the generation of the global factory map map, which changes whenever a factory is registered, removed or bound to another PluginLoader. It allows callers to cache what they derive from the factories.
+ * @return The current generation
+ */
+PLUGIN_LOADER_PUBLIC
+std::size_t getRegistryGeneration();
+
+/**
+ * @brief Records a change of the global factory map map, the caller must hold getPluginBaseToFactoryMapMapMutex()
+ */
+PLUGIN_LOADER_PUBLIC
+void bumpRegistryGeneration();
+
+/**
+ * @brief Looks a factory up in the factory cache of the calling thread, which only touches thread local memory and the registry generation
+ * @param typeid_base_class_name - typeid(Base).name() of the base class
+ * @param class_name - The literal or qualified name of the class
+ * @param loader - The PluginLoader whose scope we are within
+ * @return The factory cached by cacheFactory(), nullptr if there is none or the registry changed since
+ */
+PLUGIN_LOADER_PUBLIC
+void * findCachedFactory(
+  const char * typeid_base_class_name, const std::string & class_name, const PluginLoader * loader);
+
+/**
+ * @brief Caches a factory in the factory cache of the calling thread, replacing the entry it maps to
+ * @param generation - getRegistryGeneration() when the factory was looked up in the registry
+ */
+PLUGIN_LOADER_PUBLIC
+void cacheFactory(
+  const char * typeid_base_class_name, const std::string & class_name, const PluginLoader * loader,
+  void * factory, std::size_t generation);
 
 /**
  * @brief Indicates if a library containing more than just plugins has been opened by the running process
@@ -169,14 +278,17 @@ void hasANonPurePluginLibraryBeenOpened(bool hasIt);
  * Classes that use that macro will cause this function to be invoked when the library is loaded. The function will create a MetaObject (i.e. factory) for the corresponding Derived class and insert it into the appropriate FactoryMap in the global Base-to-FactoryMap map. Note that the passed class_name is the literal class name and not the mangled version.
  * @param Derived - parameteric type indicating concrete type of plugin
  * @param Base - parameteric type indicating base type of plugin
+ * @param Factory - parameteric type of the factory, a MetaObject<Derived, Base> or a subclass of it
  * @param class_name - the literal name of the class being registered (NOT MANGLED)
  */
-template<typename Derived, typename Base>
+template<typename Derived, typename Base, typename Factory = impl::MetaObject<Derived, Base>>
 void registerPlugin(const std::string & class_name, const std::string & base_class_name)
 {
   // Note: This function will be automatically invoked when a dlopen() call
   // opens a library. Normally it will happen within the scope of loadLibrary(),
   // but that may not be guaranteed.
+  TraceScope trace(TraceEventType::Register, class_name);
+  const std::int64_t start_ns = getMetricsClock();
   logDebug(
     "plugin_loader.impl: "
     "Registering plugin factory for class = %s, PluginLoader* = %p and library name %s.",
@@ -204,28 +316,17 @@ void registerPlugin(const std::string & class_name, const std::string & base_cla
   }
 
   // Create factory
-  impl::AbstractMetaObject<Base> * new_factory =
-    new impl::MetaObject<Derived, Base>(class_name, base_class_name);
+  impl::AbstractMetaObject<Base> * new_factory = new Factory(class_name, base_class_name);
   new_factory->addOwningPluginLoader(getCurrentlyActivePluginLoader());
   new_factory->setAssociatedLibraryPath(getCurrentlyLoadingLibraryName());
 
 
   // Add it to global factory map map
-  getPluginBaseToFactoryMapMapMutex().lock();
-  FactoryMap & factoryMap = getFactoryMapForBaseClass<Base>();
-  if (factoryMap.find(class_name) != factoryMap.end()) {
-    logWarn(
-      "plugin_loader.impl: SEVERE WARNING!!! "
-      "A namespace collision has occured with plugin factory for class %s. "
-      "New factory will OVERWRITE existing one. "
-      "This situation occurs when libraries containing plugins are directly linked against an "
-      "executable (the one running right now generating this message). "
-      "Please separate plugins out into their own library or just don't link against the library "
-      "and use either plugin_loader::PluginLoader/MultiLibraryPluginLoader to open.",
-      class_name.c_str());
+  {
+    std::unique_lock<RecursiveMutex> lock(lockPluginBaseToFactoryMapMapMutex());
+    insertMetaObject(new_factory);
   }
-  factoryMap[class_name] = new_factory;
-  getPluginBaseToFactoryMapMapMutex().unlock();
+  recordRegistration(getMetricsClock() - start_ns);
 
   logDebug(
     "plugin_loader.impl: "
@@ -234,33 +335,43 @@ void registerPlugin(const std::string & class_name, const std::string & base_cla
 }
 
 /**
- * @brief This function creates an instance of a plugin class given the derived name of the class and returns a pointer of the Base class type.
+ * @brief This function finds the factory of a plugin class given the derived name of the class.
  * @param derived_class_name - The name of the derived class (unmangled)
  * @param loader - The PluginLoader whose scope we are within
- * @return A pointer to newly created plugin, note caller is responsible for object destruction
+ * @return The factory, stays valid as long as the library is loaded
+ * @throws CreateClassException if there is no such class within the scope of loader
  */
 template<typename Base>
-Base * createInstance(const std::string & derived_class_name, PluginLoader * loader)
+AbstractMetaObject<Base> * getFactory(const std::string & derived_class_name, PluginLoader * loader)
 {
-  AbstractMetaObject<Base> * factory = nullptr;
+  const char * typeid_base_class_name = typeid(Base).name();
+  AbstractMetaObject<Base> * factory = static_cast<AbstractMetaObject<Base> *>(
+    findCachedFactory(typeid_base_class_name, derived_class_name, loader));
+  if (nullptr != factory) {
+    return factory;
+  }
 
-  getPluginBaseToFactoryMapMapMutex().lock();
-  FactoryMap & factoryMap = getFactoryMapForBaseClass<Base>();
-  if (factoryMap.find(derived_class_name) != factoryMap.end()) {
-    factory = dynamic_cast<impl::AbstractMetaObject<Base> *>(factoryMap[derived_class_name]);
+  std::unique_lock<RecursiveMutex> lock(lockPluginBaseToFactoryMapMapMutex());
+  // The registry only changes under its mutex, so this is the generation of the lookup
+  const std::size_t generation = getRegistryGeneration();
+  AbstractMetaObjectBase * meta_obj =
+    findMetaObject(typeid_base_class_name, derived_class_name, loader);
+  if (nullptr != meta_obj) {
+    IsolatedMetaObject * isolated = dynamic_cast<IsolatedMetaObject *>(meta_obj);
+    if (nullptr != isolated) {
+      // It was registered under typeid(Base).name(), the namespace only hides that from RTTI
+      factory = static_cast<impl::AbstractMetaObject<Base> *>(isolated->getFactory());
+    } else {
+      factory = dynamic_cast<impl::AbstractMetaObject<Base> *>(meta_obj);
+    }
   } else {
     logError(
       "plugin_loader.impl: No metaobject exists for class type %s.", derived_class_name.c_str());
   }
-  getPluginBaseToFactoryMapMapMutex().unlock();
-
-  Base * obj = nullptr;
-  if (factory != nullptr && factory->isOwnedBy(loader)) {
-    obj = factory->create();
-  }
+  lock.unlock();
 
-  if (nullptr == obj) {  // Was never created
-    if (factory && factory->isOwnedBy(nullptr)) {
+  if (factory == nullptr || !meta_obj->isOwnedBy(loader)) {
+    if (factory && meta_obj->isOwnedBy(nullptr)) {
       logDebug("%s",
         "plugin_loader.impl: ALERT!!! "
         "A metaobject (i.e. factory) exists for desired class, but has no owner. "
@@ -271,13 +382,29 @@ Base * createInstance(const std::string & derived_class_name, PluginLoader * loa
         "prior to main(). "
         "You should isolate your plugins into their own library, otherwise it will not be "
         "possible to shutdown the library!");
-
-      obj = factory->create();
     } else {
       throw plugin_loader::CreateClassException(
               "Could not create instance of type " + derived_class_name);
     }
   }
+  cacheFactory(typeid_base_class_name, derived_class_name, loader, factory, generation);
+  return factory;
+}
+
+/**
+ * @brief This function creates an instance of a plugin class with the factory of the class and returns a pointer of the Base class type.
+ * @param factory - The factory of the class, @see getFactory()
+ * @param derived_class_name - The name of the derived class (unmangled)
+ * @return A pointer to newly created plugin, note caller is responsible for object destruction
+ */
+template<typename Base>
+Base * createInstance(AbstractMetaObject<Base> * factory, const std::string & derived_class_name)
+{
+  Base * obj = factory->create();
+  if (nullptr == obj) {
+    throw plugin_loader::CreateClassException(
+            "Could not create instance of type " + derived_class_name);
+  }
 
   logDebug(
     "plugin_loader.impl: Created instance of type %s and object pointer = %p",
@@ -286,6 +413,19 @@ Base * createInstance(const std::string & derived_class_name, PluginLoader * loa
   return obj;
 }
 
+/**
+ * @brief This function creates an instance of a plugin class given the derived name of the class and returns a pointer of the Base class type.
+ * @param derived_class_name - The name of the derived class (unmangled)
+ * @param loader - The PluginLoader whose scope we are within
+ * @return A pointer to newly created plugin, note caller is responsible for object destruction
+ */
+template<typename Base>
+Base * createInstance(const std::string & derived_class_name, PluginLoader * loader)
+{
+  TraceScope trace(TraceEventType::Create, derived_class_name);
+  return createInstance<Base>(getFactory<Base>(derived_class_name, loader), derived_class_name);
+}
+
 /**
  * @brief This function returns all the available plugin_loader in the plugin system that are derived from Base and within scope of the passed PluginLoader.
  * @param loader - The pointer to the PluginLoader whose scope we are within,
@@ -294,20 +434,27 @@ Base * createInstance(const std::string & derived_class_name, PluginLoader * loa
 template<typename Base>
 std::vector<std::string> getAvailableClasses(PluginLoader * loader)
 {
-  std::unique_lock<std::recursive_mutex> lock(getPluginBaseToFactoryMapMapMutex());
+  std::unique_lock<RecursiveMutex> lock(lockPluginBaseToFactoryMapMapMutex());
 
-  FactoryMap & factory_map = getFactoryMapForBaseClass<Base>();
+  CandidateFactoryMap & candidate_map = getCandidateFactoryMapForBaseClass(typeid(Base).name());
   std::vector<std::string> classes;
   std::vector<std::string> classes_with_no_owner;
 
-  for (auto & it : factory_map) {
-    AbstractMetaObjectBase * factory = it.second;
-    if (factory->isOwnedBy(loader)) {
+  for (auto & it : candidate_map) {
+    bool is_owned = false;
+    bool has_no_owner = false;
+    for (auto & factory : it.second) {
+      is_owned = is_owned || factory->isOwnedBy(loader);
+      has_no_owner = has_no_owner || factory->isOwnedBy(nullptr);
+    }
+    if (is_owned) {
       classes.push_back(it.first);
-    } else if (factory->isOwnedBy(nullptr)) {
+    } else if (has_no_owner) {
       classes_with_no_owner.push_back(it.first);
     }
   }
+  std::sort(classes.begin(), classes.end());
+  std::sort(classes_with_no_owner.begin(), classes_with_no_owner.end());
 
   // Added classes not associated with a class loader (Which can happen through
   // an unexpected dlopen() to the library)
@@ -323,6 +470,15 @@ std::vector<std::string> getAvailableClasses(PluginLoader * loader)
 PLUGIN_LOADER_PUBLIC
 std::vector<std::string> getAllLibrariesUsedByPluginLoader(const PluginLoader * loader);
 
+/**
+ * @brief This function returns the classes registered by a library, regardless of the PluginLoader that owns them.
+ * @param library_path - The path+name of the library
+ * @return A vector of pairs where the first element is the typeid name of the base class and the second one the name of the derived class
+ */
+PLUGIN_LOADER_PUBLIC
+std::vector<std::pair<BaseClassName, ClassName>>
+getAllClassesForLibrary(const std::string & library_path);
+
 /**
  * @brief Indicates if passed library loaded within scope of a PluginLoader. The library maybe loaded in memory, but to the class loader it may not be.
  * @param library_path - The name of the library we wish to check is open
@@ -356,20 +512,45 @@ void loadLibrary(const std::string & library_path, PluginLoader * loader);
 PLUGIN_LOADER_PUBLIC
 void unloadLibrary(const std::string & library_path, PluginLoader * loader);
 
+/**
+ * @brief Walks every factory registered with this copy of plugin_loader. It has C linkage so that it
+ * can be found with dlsym() in a copy loaded into another link-map namespace (@see PluginLoader)
+ * @param callback - Invoked for each factory, along with context
+ * @param context - Passed to callback as is
+ */
+extern "C" PLUGIN_LOADER_PUBLIC
+void plugin_loader_for_each_meta_object(
+  void (* callback)(AbstractMetaObjectBase * meta_obj, void * context), void * context);
+
 PLUGIN_LOADER_PUBLIC inline
-std::recursive_mutex & getLoadedLibraryVectorMutex()
+RecursiveMutex & getLoadedLibraryVectorMutex()
 {
-  static std::recursive_mutex m;
+  static RecursiveMutex m("getLoadedLibraryVectorMutex");
   return m;
 }
 
 PLUGIN_LOADER_PUBLIC inline
-std::recursive_mutex & getPluginBaseToFactoryMapMapMutex()
+RecursiveMutex & getPluginBaseToFactoryMapMapMutex()
 {
-  static std::recursive_mutex m;
+  static RecursiveMutex m("getPluginBaseToFactoryMapMapMutex");
   return m;
 }
 
+PLUGIN_LOADER_PUBLIC inline
+std::unique_lock<RecursiveMutex> lockPluginBaseToFactoryMapMapMutex()
+{
+  std::unique_lock<RecursiveMutex> lock(
+    getPluginBaseToFactoryMapMapMutex(), std::try_to_lock);
+  if (lock.owns_lock()) {
+    recordLatency(LatencyMetric::RegistryLockWait, 0);
+  } else {
+    const std::int64_t start_ns = getMetricsClock();
+    lock.lock();
+    recordLatency(LatencyMetric::RegistryLockWait, getMetricsClock() - start_ns);
+  }
+  return lock;
+}
+
 PLUGIN_LOADER_PUBLIC inline
 BaseToFactoryMapMap & getGlobalPluginBaseToFactoryMapMap()
 {
@@ -377,6 +558,41 @@ BaseToFactoryMapMap & getGlobalPluginBaseToFactoryMapMap()
   return instance;
 }
 
+PLUGIN_LOADER_PUBLIC inline
+BaseToCandidateFactoryMapMap & getGlobalPluginBaseToCandidateFactoryMapMap()
+{
+  static BaseToCandidateFactoryMapMap instance;
+  return instance;
+}
+
+PLUGIN_LOADER_PUBLIC inline
+BaseToFactoryMapMap & getGlobalPluginBaseToQualifiedFactoryMapMap()
+{
+  static BaseToFactoryMapMap instance;
+  return instance;
+}
+
+PLUGIN_LOADER_PUBLIC inline
+DuplicateClassPolicy & getDuplicateClassPolicyReference()
+{
+  static DuplicateClassPolicy policy = DuplicateClassPolicy::LastRegisteredWins;
+  return policy;
+}
+
+PLUGIN_LOADER_PUBLIC inline
+std::unordered_map<LibraryPath, int> & getLibraryPriorityMapReference()
+{
+  static std::unordered_map<LibraryPath, int> priorities;
+  return priorities;
+}
+
+PLUGIN_LOADER_PUBLIC inline
+std::atomic<std::size_t> & getRegistryGenerationReference()
+{
+  static std::atomic<std::size_t> generation(0);
+  return generation;
+}
+
 PLUGIN_LOADER_PUBLIC inline
 MetaObjectVector & getMetaObjectGraveyard()
 {
@@ -35,7 +35,7 @@
 #include "plugin_loader/plugin_loader_core.hpp"
 #include "plugin_loader/console.h"
 
-#define PLUGIN_LOADER_REGISTER_CLASS_INTERNAL(Derived, Base, UniqueID) \
+#define PLUGIN_LOADER_REGISTER_FACTORY_INTERNAL(Derived, Base, Factory, UniqueID) \
   namespace \
   { \
   struct ProxyExec ## UniqueID \
@@ -44,17 +44,33 @@
     typedef  Base _base; \
     ProxyExec ## UniqueID() \
     { \
-      plugin_loader::impl::registerPlugin<_derived, _base>(#Derived, #Base); \
+      plugin_loader::impl::registerPlugin<_derived, _base, Factory<_derived, _base>>( \
+        #Derived, #Base); \
     } \
   }; \
   static ProxyExec ## UniqueID g_register_plugin_ ## UniqueID; \
   }  // namespace
 
+#define PLUGIN_LOADER_REGISTER_CLASS_INTERNAL(Derived, Base, UniqueID) \
+  PLUGIN_LOADER_REGISTER_FACTORY_INTERNAL( \
+    Derived, Base, plugin_loader::impl::MetaObject, UniqueID)
+
 #define PLUGIN_LOADER_REGISTER_CLASS_INTERNAL_HOP1(Derived, Base, UniqueID) \
   PLUGIN_LOADER_REGISTER_CLASS_INTERNAL(Derived, Base, UniqueID)
 
 #define PLUGIN_LOADER_REGISTER_CLASS(Derived, Base) \
   PLUGIN_LOADER_REGISTER_CLASS_INTERNAL_HOP1(Derived, Base, __COUNTER__)
 
+#define PLUGIN_LOADER_REGISTER_PROTOTYPE_CLASS_INTERNAL_HOP1(Derived, Base, UniqueID) \
+  PLUGIN_LOADER_REGISTER_FACTORY_INTERNAL( \
+    Derived, Base, plugin_loader::impl::PrototypeMetaObject, UniqueID)
+
+// Same as PLUGIN_LOADER_REGISTER_CLASS, except that Derived is default constructed only once, into
+// a prototype owned by its factory, and every instance is copy constructed from it. The prototype
+// is destroyed when the last PluginLoader of the library unbinds it, before the library is
+// unloaded, and made again on the next creation. Derived must be copy constructible.
+#define PLUGIN_LOADER_REGISTER_PROTOTYPE_CLASS(Derived, Base) \
+  PLUGIN_LOADER_REGISTER_PROTOTYPE_CLASS_INTERNAL_HOP1(Derived, Base, __COUNTER__)
+
 
 #endif  // PLUGIN_LOADER_REGISTER_MACRO_HPP_
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLUGIN_LOADER_REGISTRY_SNAPSHOT_HPP_
+#define PLUGIN_LOADER_REGISTRY_SNAPSHOT_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "plugin_loader/visibility_control.hpp"
+
+namespace plugin_loader
+{
+
+/**
+ * @brief An open library in a RegistrySnapshot
+ */
+struct LibrarySnapshot
+{
+  std::string library_path;
+  const void * handle;  ///< Its SharedLibrary
+};
+
+/**
+ * @brief A factory (i.e. metaobject) in a RegistrySnapshot
+ */
+struct FactorySnapshot
+{
+  const void * address;
+  std::string type_name;               ///< typeid name of the metaobject, empty in the graveyard
+  std::string class_name;
+  std::string base_class_name;
+  std::string typeid_base_class_name;
+  std::string library_path;
+  std::vector<const void *> owners;    ///< Its PluginLoaders, nullptr if opened outside plugin_loader
+  bool shadowed;                       ///< Another library's factory is used for the class name
+};
+
+/**
+ * @brief A copy of the state of the registry, @see getRegistrySnapshot()
+ */
+struct RegistrySnapshot
+{
+  std::chrono::system_clock::time_point time;  ///< When it was captured
+  std::size_t generation;                      ///< The registry generation it was captured at
+  bool non_pure_library_opened;                ///< Libraries can no longer be unloaded
+  std::vector<LibrarySnapshot> libraries;      ///< In the order they were opened
+  std::vector<FactorySnapshot> factories;      ///< Registered ones, including the shadowed ones
+  std::vector<FactorySnapshot> graveyard;      ///< Kept for libraries that were unloaded
+
+  /**
+   * @brief Serializes the snapshot as a JSON object, addresses being strings of hexadecimal numbers
+   */
+  PLUGIN_LOADER_PUBLIC
+  std::string toJson() const;
+};
+
+/**
+ * @brief Captures the open libraries, the factories and their owners and the graveyard.
+ * The global mutexes are only held while the state is copied, so a running process can be
+ * inspected without blocking its loads and unloads for longer than that; formatting is left to
+ * the caller, e.g. RegistrySnapshot::toJson().
+ */
+PLUGIN_LOADER_PUBLIC
+RegistrySnapshot getRegistrySnapshot();
+
+}  // namespace plugin_loader
+
+#endif  // PLUGIN_LOADER_REGISTRY_SNAPSHOT_HPP_
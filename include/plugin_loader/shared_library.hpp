@@ -60,7 +60,7 @@ public:
         ///
         /// This flag is ignored on platforms that do not use dlopen().
 
-        SHLIB_LOCAL  = 2
+        SHLIB_LOCAL  = 2,
         /// On platforms that use dlopen(), use RTLD_LOCAL instead of RTLD_GLOBAL.
         ///
         /// Note that if this flag is specified, RTTI (including dynamic_cast and throw) will
@@ -68,6 +68,14 @@ public:
         /// compilers as well. See http://gcc.gnu.org/faq.html#dso for more information.
         ///
         /// This flag is ignored on platforms that do not use dlopen().
+
+        SHLIB_ISOLATED = 4
+        /// On platforms that provide dlmopen(), load the library and all its dependencies
+        /// into a new link-map namespace (LM_ID_NEWLM). Nothing is shared with the rest of
+        /// the process: neither symbols nor static state, and every load gets its own copy.
+        /// Implies SHLIB_LOCAL. Note that glibc supports no more than 16 namespaces at a time.
+        ///
+        /// Loading fails with a LibraryLoadException on platforms without dlmopen().
     };
 
     SharedLibrary();
@@ -151,7 +159,8 @@ private:
 //------------------------------------------------
 
 
-inline SharedLibrary::SharedLibrary(const std::string& path, int flags)
+inline SharedLibrary::SharedLibrary(const std::string& path, int flags):
+    _handle(0)
 {
     load(path, flags);
 }
@@ -35,30 +35,98 @@
 /* Author: Ryan Luna, Ioan Sucan */
 
 #include "plugin_loader/console.h"
+#include "plugin_loader/lock_profiler.hpp"
 
+#include <atomic>
 #include <cstdio>
 #include <cstdarg>
+#include <cerrno>
 
+#include <cstdint>
 #include <iostream>
 #include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 namespace plugin_loader{
 
 
+#define CALL_SITE_COUNT 1024
+
+// Once a call site suppressed this many messages in a window, it only reads the clock to find
+// out whether the window is over every this many messages
+#define CALL_SITE_CLOCK_PERIOD 16
+
+/// The rate limiter state of a call site, which log() finds by hashing its file and line
+struct CallSite
+{
+    std::atomic<std::uint64_t> key;           // 0 while the slot is free
+    std::atomic<std::int64_t>  window_start;  // steady_clock ticks
+    std::atomic<std::size_t>   count;         // Messages logged or suppressed since window_start
+    std::atomic<std::size_t>   reported;      // Suppressed messages of the window already reported
+    std::atomic<const char*>   file;          // Set once the slot is claimed, the rest before it
+    std::atomic<int>           line;
+    std::atomic<LogLevel>      level;
+};
+
 struct DefaultOutputHandler
 {
-    DefaultOutputHandler(void)
+    DefaultOutputHandler(void) : lock_("console")
     {
         output_handler_ = static_cast<OutputHandler*>(&std_output_handler_);
         previous_output_handler_ = output_handler_;
+        dispatch_epoch_ = 0;
+        dispatch_counts_[0] = 0;
+        dispatch_counts_[1] = 0;
         logLevel_ = CONSOLE_LOG_WARN;
+        rate_limit_messages_ = 100;
+        rate_limit_interval_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::seconds(10)).count();
+        for (std::size_t i = 0 ; i < CALL_SITE_COUNT ; ++i)
+        {
+            call_sites_[i].key.store(0, std::memory_order_relaxed);
+            call_sites_[i].window_start.store(0, std::memory_order_relaxed);
+            call_sites_[i].count.store(0, std::memory_order_relaxed);
+            call_sites_[i].reported.store(0, std::memory_order_relaxed);
+            call_sites_[i].file.store(NULL, std::memory_order_relaxed);
+            call_sites_[i].line.store(0, std::memory_order_relaxed);
+            call_sites_[i].level.store(CONSOLE_LOG_DEBUG, std::memory_order_relaxed);
+        }
     }
 
+    ~DefaultOutputHandler(void)
+    {
+        // Other output handlers may already be destroyed by now
+        if (output_handler_ == &std_output_handler_)
+            logSuppressedSummaries();
+    }
+
+    /// Outputs the summaries of the call sites that suppressed messages since their last one
+    void logSuppressedSummaries(void);
+
     OutputHandlerSTD std_output_handler_;
-    OutputHandler   *output_handler_;
-    OutputHandler   *previous_output_handler_;
-    LogLevel         logLevel_;
-    std::mutex       lock_; // it is likely the outputhandler does some I/O, so we serialize it
+    std::atomic<OutputHandler*> output_handler_;  // Read without a lock by the logging threads
+    OutputHandler   *previous_output_handler_;    // Guarded by handler_lock_
+    std::atomic<LogLevel> logLevel_;  // Read without a lock so that filtered messages cost nothing
+    std::mutex handler_lock_;  // Serializes the changes of output handler
+    impl::ProfiledMutex<std::mutex> lock_; // it is likely the outputhandler does some I/O, so we serialize the ones that are not thread safe
+
+    // The number of messages being passed to an output handler, by the parity of the epoch they
+    // started in. A change of output handler starts a new epoch and waits for the previous one.
+    std::atomic<unsigned>     dispatch_epoch_;
+    std::atomic<std::size_t>  dispatch_counts_[2];
+
+    std::atomic<std::size_t>  rate_limit_messages_;
+    std::atomic<std::int64_t> rate_limit_interval_;  // steady_clock ticks
+    CallSite                  call_sites_[CALL_SITE_COUNT];
 };
 
 // we use this function because we want to handle static initialization correctly
@@ -73,86 +141,580 @@ static DefaultOutputHandler* getDOH(void)
 
 #define USE_DOH                                                                \
     DefaultOutputHandler *doh = getDOH();                                      \
-    std::lock_guard<std::mutex> lock_guard(doh->lock_)
+    std::lock_guard<std::mutex> lock_guard(doh->handler_lock_)
+
+/// Keeps the output handler from being changed, and so destroyed, while messages are passed to
+/// it. Handlers that are not thread safe are called with lock_ held, the other ones concurrently.
+class DispatchScope
+{
+public:
+    explicit DispatchScope(DefaultOutputHandler *doh)
+        : dispatches_(doh->dispatch_counts_[doh->dispatch_epoch_.load() & 1])
+    {
+        dispatches_.fetch_add(1);
+        handler = doh->output_handler_.load();
+        if (handler && !handler->isThreadSafe())
+            lock_ = std::unique_lock<impl::ProfiledMutex<std::mutex> >(doh->lock_);
+    }
+
+    ~DispatchScope(void)
+    {
+        if (lock_.owns_lock())
+            lock_.unlock();
+        dispatches_.fetch_sub(1);
+    }
+
+    OutputHandler *handler;
+
+private:
+    std::atomic<std::size_t>                        &dispatches_;
+    std::unique_lock<impl::ProfiledMutex<std::mutex> > lock_;
+};
 
-#define MAX_BUFFER_SIZE 1024
+/// Makes the logging functions use another output handler, with handler_lock_ held. Returns once
+/// no message is passed to the previous one anymore.
+static void switchOutputHandler(DefaultOutputHandler *doh, OutputHandler *oh)
+{
+    doh->output_handler_.store(oh);
+    unsigned epoch = doh->dispatch_epoch_.fetch_add(1);
+    while (doh->dispatch_counts_[epoch & 1].load() != 0)
+        std::this_thread::yield();
+}
+
+#define INITIAL_BUFFER_SIZE 1024
 
 /// @endcond
 
+/** \brief Counts a message of a call site against the rate limit. Past
+    the first lookup, a suppressed message costs a single atomic
+    increment, and a clock read every CALL_SITE_CLOCK_PERIOD messages.
+    \param suppressed Set to the number of messages suppressed before this one, to be reported
+    \return false if the message is suppressed */
+static bool allowLogFromCallSite(DefaultOutputHandler *doh, const char *file, int line,
+                                 LogLevel level, std::size_t &suppressed)
+{
+    suppressed = 0;
+    std::size_t max_messages = doh->rate_limit_messages_.load(std::memory_order_relaxed);
+    if (max_messages == 0)
+        return true;
+
+    // The file name of a call site is a string literal, so its address identifies it
+    std::uint64_t key = (reinterpret_cast<std::uintptr_t>(file) * 0x9E3779B97F4A7C15ULL) ^
+                        static_cast<std::uint64_t>(line);
+    if (key == 0)
+        key = 1;
+    CallSite *site = NULL;
+    for (std::size_t probe = 0 ; probe < CALL_SITE_COUNT ; ++probe)
+    {
+        CallSite &candidate = doh->call_sites_[(key + probe) % CALL_SITE_COUNT];
+        std::uint64_t candidate_key = candidate.key.load(std::memory_order_acquire);
+        if (candidate_key == 0)
+        {
+            if (candidate.key.compare_exchange_strong(candidate_key, key, std::memory_order_acq_rel))
+            {
+                candidate.window_start.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                                             std::memory_order_relaxed);
+                candidate.line.store(line, std::memory_order_relaxed);
+                candidate.level.store(level, std::memory_order_relaxed);
+                candidate.file.store(file, std::memory_order_release);
+                site = &candidate;
+                break;
+            }
+            // Claimed meanwhile, candidate_key was updated
+        }
+        if (candidate_key == key)
+        {
+            site = &candidate;
+            break;
+        }
+    }
+    if (site == NULL)
+        return true;  // Too many call sites to limit them all
+
+    std::size_t count = site->count.fetch_add(1, std::memory_order_relaxed);
+    if (count < max_messages)
+        return true;
+    std::size_t suppressed_count = count - max_messages;
+    if (suppressed_count >= CALL_SITE_CLOCK_PERIOD && suppressed_count % CALL_SITE_CLOCK_PERIOD != 0)
+        return false;
+
+    std::int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+    std::int64_t window_start = site->window_start.load(std::memory_order_relaxed);
+    if (now - window_start >= doh->rate_limit_interval_.load(std::memory_order_relaxed) &&
+        site->window_start.compare_exchange_strong(window_start, now, std::memory_order_relaxed))
+    {
+        // This thread starts the new window and reports the messages the previous one suppressed
+        count = site->count.exchange(1, std::memory_order_relaxed);
+        std::size_t reported = site->reported.exchange(0, std::memory_order_relaxed);
+        suppressed = count > max_messages + 1 + reported ? count - max_messages - 1 - reported : 0;
+        return true;
+    }
+    return false;
+}
+
+/// Outputs how many messages a call site suppressed, within a DispatchScope
+static void logSuppressedSummary(OutputHandler *handler, std::size_t suppressed, LogLevel level,
+                                 const char *file, int line)
+{
+    char summary[96];
+    int size = snprintf(summary, sizeof(summary),
+                        "%zu similar message(s) from this call site were suppressed", suppressed);
+    LogRecord record = {summary, static_cast<std::size_t>(size), level, file, line,
+                        std::this_thread::get_id()};
+    handler->log(record);
+}
+
+void DefaultOutputHandler::logSuppressedSummaries(void)
+{
+    DispatchScope scope(this);
+    if (!scope.handler)
+        return;
+    for (std::size_t i = 0 ; i < CALL_SITE_COUNT ; ++i)
+    {
+        CallSite &site = call_sites_[i];
+        const char *file = site.file.load(std::memory_order_acquire);
+        if (file == NULL)
+            continue;
+        std::size_t max_messages = rate_limit_messages_.load(std::memory_order_relaxed);
+        std::size_t count = site.count.load(std::memory_order_relaxed);
+        if (count <= max_messages)
+            continue;
+        std::size_t reported = site.reported.exchange(count - max_messages, std::memory_order_relaxed);
+        if (count - max_messages > reported)
+            logSuppressedSummary(scope.handler, count - max_messages - reported,
+                                 site.level.load(std::memory_order_relaxed), file,
+                                 site.line.load(std::memory_order_relaxed));
+    }
+}
+
+void flushSuppressedLogMessages(void)
+{
+    getDOH()->logSuppressedSummaries();
+}
+
 void noOutputHandler(void)
 {
     USE_DOH;
-    doh->previous_output_handler_ = doh->output_handler_;
-    doh->output_handler_ = NULL;
+    doh->previous_output_handler_ = doh->output_handler_.load();
+    switchOutputHandler(doh, NULL);
 }
 
 void restorePreviousOutputHandler(void)
 {
     USE_DOH;
-    std::swap(doh->previous_output_handler_, doh->output_handler_);
+    OutputHandler *previous = doh->previous_output_handler_;
+    doh->previous_output_handler_ = doh->output_handler_.load();
+    switchOutputHandler(doh, previous);
 }
 
 void useOutputHandler(OutputHandler *oh)
 {
     USE_DOH;
-    doh->previous_output_handler_ = doh->output_handler_;
-    doh->output_handler_ = oh;
+    doh->previous_output_handler_ = doh->output_handler_.load();
+    switchOutputHandler(doh, oh);
 }
 
 OutputHandler* getOutputHandler(void)
 {
-    return getDOH()->output_handler_;
+    return getDOH()->output_handler_.load();
+}
+
+void setLogRateLimit(std::size_t max_messages, std::chrono::milliseconds interval)
+{
+    DefaultOutputHandler *doh = getDOH();
+    doh->rate_limit_interval_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        interval).count();
+    doh->rate_limit_messages_ = max_messages;
 }
 
 void log(const char *file, int line, LogLevel level, const char* m, ...)
 {
-    USE_DOH;
-    if (doh->output_handler_ && level >= doh->logLevel_)
+    DefaultOutputHandler *doh = getDOH();
+    if (level < doh->logLevel_.load(std::memory_order_relaxed))
+        return;
+    std::size_t suppressed = 0;
+    if (level > CONSOLE_LOG_DEBUG && level < CONSOLE_LOG_ERROR &&
+        !allowLogFromCallSite(doh, file, line, level, suppressed))
+        return;
+
+    // Kept by the thread and grown to fit the longest message, so that formatting neither
+    // allocates nor truncates once it is large enough, nor needs lock_
+    static thread_local std::vector<char> buf(INITIAL_BUFFER_SIZE);
+    va_list __ap;
+    va_list __ap_retry;
+    va_start(__ap, m);
+    va_copy(__ap_retry, __ap);
+    int size = vsnprintf(buf.data(), buf.size(), m, __ap);
+    va_end(__ap);
+    if (size >= 0 && static_cast<std::size_t>(size) >= buf.size())
     {
-        va_list __ap;
-        va_start(__ap, m);
-        char buf[MAX_BUFFER_SIZE];
-#ifdef _MSC_VER
-        vsnprintf_s(buf, sizeof(buf), _TRUNCATE, m, __ap);
-#else
-        vsnprintf(buf, sizeof(buf), m, __ap);
-#endif
-        va_end(__ap);
-        buf[MAX_BUFFER_SIZE - 1] = '\0';
+        buf.resize(static_cast<std::size_t>(size) + 1);
+        vsnprintf(buf.data(), buf.size(), m, __ap_retry);
+    }
+    va_end(__ap_retry);
+    if (size < 0)  // Invalid format
+    {
+        size = 0;
+        buf[0] = '\0';
+    }
+    LogRecord record = {buf.data(), static_cast<std::size_t>(size), level, file, line,
+                        std::this_thread::get_id()};
 
-        doh->output_handler_->log(buf, level, file, line);
+    DispatchScope scope(doh);
+    if (scope.handler)
+    {
+        if (suppressed > 0)
+            logSuppressedSummary(scope.handler, suppressed, level, file, line);
+        scope.handler->log(record);
     }
 }
 
 void setLogLevel(LogLevel level)
 {
-    USE_DOH;
-    doh->logLevel_ = level;
+    getDOH()->logLevel_ = level;
 }
 
 LogLevel getLogLevel(void)
 {
-    USE_DOH;
-    return doh->logLevel_;
+    return getDOH()->logLevel_;
 }
 
 static const char* LogLevelString[4] = {"Debug:   ", "Info:    ", "Warning: ", "Error:   "};
 
-void OutputHandlerSTD::log(const std::string &text, LogLevel level, const char *filename, int line)
+/// The handler whose default OutputHandler::log() is calling the other one, which then knows
+/// that the handler overrides neither
+static thread_local const OutputHandler *in_default_log = NULL;
+
+/// Sets in_default_log for the duration of a default OutputHandler::log()
+struct DefaultLogScope
+{
+    DefaultLogScope(const OutputHandler *handler) : previous(in_default_log)
+    {
+        in_default_log = handler;
+    }
+
+    ~DefaultLogScope(void)
+    {
+        in_default_log = previous;
+    }
+
+    const OutputHandler *previous;
+};
+
+void OutputHandler::log(const std::string &text, LogLevel level, const char *filename, int line)
+{
+    LogRecord record = {text.c_str(), text.size(), level, filename, line, std::this_thread::get_id()};
+    if (in_default_log == this)
+    {
+        writeToConsole(record);
+        return;
+    }
+    DefaultLogScope scope(this);
+    log(record);
+}
+
+void OutputHandler::log(const LogRecord &record)
+{
+    if (in_default_log == this)
+    {
+        writeToConsole(record);
+        return;
+    }
+    DefaultLogScope scope(this);
+    log(std::string(record.text, record.size), record.level, record.filename, record.line);
+}
+
+void OutputHandler::writeToConsole(const LogRecord &record)
 {
-    if (level >= CONSOLE_LOG_WARN)
+    if (record.level >= CONSOLE_LOG_WARN)
     {
-        std::cerr << LogLevelString[level] << text << std::endl;
-        std::cerr << "         at line " << line << " in " << filename << std::endl;
+        std::cerr << LogLevelString[record.level];
+        std::cerr.write(record.text, record.size) << std::endl;
+        std::cerr << "         at line " << record.line << " in " << record.filename << std::endl;
         std::cerr.flush();
     }
     else
     {
-        std::cout << LogLevelString[level] << text << std::endl;
+        std::cout << LogLevelString[record.level];
+        std::cout.write(record.text, record.size) << std::endl;
         std::cout.flush();
     }
 }
 
+void OutputHandlerSTD::log(const LogRecord &record)
+{
+    writeToConsole(record);
+}
+
+OutputHandlerBufferedFile::OutputHandlerBufferedFile(const char *filename, std::size_t buffer_size,
+                                                     std::chrono::milliseconds flush_interval,
+                                                     LogLevel flush_level)
+    : OutputHandler(), buffer_size_(buffer_size), flush_interval_(flush_interval),
+      flush_level_(flush_level), last_write_(std::chrono::steady_clock::now())
+{
+#ifdef _MSC_VER
+    errno_t err = fopen_s(&file_, filename, "a");
+    if (err != 0 || !file_)
+#else
+    file_ = fopen(filename, "a");
+    if (!file_)
+#endif
+        std::cerr << "Unable to open log file: '" << filename << "'" << std::endl;
+    else
+        setvbuf(file_, NULL, _IONBF, 0);  // buffer_ replaces the buffer of stdio
+    buffer_.reserve(buffer_size_);
+}
+
+OutputHandlerBufferedFile::~OutputHandlerBufferedFile(void)
+{
+    flush();
+    if (file_)
+        if (fclose(file_) != 0)
+            std::cerr << "Error closing logfile" << std::endl;
+}
+
+void OutputHandlerBufferedFile::log(const LogRecord &record)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_)
+        return;
+
+    suffix_.assign("\n");
+    if (record.level >= CONSOLE_LOG_WARN)
+    {
+        char line[16];
+        snprintf(line, sizeof(line), "%d", record.line);
+        suffix_.append("         at line ").append(line).append(" in ").append(record.filename).append("\n");
+    }
+    buffer_ += LogLevelString[record.level];
+    if (buffer_.size() + record.size + suffix_.size() > buffer_size_)
+    {
+        // Write the message from where it is rather than growing the buffer
+        write(record.text, record.size, suffix_.data(), suffix_.size());
+        return;
+    }
+    buffer_.append(record.text, record.size);
+    buffer_ += suffix_;
+    if (record.level >= flush_level_ || buffer_.size() >= buffer_size_ ||
+        std::chrono::steady_clock::now() - last_write_ >= flush_interval_)
+        write(NULL, 0, NULL, 0);
+}
+
+void OutputHandlerBufferedFile::flush(bool sync)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_)
+        return;
+    write(NULL, 0, NULL, 0);
+    if (sync)
+    {
+#ifdef _MSC_VER
+        _commit(_fileno(file_));
+#else
+        fsync(fileno(file_));
+#endif
+    }
+}
+
+void OutputHandlerBufferedFile::write(const char *text, std::size_t text_size,
+                                      const char *suffix, std::size_t suffix_size)
+{
+    last_write_ = std::chrono::steady_clock::now();
+#ifdef _MSC_VER
+    fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    fwrite(text, 1, text_size, file_);
+    fwrite(suffix, 1, suffix_size, file_);
+#else
+    struct iovec parts[3] = {
+        {const_cast<char *>(buffer_.data()), buffer_.size()},
+        {const_cast<char *>(text), text_size},
+        {const_cast<char *>(suffix), suffix_size}};
+    struct iovec *part = parts;
+    int part_count = 3;
+    while (part_count > 0)
+    {
+        if (part->iov_len == 0)
+        {
+            ++part;
+            --part_count;
+            continue;
+        }
+        ssize_t written = writev(fileno(file_), part, part_count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;  // Nowhere to report it, the messages are lost
+        }
+        // Skip what was written, which may end in the middle of a part
+        std::size_t remaining = static_cast<std::size_t>(written);
+        while (part_count > 0 && remaining >= part->iov_len)
+        {
+            remaining -= part->iov_len;
+            ++part;
+            --part_count;
+        }
+        if (part_count > 0)
+        {
+            part->iov_base = static_cast<char *>(part->iov_base) + remaining;
+            part->iov_len -= remaining;
+        }
+    }
+#endif
+    buffer_.clear();
+}
+
+/** \brief A slot of the queue of OutputHandlerAsync. The strings keep
+    their capacity, so that queuing a message does not allocate once
+    the slot has been used a few times. */
+struct OutputHandlerAsync::Record
+{
+    std::atomic<std::size_t> sequence;
+    LogLevel                 level;
+    int                      line;
+    std::string              text;
+    std::string              filename;  // Copied, the file name may belong to a library that gets unloaded
+    std::thread::id          thread;
+};
+
+OutputHandlerAsync::OutputHandlerAsync(OutputHandler *sink, std::size_t queue_depth,
+                                       AsyncOverflowPolicy overflow_policy)
+    : OutputHandler(), sink_(sink), overflow_policy_(overflow_policy),
+      enqueue_position_(0), dequeue_position_(0), dropped_count_(0), unreported_drops_(0),
+      waiting_(false), stop_(false), forwarded_count_(0)
+{
+    std::size_t capacity = 2;
+    while (capacity < queue_depth)
+        capacity *= 2;
+    mask_ = capacity - 1;
+    records_.reset(new Record[capacity]);
+    for (std::size_t i = 0 ; i < capacity ; ++i)
+        records_[i].sequence.store(i, std::memory_order_relaxed);
+    thread_ = std::thread(&OutputHandlerAsync::run, this);
+}
+
+OutputHandlerAsync::~OutputHandlerAsync(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+}
+
+// Bounded multi-producer queue: a slot whose sequence equals the position is free, and one
+// whose sequence equals the position + 1 holds a message
+bool OutputHandlerAsync::tryPush(const LogRecord &message)
+{
+    std::size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    Record *record;
+    while (true)
+    {
+        record = &records_[position & mask_];
+        std::size_t sequence = record->sequence.load(std::memory_order_acquire);
+        if (sequence == position)
+        {
+            if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (sequence < position)
+            return false;  // Full
+        else
+            position = enqueue_position_.load(std::memory_order_relaxed);
+    }
+    record->level = message.level;
+    record->line = message.line;
+    record->text.assign(message.text, message.size);
+    record->filename.assign(message.filename ? message.filename : "");
+    record->thread = message.thread;
+    record->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+bool OutputHandlerAsync::isEmpty(void) const
+{
+    std::size_t position = dequeue_position_.load(std::memory_order_relaxed);
+    return records_[position & mask_].sequence.load(std::memory_order_acquire) != position + 1;
+}
+
+void OutputHandlerAsync::log(const LogRecord &record)
+{
+    while (!tryPush(record))
+    {
+        if (overflow_policy_ == CONSOLE_ASYNC_DROP)
+        {
+            dropped_count_++;
+            unreported_drops_++;
+            return;
+        }
+        std::this_thread::yield();
+    }
+    // Orders the release store of the record before the load of waiting_, pairs with run()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_.load())
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        condition_.notify_one();
+    }
+}
+
+void OutputHandlerAsync::flush(void)
+{
+    std::size_t count = enqueue_position_.load();
+    std::unique_lock<std::mutex> lock(mutex_);
+    forwarded_condition_.wait(lock, [this, count] { return forwarded_count_ >= count || stop_; });
+}
+
+void OutputHandlerAsync::run(void)
+{
+    // Only this thread dequeues, so dequeue_position_ needs no compare and swap
+    while (true)
+    {
+        std::size_t forwarded = 0;
+        std::size_t position = dequeue_position_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Record &record = records_[position & mask_];
+            if (record.sequence.load(std::memory_order_acquire) != position + 1)
+                break;
+            if (sink_)
+            {
+                LogRecord message = {record.text.c_str(), record.text.size(), record.level,
+                                     record.filename.c_str(), record.line, record.thread};
+                sink_->log(message);
+            }
+            record.sequence.store(position + mask_ + 1, std::memory_order_release);
+            dequeue_position_.store(++position, std::memory_order_relaxed);
+            ++forwarded;
+        }
+
+        std::size_t drops = unreported_drops_.exchange(0);
+        if (drops > 0 && sink_)
+            sink_->log(std::to_string(drops) + " log message(s) dropped, the queue of OutputHandlerAsync was full",
+                       CONSOLE_LOG_WARN, __FILE__, __LINE__);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (forwarded > 0)
+        {
+            forwarded_count_ += forwarded;
+            forwarded_condition_.notify_all();
+            continue;  // Look for more before waiting
+        }
+        if (stop_)
+            break;
+        // Producers check waiting_ after queuing, so either the check below sees their
+        // message or they notify once this thread waits. Without the fences on both sides the
+        // store of waiting_ could be reordered after the load of isEmpty() and the wakeup lost.
+        waiting_.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (isEmpty())
+            condition_.wait(lock);
+        waiting_.store(false);
+    }
+    forwarded_condition_.notify_all();
+}
+
 OutputHandlerFile::OutputHandlerFile(const char *filename) : OutputHandler()
 {
 #ifdef _MSC_VER
@@ -172,13 +734,15 @@ OutputHandlerFile::~OutputHandlerFile(void)
             std::cerr << "Error closing logfile" << std::endl;
 }
 
-void OutputHandlerFile::log(const std::string &text, LogLevel level, const char *filename, int line)
+void OutputHandlerFile::log(const LogRecord &record)
 {
     if (file_)
     {
-        fprintf(file_, "%s%s\n", LogLevelString[level], text.c_str());
-        if(level >= CONSOLE_LOG_WARN)
-            fprintf(file_, "         at line %d in %s\n", line, filename);
+        fputs(LogLevelString[record.level], file_);
+        fwrite(record.text, 1, record.size, file_);
+        fputc('\n', file_);
+        if(record.level >= CONSOLE_LOG_WARN)
+            fprintf(file_, "         at line %d in %s\n", record.line, record.filename);
         fflush(file_);
     }
 }
@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "plugin_loader/event_trace.hpp"
+#include "plugin_loader/exceptions.hpp"
+#include "plugin_loader/internal.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace plugin_loader
+{
+
+namespace
+{
+
+// A slot of the ring, written by one thread at a time and read like a seqlock: its sequence is
+// odd while it is being written and 2 * (index + 1) once event number index is in it
+struct TraceSlot
+{
+  std::atomic<std::uint64_t> sequence;
+  std::atomic<std::int64_t> timestamp_ns;
+  std::atomic<std::int64_t> duration_ns;
+  std::atomic<std::uint64_t> packed;  // name_id << 32 | thread_id << 8 | type
+};
+
+struct TraceRing
+{
+  explicit TraceRing(std::size_t capacity)
+  : mask(capacity - 1), slots(new TraceSlot[capacity]), next(0)
+  {
+    for (std::size_t i = 0; i < capacity; ++i) {
+      slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  const std::size_t mask;
+  std::unique_ptr<TraceSlot[]> slots;
+  std::atomic<std::uint64_t> next;  // Number of events recorded so far
+};
+
+std::atomic<bool> g_trace_enabled(false);
+// Intentionally leaked once allocated: events may be recorded by static destructors
+std::atomic<TraceRing *> g_trace_ring(nullptr);
+
+struct TraceNames
+{
+  std::mutex mutex;
+  std::unordered_map<std::string, std::uint32_t> ids;
+  std::vector<std::string> names;
+};
+
+TraceNames & getTraceNames()
+{
+  static TraceNames * names = new TraceNames();  // Leaked for the same reason as the ring
+  return *names;
+}
+
+std::uint32_t internTraceName(const std::string & name)
+{
+  // Names are few and never forgotten, so each thread can cache their ids without locking
+  static thread_local std::unordered_map<std::string, std::uint32_t> cached_ids;
+  auto cached = cached_ids.find(name);
+  if (cached != cached_ids.end()) {
+    return cached->second;
+  }
+  TraceNames & names = getTraceNames();
+  std::uint32_t id;
+  {
+    std::lock_guard<std::mutex> lock(names.mutex);
+    auto itr = names.ids.find(name);
+    if (itr == names.ids.end()) {
+      itr = names.ids.emplace(name, static_cast<std::uint32_t>(names.names.size())).first;
+      names.names.push_back(name);
+    }
+    id = itr->second;
+  }
+  cached_ids.emplace(name, id);
+  return id;
+}
+
+// On-disk layout: a TraceFileHeader followed by the event records and a table of NUL
+// terminated names referenced by offset
+const char kTraceMagic[8] = {'P', 'L', 'T', 'R', 'A', 'C', 'E', '\0'};
+const std::uint32_t kTraceVersion = 1;
+
+struct TraceFileHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t num_events;
+  std::uint32_t string_table_size;
+  std::uint32_t reserved;
+};
+
+struct TraceFileRecord
+{
+  std::int64_t timestamp_ns;
+  std::int64_t duration_ns;
+  std::uint32_t name_offset;
+  std::uint32_t thread_id;
+  std::uint32_t type;
+  std::uint32_t reserved;
+};
+
+}  // namespace
+
+const char * toString(TraceEventType type)
+{
+  switch (type) {
+    case TraceEventType::LibraryLoad: return "LibraryLoad";
+    case TraceEventType::Dlopen: return "Dlopen";
+    case TraceEventType::Register: return "Register";
+    case TraceEventType::Revive: return "Revive";
+    case TraceEventType::Purge: return "Purge";
+    case TraceEventType::Create: return "Create";
+    case TraceEventType::Destroy: return "Destroy";
+    case TraceEventType::Unload: return "Unload";
+  }
+  return "Unknown";
+}
+
+void enableEventTrace(std::size_t capacity)
+{
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (nullptr == g_trace_ring.load()) {
+    std::size_t rounded_capacity = 2;
+    while (rounded_capacity < capacity) {
+      rounded_capacity *= 2;
+    }
+    g_trace_ring.store(new TraceRing(rounded_capacity));
+  }
+  g_trace_enabled.store(true);
+}
+
+void disableEventTrace()
+{
+  g_trace_enabled.store(false);
+}
+
+bool isEventTraceEnabled()
+{
+  return g_trace_enabled.load(std::memory_order_relaxed);
+}
+
+void clearEventTrace()
+{
+  TraceRing * ring = g_trace_ring.load();
+  if (nullptr == ring) {
+    return;
+  }
+  // Marking the slots as older than any event to come hides them from getEventTrace()
+  for (std::size_t i = 0; i <= ring->mask; ++i) {
+    ring->slots[i].sequence.store(0, std::memory_order_relaxed);
+  }
+}
+
+std::vector<TraceEvent> getEventTrace()
+{
+  std::vector<TraceEvent> events;
+  TraceRing * ring = g_trace_ring.load();
+  if (nullptr == ring) {
+    return events;
+  }
+  const std::uint64_t end = ring->next.load(std::memory_order_acquire);
+  const std::uint64_t capacity = ring->mask + 1;
+  const std::uint64_t begin = end > capacity ? end - capacity : 0;
+  events.reserve(static_cast<std::size_t>(end - begin));
+  for (std::uint64_t index = begin; index < end; ++index) {
+    TraceSlot & slot = ring->slots[index & ring->mask];
+    const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * (index + 1)) {
+      continue;  // Being written, overwritten or cleared
+    }
+    TraceEvent event;
+    event.timestamp_ns = slot.timestamp_ns.load(std::memory_order_relaxed);
+    event.duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+    const std::uint64_t packed = slot.packed.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+    event.name_id = static_cast<std::uint32_t>(packed >> 32);
+    event.thread_id = static_cast<std::uint32_t>(packed >> 8) & 0xFFFFFF;
+    event.type = static_cast<TraceEventType>(packed & 0xFF);
+    events.push_back(event);
+  }
+  return events;
+}
+
+std::string getTraceName(std::uint32_t name_id)
+{
+  TraceNames & names = getTraceNames();
+  std::lock_guard<std::mutex> lock(names.mutex);
+  return name_id < names.names.size() ? names.names[name_id] : std::string();
+}
+
+void dumpEventTrace(const std::string & path)
+{
+  std::vector<TraceEvent> events = getEventTrace();
+  std::vector<std::string> names;
+  {
+    TraceNames & trace_names = getTraceNames();
+    std::lock_guard<std::mutex> lock(trace_names.mutex);
+    names = trace_names.names;
+  }
+
+  std::vector<std::uint32_t> name_offsets;
+  std::vector<char> string_table;
+  for (auto & name : names) {
+    name_offsets.push_back(static_cast<std::uint32_t>(string_table.size()));
+    string_table.insert(string_table.end(), name.begin(), name.end());
+    string_table.push_back('\0');
+  }
+  std::vector<TraceFileRecord> records;
+  records.reserve(events.size());
+  for (auto & event : events) {
+    TraceFileRecord record;
+    record.timestamp_ns = event.timestamp_ns;
+    record.duration_ns = event.duration_ns;
+    record.name_offset = event.name_id < name_offsets.size() ? name_offsets[event.name_id] : 0;
+    record.thread_id = event.thread_id;
+    record.type = static_cast<std::uint32_t>(event.type);
+    record.reserved = 0;
+    records.push_back(record);
+  }
+
+  TraceFileHeader header;
+  memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+  header.version = kTraceVersion;
+  header.num_events = static_cast<std::uint32_t>(records.size());
+  header.string_table_size = static_cast<std::uint32_t>(string_table.size());
+  header.reserved = 0;
+
+  FILE * file = fopen(path.c_str(), "wb");
+  if (nullptr == file) {
+    throw plugin_loader::PluginLoaderException("Could not open event trace " + path);
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  if (ok && !records.empty()) {
+    ok = fwrite(records.data(), sizeof(TraceFileRecord), records.size(), file) == records.size();
+  }
+  if (ok && !string_table.empty()) {
+    ok = fwrite(string_table.data(), 1, string_table.size(), file) == string_table.size();
+  }
+  ok = (fclose(file) == 0) && ok;
+  if (!ok) {
+    throw plugin_loader::PluginLoaderException("Could not write event trace " + path);
+  }
+}
+
+void convertEventTraceToChromeJson(const std::string & trace_path, const std::string & json_path)
+{
+  FILE * file = fopen(trace_path.c_str(), "rb");
+  if (nullptr == file) {
+    throw plugin_loader::PluginLoaderException("Could not open event trace " + trace_path);
+  }
+  TraceFileHeader header;
+  std::vector<TraceFileRecord> records;
+  std::vector<char> string_table;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+    0 == memcmp(header.magic, kTraceMagic, sizeof(header.magic)) &&
+    kTraceVersion == header.version;
+  if (ok) {
+    records.resize(header.num_events);
+    string_table.resize(header.string_table_size);
+    ok = fread(records.data(), sizeof(TraceFileRecord), records.size(), file) == records.size() &&
+      fread(string_table.data(), 1, string_table.size(), file) == string_table.size() &&
+      (string_table.empty() || '\0' == string_table.back());
+  }
+  fclose(file);
+  if (!ok) {
+    throw plugin_loader::PluginLoaderException(trace_path + " is not a valid event trace");
+  }
+
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (auto & record : records) {
+    std::string name = toString(static_cast<TraceEventType>(record.type));
+    if (record.name_offset < string_table.size()) {
+      name += std::string(" ") + &string_table[record.name_offset];
+    }
+    char fields[160];
+    snprintf(
+      fields, sizeof(fields),
+      ",\"cat\":\"plugin_loader\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+      record.timestamp_ns / 1000.0, record.duration_ns / 1000.0, record.thread_id);
+    json += first ? "\n{\"name\":" : ",\n{\"name\":";
+    impl::appendJsonString(json, name);
+    json += fields;
+    first = false;
+  }
+  json += "\n]}\n";
+
+  file = fopen(json_path.c_str(), "w");
+  if (nullptr == file) {
+    throw plugin_loader::PluginLoaderException("Could not open " + json_path);
+  }
+  ok = fwrite(json.data(), 1, json.size(), file) == json.size();
+  ok = (fclose(file) == 0) && ok;
+  if (!ok) {
+    throw plugin_loader::PluginLoaderException("Could not write " + json_path);
+  }
+}
+
+namespace impl
+{
+
+std::int64_t getTraceClock()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void recordTraceEvent(
+  TraceEventType type, const std::string & name, std::int64_t timestamp_ns,
+  std::int64_t duration_ns)
+{
+  TraceRing * ring = g_trace_ring.load(std::memory_order_acquire);
+  if (!isEventTraceEnabled() || nullptr == ring) {
+    return;
+  }
+  const std::uint64_t thread_id = static_cast<std::uint64_t>(getThreadIndex()) & 0xFFFFFF;
+  const std::uint64_t packed = static_cast<std::uint64_t>(internTraceName(name)) << 32 |
+    thread_id << 8 | static_cast<std::uint64_t>(type);
+  const std::uint64_t index = ring->next.fetch_add(1, std::memory_order_relaxed);
+  TraceSlot & slot = ring->slots[index & ring->mask];
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.timestamp_ns.store(timestamp_ns, std::memory_order_relaxed);
+  slot.duration_ns.store(duration_ns, std::memory_order_relaxed);
+  slot.packed.store(packed, std::memory_order_relaxed);
+  slot.sequence.store(2 * (index + 1), std::memory_order_release);
+}
+
+}  // namespace impl
+}  // namespace plugin_loader
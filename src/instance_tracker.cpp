@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "plugin_loader/instance_tracker.hpp"
+#include "plugin_loader/internal.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace plugin_loader
+{
+namespace impl
+{
+
+InstanceTracker::InstanceTracker()
+: enabled_(false)
+{
+}
+
+InstanceTracker::~InstanceTracker()
+{
+  for (auto & shard : shards_) {
+    while (nullptr != shard.head) {
+      InstanceNode * next = shard.head->next;
+      delete shard.head;
+      shard.head = next;
+    }
+  }
+}
+
+InstanceNode * InstanceTracker::track(
+  const void * object, const std::string & class_name, const std::string & library_path)
+{
+  if (!isEnabled()) {
+    return nullptr;
+  }
+  InstanceNode * node = new InstanceNode{
+    InstanceInfo{class_name, library_path, object, std::chrono::system_clock::now(),
+      std::this_thread::get_id()},
+    nullptr, nullptr, getThreadIndex() % kShardCount};
+
+  Shard & shard = shards_[node->shard];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  node->next = shard.head;
+  if (nullptr != shard.head) {
+    shard.head->prev = node;
+  }
+  shard.head = node;
+  return node;
+}
+
+void InstanceTracker::untrack(InstanceNode * node)
+{
+  if (nullptr == node) {
+    return;
+  }
+  {
+    Shard & shard = shards_[node->shard];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (nullptr != node->prev) {
+      node->prev->next = node->next;
+    } else {
+      shard.head = node->next;
+    }
+    if (nullptr != node->next) {
+      node->next->prev = node->prev;
+    }
+  }
+  delete node;
+}
+
+std::vector<InstanceInfo> InstanceTracker::getInstances() const
+{
+  std::vector<InstanceInfo> instances;
+  for (auto & shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (InstanceNode * node = shard.head; nullptr != node; node = node->next) {
+      instances.push_back(node->info);
+    }
+  }
+  std::stable_sort(
+    instances.begin(), instances.end(), [](const InstanceInfo & a, const InstanceInfo & b) {
+      return a.creation_time < b.creation_time;
+    });
+  return instances;
+}
+
+}  // namespace impl
+}  // namespace plugin_loader
@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "plugin_loader/library_reaper.hpp"
+#include "plugin_loader/plugin_loader.hpp"
+
+#include <sys/stat.h>
+
+#include <string>
+#include <thread>
+
+namespace plugin_loader
+{
+
+void setUnloadRetentionPolicy(const UnloadRetentionPolicy & policy)
+{
+  impl::LibraryReaper::instance().setPolicy(policy);
+}
+
+UnloadRetentionPolicy getUnloadRetentionPolicy()
+{
+  return impl::LibraryReaper::instance().getPolicy();
+}
+
+void setDeferredDestructionEnabled(bool enabled)
+{
+  impl::LibraryReaper::instance().setDeferredDestructionEnabled(enabled);
+}
+
+bool isDeferredDestructionEnabled()
+{
+  return impl::LibraryReaper::instance().isDeferredDestructionEnabled();
+}
+
+void flushDeferredDestruction()
+{
+  impl::LibraryReaper::instance().flush();
+}
+
+namespace impl
+{
+
+namespace
+{
+
+std::size_t getLibraryFileSize(const std::string & library_path)
+{
+  struct stat file_stat;
+  if (stat(library_path.c_str(), &file_stat) != 0) {
+    return 0;
+  }
+  return static_cast<std::size_t>(file_stat.st_size);
+}
+
+}  // namespace
+
+LibraryReaper & LibraryReaper::instance()
+{
+  // Intentionally leaked: PluginLoaders may be destroyed by static destructors
+  static LibraryReaper * reaper = new LibraryReaper();
+  return *reaper;
+}
+
+LibraryReaper::LibraryReaper()
+: retention_enabled_(false),
+  idle_bytes_(0),
+  unloading_loader_(nullptr),
+  deferred_destruction_enabled_(false),
+  deferred_work_(nullptr),
+  deferred_count_(0),
+  done_count_(0),
+  wake_requested_(false),
+  thread_id_(std::thread::id())
+{
+}
+
+void LibraryReaper::setPolicy(const UnloadRetentionPolicy & policy)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  policy_ = policy;
+  retention_enabled_ = policy.min_idle_time > std::chrono::milliseconds::zero();
+  lock.unlock();
+  wake();
+}
+
+UnloadRetentionPolicy LibraryReaper::getPolicy()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  return policy_;
+}
+
+void LibraryReaper::markIdle(PluginLoader * loader)
+{
+  std::size_t bytes = getLibraryFileSize(loader->getLibraryPath());
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  remove(loader);
+  IdleLibrary idle_library;
+  idle_library.loader = loader;
+  idle_library.idle_since = std::chrono::steady_clock::now();
+  idle_library.bytes = bytes;
+  idle_library_index_[loader] = idle_libraries_.insert(idle_libraries_.end(), idle_library);
+  idle_bytes_ += bytes;
+
+  logDebug(
+    "plugin_loader.impl.LibraryReaper: "
+    "Retaining idle library %s (%zu idle libraries, %zu bytes).",
+    loader->getLibraryPath().c_str(), idle_libraries_.size(), idle_bytes_);
+  lock.unlock();
+  wake();
+}
+
+void LibraryReaper::markBusy(PluginLoader * loader)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  waitUntilUnloaded(lock, loader);
+  remove(loader);
+}
+
+void LibraryReaper::forget(PluginLoader * loader)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  waitUntilUnloaded(lock, loader);
+  remove(loader);
+}
+
+void LibraryReaper::waitUntilUnloaded(std::unique_lock<std::mutex> & lock, PluginLoader * loader)
+{
+  if (isReaperThread()) {
+    return;  // Called while unloading, e.g. by a plugin destructor
+  }
+  unloaded_condition_.wait(lock, [this, loader] {return unloading_loader_ != loader;});
+}
+
+void LibraryReaper::setDeferredDestructionEnabled(bool enabled)
+{
+  deferred_destruction_enabled_.store(enabled);
+}
+
+void LibraryReaper::defer(PluginLoader * loader, void * object, void (* destroy)(void *))
+{
+  ++deferred_count_;
+  loader->deferred_plugin_count_.fetch_add(1, std::memory_order_relaxed);
+  DeferredWork * work = new DeferredWork{loader, object, destroy, nullptr};
+  // work may be done and deleted by the reaper as soon as it is pushed, only use previous after
+  DeferredWork * previous = deferred_work_.load(std::memory_order_relaxed);
+  do {
+    work->next = previous;
+  } while (!deferred_work_.compare_exchange_weak(
+    previous, work, std::memory_order_release, std::memory_order_relaxed));
+  if (nullptr != previous) {
+    return;  // Whoever queued the previous work woke up the reaper
+  }
+  wake();
+}
+
+void LibraryReaper::flush()
+{
+  const std::size_t deferred_count = deferred_count_.load();
+  if (0 == deferred_count) {
+    return;
+  }
+  if (isReaperThread()) {
+    // The work being done by the callers up the stack cannot be waited for
+    doDeferredWork();
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_condition_.wait(lock, [this, deferred_count] {return done_count_ >= deferred_count;});
+}
+
+void LibraryReaper::flush(PluginLoader * loader)
+{
+  if (0 == loader->deferred_plugin_count_.load(std::memory_order_acquire)) {
+    return;
+  }
+  if (isReaperThread()) {
+    doDeferredWork();
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_condition_.wait(lock, [loader] {
+      return 0 == loader->deferred_plugin_count_.load(std::memory_order_acquire);
+    });
+}
+
+void LibraryReaper::doDeferredWork()
+{
+  DeferredWork * work = deferred_work_.exchange(nullptr, std::memory_order_acquire);
+  // Reverse the stack to destroy the plugins in the order they were released
+  DeferredWork * queue = nullptr;
+  while (nullptr != work) {
+    DeferredWork * next = work->next;
+    work->next = queue;
+    queue = work;
+    work = next;
+  }
+
+  std::size_t done_count = 0;
+  while (nullptr != queue) {
+    DeferredWork * next = queue->next;
+    queue->loader->reclaimDeferredPlugin(queue->object, queue->destroy);
+    // The loader may be destroyed as soon as its count drops to zero
+    queue->loader->deferred_plugin_count_.fetch_sub(1, std::memory_order_release);
+    delete queue;
+    queue = next;
+    ++done_count;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_count_ += done_count;
+  done_condition_.notify_all();
+}
+
+void LibraryReaper::remove(PluginLoader * loader)
+{
+  auto itr = idle_library_index_.find(loader);
+  if (itr != idle_library_index_.end()) {
+    idle_bytes_ -= itr->second->bytes;
+    idle_libraries_.erase(itr->second);
+    idle_library_index_.erase(itr);
+  }
+}
+
+void LibraryReaper::reapFront(std::unique_lock<std::mutex> & lock)
+{
+  PluginLoader * loader = idle_libraries_.front().loader;
+  remove(loader);
+  logDebug(
+    "plugin_loader.impl.LibraryReaper: Unloading idle library %s.",
+    loader->getLibraryPath().c_str());
+
+  // mutex_ is unlocked while unloading: the plugins released when pools are drained may make the
+  // library of another loader idle, which calls markIdle(). markBusy() and forget() of this loader
+  // wait for unloading_loader_ to be reset instead.
+  unloading_loader_ = loader;
+  lock.unlock();
+  loader->unloadIdleLibrary();
+  lock.lock();
+  unloading_loader_ = nullptr;
+  unloaded_condition_.notify_all();
+}
+
+void LibraryReaper::wake()
+{
+  std::call_once(thread_started_, [this] {thread_ = std::thread(&LibraryReaper::run, this);});
+  std::unique_lock<std::mutex> lock(wake_mutex_);
+  wake_requested_ = true;
+  wake_condition_.notify_all();
+}
+
+bool LibraryReaper::isReaperThread() const
+{
+  return std::this_thread::get_id() == thread_id_.load(std::memory_order_relaxed);
+}
+
+void LibraryReaper::run()
+{
+  thread_id_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+  while (true) {
+    if (nullptr != deferred_work_.load(std::memory_order_relaxed)) {
+      // Plugins may be destroyed and libraries unloaded, which calls markIdle()
+      doDeferredWork();
+      continue;
+    }
+
+    bool wait_for_idle_time = false;
+    std::chrono::steady_clock::duration idle_time_left;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!idle_libraries_.empty() &&
+        ((policy_.max_idle_libraries > 0 && idle_libraries_.size() > policy_.max_idle_libraries) ||
+        (policy_.max_idle_bytes > 0 && idle_bytes_ > policy_.max_idle_bytes)))
+      {
+        reapFront(lock);
+      }
+
+      // Idle libraries are only unloaded when the caps are exceeded if min_idle_time is max()
+      if (!idle_libraries_.empty() && policy_.min_idle_time != std::chrono::milliseconds::max()) {
+        auto idle_time = std::chrono::steady_clock::now() - idle_libraries_.front().idle_since;
+        if (idle_time >= policy_.min_idle_time) {
+          reapFront(lock);
+          continue;
+        }
+        wait_for_idle_time = true;
+        idle_time_left = policy_.min_idle_time - idle_time;
+      }
+    }
+
+    // Deferred work or a library made idle by the unloads above is handled before sleeping
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    auto woken = [this] {
+        return wake_requested_ || nullptr != deferred_work_.load(std::memory_order_relaxed);
+      };
+    if (wait_for_idle_time) {
+      wake_condition_.wait_for(lock, idle_time_left, woken);
+    } else {
+      wake_condition_.wait(lock, woken);
+    }
+    wake_requested_ = false;
+  }
+}
+
+}  // namespace impl
+}  // namespace plugin_loader
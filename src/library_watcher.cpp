@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "plugin_loader/library_watcher.hpp"
+#include "plugin_loader/console.h"
+#include "plugin_loader/exceptions.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace plugin_loader
+{
+namespace impl
+{
+
+namespace
+{
+
+const uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+
+std::string getDirectory(const std::string & library_path)
+{
+  std::string::size_type slash = library_path.rfind('/');
+  if (std::string::npos == slash) {
+    return ".";
+  }
+  return 0 == slash ? "/" : library_path.substr(0, slash);
+}
+
+std::string getFileName(const std::string & library_path)
+{
+  std::string::size_type slash = library_path.rfind('/');
+  return std::string::npos == slash ? library_path : library_path.substr(slash + 1);
+}
+
+std::string getWatchKey(const std::string & directory, const std::string & file_name)
+{
+  return directory + '/' + file_name;
+}
+
+}  // namespace
+
+LibraryWatcher::LibraryWatcher(
+  const ChangeCallback & on_change, const TickCallback & on_tick,
+  std::chrono::milliseconds tick_period)
+: on_change_(on_change),
+  on_tick_(on_tick),
+  tick_period_(tick_period),
+  stop_(false)
+{
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0) {
+    throw LibraryLoadException(
+            "Could not initialize inotify to watch libraries: " + std::string(strerror(errno)));
+  }
+  if (pipe2(wakeup_fd_, O_NONBLOCK | O_CLOEXEC) != 0) {
+    close(inotify_fd_);
+    throw LibraryLoadException(
+            "Could not create the wakeup pipe of the library watcher: " +
+            std::string(strerror(errno)));
+  }
+  thread_ = std::thread(&LibraryWatcher::run, this);
+}
+
+LibraryWatcher::~LibraryWatcher()
+{
+  stop_ = true;
+  char wakeup = 0;
+  if (write(wakeup_fd_[1], &wakeup, 1) < 0) {
+    // The thread also polls the stop flag every tick
+  }
+  thread_.join();
+  close(wakeup_fd_[0]);
+  close(wakeup_fd_[1]);
+  close(inotify_fd_);
+}
+
+void LibraryWatcher::watch(const std::string & library_path)
+{
+  const std::string directory = getDirectory(library_path);
+  std::unique_lock<std::mutex> lock(mutex_);
+  int wd = inotify_add_watch(inotify_fd_, directory.c_str(), kWatchMask);
+  if (wd < 0) {
+    throw LibraryLoadException(
+            "Could not watch directory " + directory + " of library " + library_path + ": " +
+            std::string(strerror(errno)));
+  }
+  watched_directories_[wd] = directory;
+  watched_libraries_[getWatchKey(directory, getFileName(library_path))] = library_path;
+  logDebug(
+    "plugin_loader.impl.LibraryWatcher: Watching library %s.", library_path.c_str());
+}
+
+void LibraryWatcher::unwatch(const std::string & library_path)
+{
+  const std::string directory = getDirectory(library_path);
+  std::unique_lock<std::mutex> lock(mutex_);
+  watched_libraries_.erase(getWatchKey(directory, getFileName(library_path)));
+  pending_changes_.erase(library_path);
+
+  // Stop watching the directory once none of its libraries is watched anymore
+  for (auto & other : watched_libraries_) {
+    if (getDirectory(other.second) == directory) {
+      return;
+    }
+  }
+  for (auto itr = watched_directories_.begin(); itr != watched_directories_.end(); ++itr) {
+    if (itr->second == directory) {
+      inotify_rm_watch(inotify_fd_, itr->first);
+      watched_directories_.erase(itr);
+      break;
+    }
+  }
+}
+
+void LibraryWatcher::readEvents()
+{
+  alignas(struct inotify_event) char buffer[4096];
+  TimePoint now = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+    if (length <= 0) {
+      return;
+    }
+    for (char * ptr = buffer; ptr < buffer + length; ) {
+      const struct inotify_event * event = reinterpret_cast<const struct inotify_event *>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Events were lost, consider that every library may have changed
+        for (auto & library : watched_libraries_) {
+          pending_changes_[library.second] = now;
+        }
+        continue;
+      }
+      auto directory = watched_directories_.find(event->wd);
+      if (directory == watched_directories_.end() || 0 == event->len) {
+        continue;
+      }
+      auto library = watched_libraries_.find(getWatchKey(directory->second, event->name));
+      if (library != watched_libraries_.end()) {
+        pending_changes_[library->second] = now;
+      }
+    }
+  }
+}
+
+void LibraryWatcher::run()
+{
+  while (!stop_) {
+    struct pollfd fds[2];
+    fds[0].fd = inotify_fd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakeup_fd_[0];
+    fds[1].events = POLLIN;
+    if (poll(fds, 2, static_cast<int>(tick_period_.count())) > 0 && (fds[0].revents & POLLIN)) {
+      readEvents();
+    }
+    if (stop_) {
+      break;
+    }
+
+    // Report the libraries that have not been modified for a whole tick
+    std::vector<std::string> changed_libraries;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      TimePoint now = std::chrono::steady_clock::now();
+      for (auto itr = pending_changes_.begin(); itr != pending_changes_.end(); ) {
+        if (now - itr->second >= tick_period_) {
+          changed_libraries.push_back(itr->first);
+          itr = pending_changes_.erase(itr);
+        } else {
+          ++itr;
+        }
+      }
+    }
+    for (auto & library_path : changed_libraries) {
+      logDebug(
+        "plugin_loader.impl.LibraryWatcher: Library %s changed.", library_path.c_str());
+      try {
+        on_change_(library_path);
+      } catch (const std::exception & e) {
+        logError(
+          "plugin_loader.impl.LibraryWatcher: Could not handle the change of library %s: %s",
+          library_path.c_str(), e.what());
+      }
+    }
+    if (on_tick_) {
+      on_tick_();
+    }
+  }
+}
+
+}  // namespace impl
+}  // namespace plugin_loader
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "plugin_loader/lock_profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace plugin_loader
+{
+
+namespace impl
+{
+
+struct LockStatsEntry
+{
+  std::atomic<std::uint64_t> acquisitions;
+  std::atomic<std::uint64_t> contended_acquisitions;
+  std::atomic<std::int64_t> wait_ns;
+  std::atomic<std::int64_t> max_wait_ns;
+  std::atomic<std::int64_t> hold_ns;
+  std::atomic<std::int64_t> max_hold_ns;
+};
+
+namespace
+{
+
+struct LockStatsEntryMap
+{
+  std::mutex mutex;
+  std::map<std::string, std::unique_ptr<LockStatsEntry>> entries;
+};
+
+LockStatsEntryMap & getLockStatsEntries()
+{
+  // Leaked as mutexes with static storage may be used after it would have been destroyed
+  static LockStatsEntryMap * entries = new LockStatsEntryMap();
+  return *entries;
+}
+
+void updateMax(std::atomic<std::int64_t> & max, std::int64_t value)
+{
+  std::int64_t current = max.load(std::memory_order_relaxed);
+  while (value > current &&
+    !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+}  // namespace
+
+LockStatsEntry * getLockStatsEntry(const char * name)
+{
+  LockStatsEntryMap & entries = getLockStatsEntries();
+  std::lock_guard<std::mutex> lock(entries.mutex);
+  std::unique_ptr<LockStatsEntry> & entry = entries.entries[name];
+  if (!entry) {
+    entry.reset(new LockStatsEntry());
+  }
+  return entry.get();
+}
+
+void recordLockAcquisition(LockStatsEntry * entry, bool contended, std::int64_t wait_ns)
+{
+  entry->acquisitions.fetch_add(1, std::memory_order_relaxed);
+  if (contended) {
+    entry->contended_acquisitions.fetch_add(1, std::memory_order_relaxed);
+    entry->wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+    updateMax(entry->max_wait_ns, wait_ns);
+  }
+}
+
+void recordLockRelease(LockStatsEntry * entry, std::int64_t hold_ns)
+{
+  entry->hold_ns.fetch_add(hold_ns, std::memory_order_relaxed);
+  updateMax(entry->max_hold_ns, hold_ns);
+}
+
+}  // namespace impl
+
+bool isLockProfilingEnabled()
+{
+#ifdef PLUGIN_LOADER_LOCK_PROFILING
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::vector<LockStats> getLockStats()
+{
+  std::vector<LockStats> stats;
+  {
+    impl::LockStatsEntryMap & entries = impl::getLockStatsEntries();
+    std::lock_guard<std::mutex> lock(entries.mutex);
+    for (auto & it : entries.entries) {
+      const impl::LockStatsEntry & entry = *it.second;
+      stats.push_back(
+        LockStats{it.first,
+          entry.acquisitions.load(std::memory_order_relaxed),
+          entry.contended_acquisitions.load(std::memory_order_relaxed),
+          entry.wait_ns.load(std::memory_order_relaxed),
+          entry.max_wait_ns.load(std::memory_order_relaxed),
+          entry.hold_ns.load(std::memory_order_relaxed),
+          entry.max_hold_ns.load(std::memory_order_relaxed)});
+    }
+  }
+  std::stable_sort(
+    stats.begin(), stats.end(), [](const LockStats & a, const LockStats & b) {
+      return a.wait_ns > b.wait_ns;
+    });
+  return stats;
+}
+
+void resetLockStats()
+{
+  impl::LockStatsEntryMap & entries = impl::getLockStatsEntries();
+  std::lock_guard<std::mutex> lock(entries.mutex);
+  for (auto & it : entries.entries) {
+    it.second->acquisitions.store(0, std::memory_order_relaxed);
+    it.second->contended_acquisitions.store(0, std::memory_order_relaxed);
+    it.second->wait_ns.store(0, std::memory_order_relaxed);
+    it.second->max_wait_ns.store(0, std::memory_order_relaxed);
+    it.second->hold_ns.store(0, std::memory_order_relaxed);
+    it.second->max_hold_ns.store(0, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace plugin_loader
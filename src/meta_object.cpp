@@ -31,6 +31,7 @@
 #include <algorithm>
 
 #include "plugin_loader/meta_object.hpp"
+#include "plugin_loader/metrics.hpp"
 #include "plugin_loader/plugin_loader.hpp"
 
 namespace plugin_loader
@@ -43,7 +44,8 @@ AbstractMetaObjectBase::AbstractMetaObjectBase(
 : associated_library_path_("Unknown"),
   base_class_name_(base_class_name),
   class_name_(class_name),
-  typeid_base_class_name_("UNSET")
+  typeid_base_class_name_("UNSET"),
+  class_metrics_(impl::getClassMetrics(class_name))
 {
   logDebug(
     "plugin_loader.impl.AbstractMetaObjectBase: "
@@ -59,6 +61,13 @@ AbstractMetaObjectBase::~AbstractMetaObjectBase()
     this, baseClassName().c_str(), className().c_str(), getAssociatedLibraryPath().c_str());
 }
 
+void AbstractMetaObjectBase::destroyOrphaned(AbstractMetaObjectBase * meta_obj)
+{
+  // A qualified call is not dispatched through the vtable
+  meta_obj->AbstractMetaObjectBase::~AbstractMetaObjectBase();
+  ::operator delete(meta_obj);
+}
+
 std::string AbstractMetaObjectBase::className() const
 {
   return class_name_;
@@ -118,5 +127,12 @@ PluginLoaderVector AbstractMetaObjectBase::getAssociatedPluginLoaders()
   return associated_plugin_loaders_;
 }
 
+IsolatedMetaObject::IsolatedMetaObject(AbstractMetaObjectBase * factory)
+: AbstractMetaObjectBase(factory->className(), factory->baseClassName()),
+  factory_(factory)
+{
+  typeid_base_class_name_ = factory->typeidBaseClassName();
+}
+
 }  // namespace impl
 }  // namespace plugin_loader
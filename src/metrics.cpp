@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "plugin_loader/metrics.hpp"
+#include "plugin_loader/internal.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace plugin_loader
+{
+
+namespace impl
+{
+
+namespace
+{
+
+const std::size_t kShardCount = 16;
+const std::size_t kMaxCounterCount = 8;
+
+}  // namespace
+
+/**
+ * @brief The counters of a library or class, a shard per thread
+ */
+struct MetricsEntry
+{
+  std::atomic<std::uint64_t> counters[kShardCount][kMaxCounterCount];
+
+  std::uint64_t sum(std::size_t counter) const
+  {
+    std::uint64_t sum = 0;
+    for (auto & shard : counters) {
+      sum += shard[counter].load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+};
+
+namespace
+{
+
+struct HistogramShard
+{
+  std::atomic<std::uint64_t> buckets[LatencyHistogram::kBucketCount];
+  std::atomic<std::int64_t> total_ns;
+  std::atomic<std::int64_t> max_ns;
+};
+
+struct Histogram
+{
+  HistogramShard shards[kShardCount];
+};
+
+const std::size_t kLatencyMetricCount = 4;
+
+Histogram * getHistograms()
+{
+  // Leaked so that plugins destroyed by static destructors can still be recorded
+  static Histogram * histograms = new Histogram[kLatencyMetricCount]();
+  return histograms;
+}
+
+std::size_t getBucket(std::int64_t duration_ns)
+{
+  std::size_t bucket = 0;
+  while (bucket + 1 < LatencyHistogram::kBucketCount &&
+    duration_ns >= LatencyHistogram::getBucketUpperBound(bucket))
+  {
+    ++bucket;
+  }
+  return bucket;
+}
+
+LatencyHistogram sumHistogram(const Histogram & histogram)
+{
+  LatencyHistogram sum = LatencyHistogram();
+  for (auto & shard : histogram.shards) {
+    for (std::size_t i = 0; i < LatencyHistogram::kBucketCount; ++i) {
+      const std::uint64_t count = shard.buckets[i].load(std::memory_order_relaxed);
+      sum.buckets[i] += count;
+      sum.count += count;
+    }
+    sum.total_ns += shard.total_ns.load(std::memory_order_relaxed);
+    sum.max_ns = std::max(sum.max_ns, shard.max_ns.load(std::memory_order_relaxed));
+  }
+  return sum;
+}
+
+/**
+ * @brief The entries of the libraries or classes, by name
+ */
+struct MetricsEntryMap
+{
+  std::mutex mutex;
+  std::map<std::string, std::unique_ptr<MetricsEntry>> entries;
+};
+
+MetricsEntryMap & getLibraryEntries()
+{
+  static MetricsEntryMap * entries = new MetricsEntryMap();
+  return *entries;
+}
+
+MetricsEntryMap & getClassEntries()
+{
+  static MetricsEntryMap * entries = new MetricsEntryMap();
+  return *entries;
+}
+
+struct LibraryLoadTimesMap
+{
+  std::mutex mutex;
+  std::map<std::string, LibraryLoadTimes> load_times;
+};
+
+LibraryLoadTimesMap & getLibraryLoadTimesMap()
+{
+  static LibraryLoadTimesMap * load_times = new LibraryLoadTimesMap();
+  return *load_times;
+}
+
+// The breakdown of the library the calling thread is opening, @see setCurrentLibraryLoadTimes()
+thread_local LibraryLoadTimes * current_library_load_times = nullptr;
+
+MetricsEntry * findOrCreateEntry(
+  MetricsEntryMap & entries, std::unordered_map<std::string, MetricsEntry *> & cache,
+  const std::string & name)
+{
+  auto cached = cache.find(name);
+  if (cached != cache.end()) {
+    return cached->second;
+  }
+  MetricsEntry * entry;
+  {
+    std::lock_guard<std::mutex> lock(entries.mutex);
+    std::unique_ptr<MetricsEntry> & owned_entry = entries.entries[name];
+    if (!owned_entry) {
+      owned_entry.reset(new MetricsEntry());
+    }
+    entry = owned_entry.get();
+  }
+  cache.emplace(name, entry);
+  return entry;
+}
+
+void resetEntries(MetricsEntryMap & entries)
+{
+  std::lock_guard<std::mutex> lock(entries.mutex);
+  for (auto & it : entries.entries) {
+    for (auto & shard : it.second->counters) {
+      for (auto & counter : shard) {
+        counter.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+MetricsEntry * getLibraryMetrics(const std::string & library_path)
+{
+  static thread_local std::unordered_map<std::string, MetricsEntry *> cache;
+  return findOrCreateEntry(getLibraryEntries(), cache, library_path);
+}
+
+MetricsEntry * getClassMetrics(const std::string & class_name)
+{
+  static thread_local std::unordered_map<std::string, MetricsEntry *> cache;
+  return findOrCreateEntry(getClassEntries(), cache, class_name);
+}
+
+void incrementCounter(MetricsEntry * entry, LibraryCounter counter)
+{
+  entry->counters[getThreadIndex() % kShardCount][static_cast<std::size_t>(counter)].fetch_add(
+    1, std::memory_order_relaxed);
+}
+
+void incrementCounter(MetricsEntry * entry, ClassCounter counter)
+{
+  entry->counters[getThreadIndex() % kShardCount][static_cast<std::size_t>(counter)].fetch_add(
+    1, std::memory_order_relaxed);
+}
+
+void recordLatency(LatencyMetric metric, std::int64_t duration_ns)
+{
+  HistogramShard & shard =
+    getHistograms()[static_cast<std::size_t>(metric)].shards[getThreadIndex() % kShardCount];
+  shard.buckets[getBucket(duration_ns)].fetch_add(1, std::memory_order_relaxed);
+  if (duration_ns <= 0) {
+    return;
+  }
+  shard.total_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+  std::int64_t max_ns = shard.max_ns.load(std::memory_order_relaxed);
+  while (duration_ns > max_ns &&
+    !shard.max_ns.compare_exchange_weak(max_ns, duration_ns, std::memory_order_relaxed))
+  {
+  }
+}
+
+void setCurrentLibraryLoadTimes(LibraryLoadTimes * load_times)
+{
+  current_library_load_times = load_times;
+}
+
+void recordRegistration(std::int64_t duration_ns)
+{
+  recordLatency(LatencyMetric::Registration, duration_ns);
+  if (nullptr != current_library_load_times) {
+    current_library_load_times->registration_ns += duration_ns;
+    ++current_library_load_times->factory_count;
+  }
+}
+
+void recordLibraryLoadTimes(const LibraryLoadTimes & load_times)
+{
+  LibraryLoadTimesMap & load_times_map = getLibraryLoadTimesMap();
+  std::lock_guard<std::mutex> lock(load_times_map.mutex);
+  load_times_map.load_times[load_times.library_path] = load_times;
+}
+
+}  // namespace impl
+
+const std::size_t LatencyHistogram::kBucketCount;
+
+std::int64_t LatencyHistogram::getBucketUpperBound(std::size_t bucket)
+{
+  if (bucket + 1 >= kBucketCount) {
+    return std::numeric_limits<std::int64_t>::max();
+  }
+  return static_cast<std::int64_t>(1000) << bucket;
+}
+
+std::int64_t LatencyHistogram::getPercentileUpperBound(double percentile) const
+{
+  if (0 == count) {
+    return 0;
+  }
+  const double rank = std::min(std::max(percentile, 0.0), 100.0) / 100.0 * count;
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i + 1 < kBucketCount; ++i) {
+    seen += buckets[i];
+    if (seen > 0 && seen >= rank) {
+      return std::min(getBucketUpperBound(i), max_ns);
+    }
+  }
+  return max_ns;
+}
+
+Metrics getMetrics()
+{
+  Metrics metrics;
+  {
+    impl::MetricsEntryMap & entries = impl::getLibraryEntries();
+    std::lock_guard<std::mutex> lock(entries.mutex);
+    for (auto & it : entries.entries) {
+      const impl::MetricsEntry & entry = *it.second;
+      using impl::LibraryCounter;
+      metrics.libraries.push_back(
+        LibraryMetrics{it.first,
+          entry.sum(static_cast<std::size_t>(LibraryCounter::Load)),
+          entry.sum(static_cast<std::size_t>(LibraryCounter::LoadFailure)),
+          entry.sum(static_cast<std::size_t>(LibraryCounter::Unload)),
+          entry.sum(static_cast<std::size_t>(LibraryCounter::UnloadFailure)),
+          entry.sum(static_cast<std::size_t>(LibraryCounter::Creation)),
+          entry.sum(static_cast<std::size_t>(LibraryCounter::CreationFailure)),
+          entry.sum(static_cast<std::size_t>(LibraryCounter::Destruction))});
+    }
+  }
+  {
+    impl::MetricsEntryMap & entries = impl::getClassEntries();
+    std::lock_guard<std::mutex> lock(entries.mutex);
+    for (auto & it : entries.entries) {
+      const impl::MetricsEntry & entry = *it.second;
+      using impl::ClassCounter;
+      metrics.classes.push_back(
+        ClassMetrics{it.first,
+          entry.sum(static_cast<std::size_t>(ClassCounter::Creation)),
+          entry.sum(static_cast<std::size_t>(ClassCounter::CreationFailure))});
+    }
+  }
+  impl::Histogram * histograms = impl::getHistograms();
+  using impl::LatencyMetric;
+  metrics.create_instance =
+    impl::sumHistogram(histograms[static_cast<std::size_t>(LatencyMetric::CreateInstance)]);
+  metrics.dlopen = impl::sumHistogram(histograms[static_cast<std::size_t>(LatencyMetric::Dlopen)]);
+  metrics.registration =
+    impl::sumHistogram(histograms[static_cast<std::size_t>(LatencyMetric::Registration)]);
+  metrics.registry_lock_wait =
+    impl::sumHistogram(histograms[static_cast<std::size_t>(LatencyMetric::RegistryLockWait)]);
+  return metrics;
+}
+
+std::vector<LibraryLoadTimes> getLibraryLoadTimes()
+{
+  std::vector<LibraryLoadTimes> load_times;
+  impl::LibraryLoadTimesMap & load_times_map = impl::getLibraryLoadTimesMap();
+  std::lock_guard<std::mutex> lock(load_times_map.mutex);
+  for (auto & it : load_times_map.load_times) {
+    load_times.push_back(it.second);
+  }
+  return load_times;
+}
+
+std::string getSlowestLibrariesReport(std::size_t max_count)
+{
+  std::vector<LibraryLoadTimes> load_times = getLibraryLoadTimes();
+  std::stable_sort(
+    load_times.begin(), load_times.end(),
+    [](const LibraryLoadTimes & a, const LibraryLoadTimes & b) {
+      return a.total_ns > b.total_ns;
+    });
+  if (load_times.size() > max_count) {
+    load_times.resize(max_count);
+  }
+
+  std::string report =
+    "    total(ms)    dlopen(ms)  register(ms)  factories    revive(ms)     purge(ms)  library\n";
+  char line[128];
+  for (auto & library : load_times) {
+    snprintf(
+      line, sizeof(line), "%13.3f %13.3f %13.3f %10zu %13.3f %13.3f  ",
+      library.total_ns / 1e6, library.dlopen_ns / 1e6, library.registration_ns / 1e6,
+      library.factory_count, library.revive_ns / 1e6, library.purge_ns / 1e6);
+    report += line;
+    report += library.library_path;
+    report += '\n';
+  }
+  return report;
+}
+
+void resetMetrics()
+{
+  impl::resetEntries(impl::getLibraryEntries());
+  impl::resetEntries(impl::getClassEntries());
+  impl::Histogram * histograms = impl::getHistograms();
+  for (std::size_t i = 0; i < impl::kLatencyMetricCount; ++i) {
+    for (auto & shard : histograms[i].shards) {
+      for (auto & bucket : shard.buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+      }
+      shard.total_ns.store(0, std::memory_order_relaxed);
+      shard.max_ns.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+}  // namespace plugin_loader
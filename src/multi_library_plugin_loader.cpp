@@ -29,25 +29,116 @@
 
 #include "plugin_loader/multi_library_plugin_loader.hpp"
 
+#include <link.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace plugin_loader
 {
 
+namespace
+{
+
+std::string getRealPath(const char * path)
+{
+  char * real_path = realpath(path, nullptr);
+  if (nullptr == real_path) {
+    return path;
+  }
+  std::string result(real_path);
+  free(real_path);
+  return result;
+}
+
+struct MappedSizeQuery
+{
+  std::string real_path;
+  std::size_t mapped_bytes;
+};
+
+int addMappedSize(struct dl_phdr_info * info, size_t, void * data)
+{
+  MappedSizeQuery * query = static_cast<MappedSizeQuery *>(data);
+  if (nullptr == info->dlpi_name || '\0' == info->dlpi_name[0] ||
+    getRealPath(info->dlpi_name) != query->real_path)
+  {
+    return 0;
+  }
+  for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i) {
+    if (PT_LOAD == info->dlpi_phdr[i].p_type) {
+      query->mapped_bytes += info->dlpi_phdr[i].p_memsz;
+    }
+  }
+  return 1;  // Found, stop iterating
+}
+
+/**
+ * @brief Gets the size of the segments a library has mapped, 0 if it is not loaded
+ */
+std::size_t getMappedLibrarySize(const std::string & library_path)
+{
+  MappedSizeQuery query{getRealPath(library_path.c_str()), 0};
+  dl_iterate_phdr(&addMappedSize, &query);
+  return query.mapped_bytes;
+}
+
+/**
+ * @brief Gets the mapped size of a resident library, measuring it if not done yet
+ */
+template<typename Residency>
+std::size_t measureResidency(const PluginLoader * loader, Residency & residency)
+{
+  std::size_t mapped_bytes = residency.mapped_bytes.load();
+  if (0 == mapped_bytes) {
+    mapped_bytes = getMappedLibrarySize(loader->getLibraryPath());
+    residency.mapped_bytes.store(mapped_bytes);
+  }
+  return mapped_bytes;
+}
+
+}  // namespace
+
 MultiLibraryPluginLoader::MultiLibraryPluginLoader(bool enable_ondemand_loadunload)
-: enable_ondemand_loadunload_(enable_ondemand_loadunload)
+: enable_ondemand_loadunload_(enable_ondemand_loadunload),
+  pending_exclusive_locks_(0),
+  generation_(0),
+  staged_library_count_(0),
+  residency_budget_(0),
+  residency_hits_(0),
+  residency_misses_(0),
+  residency_evictions_(0),
+  instance_tracking_enabled_(false)
 {
 }
 
 MultiLibraryPluginLoader::~MultiLibraryPluginLoader()
 {
+  std::unique_ptr<impl::LibraryWatcher> library_watcher;
+  {
+    std::unique_lock<std::mutex> lock(hot_reload_mutex_);
+    library_watcher.swap(library_watcher_);
+  }
+  library_watcher.reset();  // Joins the watching thread, which uses this loader
+
   shutdownAllPluginLoaders();
+  collectRetiredPluginLoaders(true);
+  if (!staging_directory_.empty()) {
+    rmdir(staging_directory_.c_str());
+  }
 }
 
 std::vector<std::string> MultiLibraryPluginLoader::getRegisteredLibraries()
 {
+  SharedLock lock(*this);
   std::vector<std::string> libraries;
   for (auto & it : active_plugin_loaders_) {
     if (it.second != nullptr) {
@@ -74,40 +165,587 @@ PluginLoaderVector MultiLibraryPluginLoader::getAllAvailablePluginLoaders()
   return loaders;
 }
 
+PluginLoader * MultiLibraryPluginLoader::getPluginLoaderForIndexedClass(
+  const std::string & base_class_name, const std::string & class_name)
+{
+  const LibraryPath * library_path = findIndexedClass(base_class_name, class_name);
+  if (nullptr == library_path) {
+    return nullptr;
+  }
+  return getPluginLoaderForLibrary(*library_path);
+}
+
 bool MultiLibraryPluginLoader::isLibraryAvailable(const std::string & library_name)
 {
+  SharedLock lock(*this);
   return getPluginLoaderForLibrary(library_name) != nullptr;
 }
 
+PluginLoader * MultiLibraryPluginLoader::getPluginLoaderForClass(
+  const std::string & base_class_name, const std::string & class_name)
+{
+  const LibraryPath * indexed_library_path = findIndexedClass(base_class_name, class_name);
+  if (nullptr != indexed_library_path) {
+    LibraryPath library_path = *indexed_library_path;
+    loadLibraryInternal(library_path);
+    return getPluginLoaderForLibrary(library_path);
+  }
+
+  // The class is unknown, index the libraries whose classes have not been discovered yet. The
+  // loaded ones are all indexed first, as it costs no load and lets the DuplicateClassPolicy choose
+  // among them, then the other ones are loaded one at a time until the class is found.
+  PluginLoaderVector unloaded_loaders;
+  for (auto & loader : getAllAvailablePluginLoaders()) {
+    const std::string & library_path = loader->getLibraryPath();
+    bool is_indexed = std::find_if(
+      indexed_libraries_.begin(), indexed_libraries_.end(),
+      [&library_path](const std::pair<LibraryPath, BaseAndClassNameVector> & indexed) {
+        return indexed.first == library_path;
+      }) != indexed_libraries_.end();
+    if (is_indexed) {
+      continue;
+    }
+    if (loader->isLibraryLoaded()) {
+      indexLibrary(library_path, impl::getAllClassesForLibrary(library_path));
+    } else {
+      unloaded_loaders.push_back(loader);
+    }
+  }
+  indexed_library_path = findIndexedClass(base_class_name, class_name);
+  if (nullptr != indexed_library_path) {
+    return getPluginLoaderForLibrary(*indexed_library_path);
+  }
+  for (auto & loader : unloaded_loaders) {
+    const std::string & library_path = loader->getLibraryPath();
+    loader->loadLibrary();
+    indexLibrary(library_path, impl::getAllClassesForLibrary(library_path));
+    indexed_library_path = findIndexedClass(base_class_name, class_name);
+    if (nullptr != indexed_library_path) {
+      return getPluginLoaderForLibrary(*indexed_library_path);
+    }
+    if (isOnDemandLoadUnloadEnabled()) {
+      loader->unloadLibrary();
+    }
+  }
+
+  // Factories of libraries opened by other means than a PluginLoader are visible to all loaders
+  {
+    std::unique_lock<impl::RecursiveMutex> lock(impl::lockPluginBaseToFactoryMapMapMutex());
+    impl::FactoryMap & factory_map = impl::getFactoryMapForBaseClass(base_class_name);
+    impl::FactoryMap::iterator factory = factory_map.find(class_name);
+    if (factory != factory_map.end() && factory->second->isOwnedBy(nullptr) &&
+      !active_plugin_loaders_.empty())
+    {
+      return active_plugin_loaders_.begin()->second;
+    }
+  }
+  return nullptr;
+}
+
+const LibraryPath * MultiLibraryPluginLoader::findIndexedClass(
+  const std::string & base_class_name, const std::string & class_name)
+{
+  if (!duplicate_class_index_.empty()) {
+    auto base_itr = duplicate_class_index_.find(base_class_name);
+    if (base_itr != duplicate_class_index_.end()) {
+      auto class_itr = base_itr->second.find(class_name);
+      if (class_itr != base_itr->second.end()) {
+        return findPreferredLibrary(base_class_name, class_name, class_itr->second);
+      }
+    }
+  }
+  for (auto index : {&class_index_, &qualified_class_index_}) {
+    auto base_itr = index->find(base_class_name);
+    if (base_itr == index->end()) {
+      continue;
+    }
+    auto class_itr = base_itr->second.find(class_name);
+    if (class_itr != base_itr->second.end()) {
+      return &class_itr->second;
+    }
+  }
+  return nullptr;
+}
+
+const LibraryPath * MultiLibraryPluginLoader::findPreferredLibrary(
+  const std::string & base_class_name, const std::string & class_name,
+  const std::vector<LibraryPath> & libraries)
+{
+  // The registry resolves the class among the loaded libraries with the current policy, in the
+  // order the libraries registered it
+  std::unique_lock<impl::RecursiveMutex> lock(impl::lockPluginBaseToFactoryMapMapMutex());
+  impl::FactoryMap & factory_map = impl::getFactoryMapForBaseClass(base_class_name);
+  impl::FactoryMap::iterator factory = factory_map.find(class_name);
+  if (factory != factory_map.end()) {
+    const std::string & library_key = factory->second->getAssociatedLibraryPath();
+    for (auto & library_path : libraries) {
+      PluginLoader * loader = getPluginLoaderForLibrary(library_path);
+      if (nullptr != loader && loader->getLibraryKey() == library_key) {
+        return &library_path;
+      }
+    }
+  }
+
+  // Libraries unloaded on demand are taken in the order they were indexed
+  const LibraryPath * preferred = nullptr;
+  for (auto & library_path : libraries) {
+    if (nullptr == preferred || impl::isLaterLibraryPreferred(library_path, *preferred)) {
+      preferred = &library_path;
+    }
+  }
+  return preferred;
+}
+
+void MultiLibraryPluginLoader::indexLibrary(
+  const std::string & library_path, const BaseAndClassNameVector & classes)
+{
+  forgetLibrary(library_path);
+  ++generation_;
+  indexed_libraries_.emplace_back(library_path, classes);
+  for (auto & base_and_class : classes) {
+    ClassToLibraryMap & class_map = class_index_[base_and_class.first];
+    auto class_itr = class_map.find(base_and_class.second);
+    if (class_itr == class_map.end()) {
+      class_map.emplace(base_and_class.second, library_path);
+    } else {
+      std::vector<LibraryPath> & libraries =
+        duplicate_class_index_[base_and_class.first][base_and_class.second];
+      if (libraries.empty()) {
+        libraries.push_back(class_itr->second);
+      }
+      libraries.push_back(library_path);
+      if (impl::isLaterLibraryPreferred(library_path, class_itr->second)) {
+        class_itr->second = library_path;
+      }
+    }
+    qualified_class_index_[base_and_class.first].emplace(
+      qualifiedClassName(library_path, base_and_class.second), library_path);
+  }
+}
+
+void MultiLibraryPluginLoader::forgetLibrary(const std::string & library_path)
+{
+  auto indexed = std::find_if(
+    indexed_libraries_.begin(), indexed_libraries_.end(),
+    [&library_path](const std::pair<LibraryPath, BaseAndClassNameVector> & indexed_library) {
+      return indexed_library.first == library_path;
+    });
+  if (indexed == indexed_libraries_.end()) {
+    return;
+  }
+  BaseAndClassNameVector classes;
+  classes.swap(indexed->second);
+  indexed_libraries_.erase(indexed);
+  ++generation_;
+
+  for (auto & base_and_class : classes) {
+    qualified_class_index_[base_and_class.first].erase(
+      qualifiedClassName(library_path, base_and_class.second));
+
+    auto duplicates = duplicate_class_index_.find(base_and_class.first);
+    if (duplicates != duplicate_class_index_.end()) {
+      auto libraries = duplicates->second.find(base_and_class.second);
+      if (libraries != duplicates->second.end()) {
+        libraries->second.erase(
+          std::remove(libraries->second.begin(), libraries->second.end(), library_path),
+          libraries->second.end());
+        if (libraries->second.size() < 2) {
+          duplicates->second.erase(libraries);
+        }
+        if (duplicates->second.empty()) {
+          duplicate_class_index_.erase(duplicates);
+        }
+      }
+    }
+
+    ClassToLibraryMap & class_map = class_index_[base_and_class.first];
+    auto class_itr = class_map.find(base_and_class.second);
+    if (class_itr == class_map.end() || class_itr->second != library_path) {
+      continue;
+    }
+    class_map.erase(class_itr);
+
+    // Fall back to the library the DuplicateClassPolicy prefers among the other ones providing
+    // the same class, if any
+    const LibraryPath * fallback = nullptr;
+    for (auto & other : indexed_libraries_) {
+      if (std::find(other.second.begin(), other.second.end(), base_and_class) !=
+        other.second.end() &&
+        (nullptr == fallback || impl::isLaterLibraryPreferred(other.first, *fallback)))
+      {
+        fallback = &other.first;
+      }
+    }
+    if (nullptr != fallback) {
+      class_map.emplace(base_and_class.second, *fallback);
+    }
+  }
+}
+
 void MultiLibraryPluginLoader::loadLibrary(const std::string & library_path)
 {
-  if (!isLibraryAvailable(library_path)) {
-    active_plugin_loaders_[library_path] =
+  ResidencyScope residency(*this);
+  residency.checkBudget();
+  ExclusiveLock lock(*this);
+  loadLibraryInternal(library_path);
+}
+
+void MultiLibraryPluginLoader::loadLibraryInternal(const std::string & library_path)
+{
+  if (nullptr == getPluginLoaderForLibrary(library_path)) {
+    PluginLoader * loader =
       new plugin_loader::PluginLoader(library_path, isOnDemandLoadUnloadEnabled());
+    loader->setInstanceTrackingEnabled(instance_tracking_enabled_.load());
+    active_plugin_loaders_[library_path] = loader;
+    trackResidency(loader);
+    ++generation_;
+    if (!isOnDemandLoadUnloadEnabled()) {
+      indexLibrary(library_path, impl::getAllClassesForLibrary(library_path));
+    }
+  }
+}
+
+void MultiLibraryPluginLoader::loadIndex(const PluginIndex & index)
+{
+  ExclusiveLock lock(*this);
+  for (auto & library : index.getLibraries()) {
+    BaseAndClassNameVector classes;
+    for (auto & entry : library.classes) {
+      classes.emplace_back(entry.base_class_name, entry.class_name);
+    }
+    indexLibrary(library.library_path, classes);
   }
 }
 
 void MultiLibraryPluginLoader::shutdownAllPluginLoaders()
 {
-  std::vector<std::string> available_libraries = getRegisteredLibraries();
+  ExclusiveLock lock(*this);
+  std::vector<std::string> available_libraries;
+  for (auto & it : active_plugin_loaders_) {
+    available_libraries.push_back(it.first);
+  }
 
-  for (auto & library_path : getRegisteredLibraries()) {
-    unloadLibrary(library_path);
+  for (auto & library_path : available_libraries) {
+    unloadLibraryInternal(library_path);
   }
 }
 
 int MultiLibraryPluginLoader::unloadLibrary(const std::string & library_path)
+{
+  ExclusiveLock lock(*this);
+  return unloadLibraryInternal(library_path);
+}
+
+int MultiLibraryPluginLoader::unloadLibraryInternal(const std::string & library_path)
 {
   int remaining_unloads = 0;
   LibraryToPluginLoaderMap::iterator itr = active_plugin_loaders_.find(library_path);
   if (itr != active_plugin_loaders_.end()) {
     PluginLoader * loader = itr->second;
     if (0 == (remaining_unloads = loader->unloadLibrary())) {
+      residency_.erase(loader);
       delete (loader);
       active_plugin_loaders_.erase(itr);
+      ++generation_;
+      forgetLibrary(library_path);
+
+      auto staged = staged_libraries_.find(library_path);
+      if (staged != staged_libraries_.end()) {
+        unlink(staged->second.c_str());
+        staged_libraries_.erase(staged);
+      }
     }
   }
   return remaining_unloads;
 }
 
+void MultiLibraryPluginLoader::reloadLibrary(const std::string & library_path)
+{
+  std::unique_lock<std::mutex> reload_lock(reload_mutex_);
+  logDebug(
+    "plugin_loader::MultiLibraryPluginLoader: Reloading library %s.", library_path.c_str());
+
+  // Load the new version without holding loader_mutex_, plugins keep being created meanwhile
+  std::string staged_path = stageLibrary(library_path);
+  std::unique_ptr<PluginLoader> new_loader;
+  BaseAndClassNameVector classes;
+  auto load_staged_library = [&](bool isolated) {
+      new_loader.reset(new PluginLoader(staged_path, isOnDemandLoadUnloadEnabled(), isolated));
+      new_loader->setInstanceTrackingEnabled(instance_tracking_enabled_.load());
+      if (isOnDemandLoadUnloadEnabled()) {
+        new_loader->loadLibrary();
+      }
+      classes = impl::getAllClassesForLibrary(new_loader->getLibraryKey());
+      if (isOnDemandLoadUnloadEnabled()) {
+        new_loader->unloadLibrary();
+      }
+    };
+  try {
+    try {
+      // In its own namespace the new copy cannot bind to the symbols of the previous one
+      load_staged_library(true);
+    } catch (const LibraryLoadException &) {
+      logDebug(
+        "plugin_loader::MultiLibraryPluginLoader: "
+        "Could not load library %s in isolation, loading it in the default namespace.",
+        library_path.c_str());
+      new_loader.reset();
+      load_staged_library(false);
+    }
+  } catch (const PluginLoaderException &) {
+    new_loader.reset();
+    unlink(staged_path.c_str());
+    throw;
+  }
+
+  RetiredPluginLoader retired;
+  retired.loader = nullptr;
+  {
+    ResidencyScope residency(*this);
+    residency.checkBudget();
+    ExclusiveLock lock(*this);
+    PluginLoader * & loader = active_plugin_loaders_[library_path];
+    retired.loader = loader;
+    residency_.erase(retired.loader);
+    loader = new_loader.release();
+    trackResidency(loader);
+    ++generation_;
+    indexLibrary(library_path, classes);
+
+    std::string & staged = staged_libraries_[library_path];
+    retired.staged_path = staged;
+    staged = staged_path;
+  }
+
+  if (nullptr != retired.loader) {
+    std::unique_lock<std::mutex> lock(hot_reload_mutex_);
+    retired_plugin_loaders_.push_back(retired);
+  }
+  collectRetiredPluginLoaders(false);
+}
+
+void MultiLibraryPluginLoader::enableHotReload(const std::string & library_path)
+{
+  {
+    std::unique_lock<std::mutex> lock(hot_reload_mutex_);
+    if (!library_watcher_) {
+      library_watcher_.reset(
+        new impl::LibraryWatcher(
+          [this](const std::string & changed_library_path) {
+            if (isLibraryAvailable(changed_library_path)) {
+              reloadLibrary(changed_library_path);
+            }
+          },
+          [this]() {
+            collectRetiredPluginLoaders(false);
+          }));
+    }
+    library_watcher_->watch(library_path);
+  }
+
+  bool is_staged;
+  {
+    SharedLock lock(*this);
+    is_staged = staged_libraries_.find(library_path) != staged_libraries_.end();
+  }
+  if (!is_staged) {
+    reloadLibrary(library_path);
+  }
+}
+
+void MultiLibraryPluginLoader::disableHotReload(const std::string & library_path)
+{
+  std::unique_lock<std::mutex> lock(hot_reload_mutex_);
+  if (library_watcher_) {
+    library_watcher_->unwatch(library_path);
+  }
+}
+
+std::string MultiLibraryPluginLoader::stageLibrary(const std::string & library_path)
+{
+  std::string staged_path;
+  {
+    std::unique_lock<std::mutex> lock(hot_reload_mutex_);
+    if (staging_directory_.empty()) {
+      const char * tmp_directory = getenv("TMPDIR");
+      std::string directory_template = std::string(
+        nullptr != tmp_directory && '\0' != tmp_directory[0] ? tmp_directory : "/tmp") +
+        "/plugin_loader.XXXXXX";
+      std::vector<char> directory(directory_template.begin(), directory_template.end());
+      directory.push_back('\0');
+      if (nullptr == mkdtemp(directory.data())) {
+        throw plugin_loader::LibraryLoadException(
+                "Could not create a staging directory to reload library " + library_path);
+      }
+      staging_directory_ = directory.data();
+    }
+    std::string::size_type slash = library_path.rfind('/');
+    staged_path = staging_directory_ + "/" + std::to_string(++staged_library_count_) + "-" +
+      (std::string::npos == slash ? library_path : library_path.substr(slash + 1));
+  }
+
+  std::ifstream source(library_path, std::ios::binary);
+  std::ofstream destination(staged_path, std::ios::binary | std::ios::trunc);
+  if (source && destination) {
+    destination << source.rdbuf();
+    destination.close();
+  }
+  if (!source || !destination) {
+    unlink(staged_path.c_str());
+    throw plugin_loader::LibraryLoadException(
+            "Could not copy library " + library_path + " to " + staged_path);
+  }
+  return staged_path;
+}
+
+void MultiLibraryPluginLoader::setResidencyBudget(std::size_t budget_bytes)
+{
+  residency_budget_.store(budget_bytes);
+  enforceResidencyBudget();
+}
+
+ResidencyStatistics MultiLibraryPluginLoader::getResidencyStatistics()
+{
+  SharedLock lock(*this);
+  ResidencyStatistics statistics;
+  statistics.hits = residency_hits_.load();
+  statistics.misses = residency_misses_.load();
+  statistics.evictions = residency_evictions_.load();
+  statistics.resident_bytes = 0;
+  for (auto & it : residency_) {
+    if (it.second.resident.load()) {
+      statistics.resident_bytes += measureResidency(it.first, it.second);
+    }
+  }
+  return statistics;
+}
+
+void MultiLibraryPluginLoader::setInstanceTrackingEnabled(bool enabled)
+{
+  ExclusiveLock lock(*this);
+  instance_tracking_enabled_.store(enabled);
+  for (auto & it : active_plugin_loaders_) {
+    it.second->setInstanceTrackingEnabled(enabled);
+  }
+}
+
+std::vector<InstanceInfo> MultiLibraryPluginLoader::getLiveInstances(
+  const std::string & library_path)
+{
+  SharedLock lock(*this);
+  PluginLoader * loader = getPluginLoaderForLibrary(library_path);
+  if (nullptr == loader) {
+    throw plugin_loader::NoPluginLoaderExistsException(
+            "There is no PluginLoader in MultiLibraryPluginLoader bound to library " +
+            library_path + " Ensure you called MultiLibraryPluginLoader::loadLibrary()");
+  }
+  return loader->getLiveInstances();
+}
+
+bool MultiLibraryPluginLoader::touchLibrary(const PluginLoader * loader)
+{
+  auto residency = residency_.find(loader);
+  if (residency == residency_.end()) {
+    return true;
+  }
+  residency->second.last_use.store(
+    std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+  if (residency->second.resident.exchange(true)) {
+    ++residency_hits_;
+    return true;
+  }
+  ++residency_misses_;
+  residency->second.mapped_bytes.store(0);  // Measured again once loaded
+  return false;
+}
+
+void MultiLibraryPluginLoader::trackResidency(const PluginLoader * loader)
+{
+  LibraryResidency & residency = residency_[loader];
+  residency.resident.store(!isOnDemandLoadUnloadEnabled());
+  residency.last_use.store(std::chrono::steady_clock::now().time_since_epoch().count());
+  residency.mapped_bytes.store(0);
+}
+
+void MultiLibraryPluginLoader::enforceResidencyBudget()
+{
+  const std::size_t budget = residency_budget_.load();
+  if (0 == budget) {
+    return;
+  }
+
+  ExclusiveLock lock(*this);
+  std::size_t resident_bytes = 0;
+  std::vector<std::pair<std::int64_t, PluginLoader *>> idle_loaders;
+  for (auto & it : active_plugin_loaders_) {
+    PluginLoader * loader = it.second;
+    auto residency = residency_.find(loader);
+    if (residency == residency_.end() || !residency->second.resident.load()) {
+      continue;
+    }
+    std::size_t mapped_bytes = measureResidency(loader, residency->second);
+    if (0 == mapped_bytes) {
+      // Not mapped, e.g. unloaded on demand along with its last plugin
+      residency->second.resident.store(false);
+      continue;
+    }
+    resident_bytes += mapped_bytes;
+    if (0 == loader->getPluginInstanceCount()) {
+      idle_loaders.emplace_back(residency->second.last_use.load(), loader);
+    }
+  }
+  // Plugins created with createUnmanagedInstance() cannot be tracked, keep their code mapped
+  if (resident_bytes <= budget || PluginLoader::hasUnmanagedInstanceBeenCreated()) {
+    return;
+  }
+
+  std::sort(idle_loaders.begin(), idle_loaders.end());  // Least recently used first
+  for (auto & idle_loader : idle_loaders) {
+    if (resident_bytes <= budget) {
+      break;
+    }
+    PluginLoader * loader = idle_loader.second;
+    LibraryResidency & residency = residency_[loader];
+    logDebug(
+      "plugin_loader::MultiLibraryPluginLoader: "
+      "Evicting library %s (%zu bytes) as %zu bytes are resident for a budget of %zu bytes.",
+      loader->getLibraryPath().c_str(), residency.mapped_bytes.load(), resident_bytes, budget);
+    // Loads are counted, unload as many times as it was loaded
+    for (int remaining_unloads = loader->unloadLibrary(); remaining_unloads > 0; ) {
+      int next_remaining_unloads = loader->unloadLibrary();
+      if (next_remaining_unloads >= remaining_unloads) {
+        break;
+      }
+      remaining_unloads = next_remaining_unloads;
+    }
+    resident_bytes -= residency.mapped_bytes.load();
+    residency.mapped_bytes.store(0);
+    residency.resident.store(false);
+    ++residency_evictions_;
+  }
+}
+
+void MultiLibraryPluginLoader::collectRetiredPluginLoaders(bool force)
+{
+  std::unique_lock<std::mutex> lock(hot_reload_mutex_);
+  auto itr = retired_plugin_loaders_.begin();
+  while (itr != retired_plugin_loaders_.end()) {
+    // Plugins created with createUnmanagedInstance() cannot be tracked, keep their code mapped
+    if (!force && (itr->loader->getPluginInstanceCount() > 0 ||
+      PluginLoader::hasUnmanagedInstanceBeenCreated()))
+    {
+      ++itr;
+      continue;
+    }
+    logDebug(
+      "plugin_loader::MultiLibraryPluginLoader: Destroying retired PluginLoader of library %s.",
+      itr->loader->getLibraryPath().c_str());
+    delete (itr->loader);
+    if (!itr->staged_path.empty()) {
+      unlink(itr->staged_path.c_str());
+    }
+    itr = retired_plugin_loaders_.erase(itr);
+  }
+}
+
 }  // namespace plugin_loader
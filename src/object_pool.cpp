@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "plugin_loader/object_pool.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace plugin_loader
+{
+namespace impl
+{
+
+namespace
+{
+
+/**
+ * @brief Number of idle objects each thread keeps for itself, at most the capacity of the pool
+ */
+const std::size_t kThreadCacheCapacity = 8;
+
+std::uint64_t generateObjectPoolId()
+{
+  static std::atomic<std::uint64_t> next_id(0);
+  return ++next_id;
+}
+
+/**
+ * @brief Guards the pool of every thread cache, taken before the mutex of any pool
+ */
+std::mutex & getThreadCacheOwnershipMutex()
+{
+  static std::mutex m;
+  return m;
+}
+
+}  // namespace
+
+struct ObjectPoolBase::ThreadCache
+{
+  std::mutex mutex;  // Only contended while the pool is drained
+  std::vector<void *> objects;
+  ObjectPoolBase * pool;  // nullptr once the pool is destroyed, under both mutexes
+};
+
+/**
+ * @brief The caches of a thread, handed over to their pools when the thread exits
+ */
+struct ObjectPoolBase::ThreadCacheRegistry
+{
+  ~ThreadCacheRegistry()
+  {
+    std::unique_lock<std::mutex> lock(getThreadCacheOwnershipMutex());
+    for (auto & it : caches) {
+      ObjectPoolBase * pool;
+      {
+        std::unique_lock<std::mutex> cache_lock(it.second->mutex);
+        pool = it.second->pool;
+      }
+      if (nullptr != pool) {
+        pool->adoptThreadCache(it.second);
+      }
+    }
+  }
+
+  std::unordered_map<std::uint64_t, std::shared_ptr<ThreadCache>> caches;
+};
+
+ObjectPoolBase::ObjectPoolBase(std::size_t capacity)
+: id_(generateObjectPoolId()),
+  capacity_(capacity)
+{
+}
+
+ObjectPoolBase::~ObjectPoolBase()
+{
+}
+
+void ObjectPoolBase::drain()
+{
+  std::vector<void *> objects;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    objects.swap(overflow_);
+    for (auto & cache : thread_caches_) {
+      std::unique_lock<std::mutex> cache_lock(cache->mutex);
+      objects.insert(objects.end(), cache->objects.begin(), cache->objects.end());
+      cache->objects.clear();
+    }
+  }
+  for (auto obj : objects) {
+    destroyObject(obj);
+  }
+}
+
+void ObjectPoolBase::setCapacity(std::size_t capacity)
+{
+  capacity_.store(capacity);
+}
+
+void * ObjectPoolBase::acquireObject()
+{
+  ThreadCache & cache = getThreadCache();
+  {
+    std::unique_lock<std::mutex> cache_lock(cache.mutex);
+    if (!cache.objects.empty()) {
+      void * obj = cache.objects.back();
+      cache.objects.pop_back();
+      return obj;
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (overflow_.empty()) {
+    return nullptr;
+  }
+  void * obj = overflow_.back();
+  overflow_.pop_back();
+  return obj;
+}
+
+bool ObjectPoolBase::releaseObject(void * obj)
+{
+  const std::size_t capacity = capacity_.load();
+  ThreadCache & cache = getThreadCache();
+  {
+    std::unique_lock<std::mutex> cache_lock(cache.mutex);
+    if (cache.objects.size() < std::min(capacity, kThreadCacheCapacity)) {
+      cache.objects.push_back(obj);
+      return true;
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (overflow_.size() >= capacity) {
+    return false;
+  }
+  overflow_.push_back(obj);
+  return true;
+}
+
+void ObjectPoolBase::shutdown()
+{
+  {
+    std::unique_lock<std::mutex> ownership_lock(getThreadCacheOwnershipMutex());
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto & cache : thread_caches_) {
+      std::unique_lock<std::mutex> cache_lock(cache->mutex);
+      cache->pool = nullptr;
+    }
+  }
+  drain();
+}
+
+ObjectPoolBase::ThreadCache & ObjectPoolBase::getThreadCache()
+{
+  static thread_local ThreadCacheRegistry registry;
+  std::shared_ptr<ThreadCache> & cache = registry.caches[id_];
+  if (!cache) {
+    // Forget the caches of the pools destroyed meanwhile
+    for (auto it = registry.caches.begin(); it != registry.caches.end(); ) {
+      bool is_detached = false;
+      if (it->second) {
+        std::unique_lock<std::mutex> cache_lock(it->second->mutex);
+        is_detached = nullptr == it->second->pool;
+      }
+      it = is_detached ? registry.caches.erase(it) : std::next(it);
+    }
+
+    cache = std::make_shared<ThreadCache>();
+    cache->pool = this;
+    std::unique_lock<std::mutex> lock(mutex_);
+    thread_caches_.push_back(cache);
+  }
+  return *cache;
+}
+
+void ObjectPoolBase::adoptThreadCache(const std::shared_ptr<ThreadCache> & cache)
+{
+  std::vector<void *> excess_objects;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::unique_lock<std::mutex> cache_lock(cache->mutex);
+    for (auto obj : cache->objects) {
+      if (overflow_.size() < capacity_.load()) {
+        overflow_.push_back(obj);
+      } else {
+        excess_objects.push_back(obj);
+      }
+    }
+    cache->objects.clear();
+    cache->pool = nullptr;
+    thread_caches_.erase(
+      std::remove(thread_caches_.begin(), thread_caches_.end(), cache), thread_caches_.end());
+  }
+  for (auto obj : excess_objects) {
+    destroyObject(obj);
+  }
+}
+
+}  // namespace impl
+}  // namespace plugin_loader
@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "plugin_loader/plugin_index.hpp"
+#include "plugin_loader/plugin_loader.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace plugin_loader
+{
+
+namespace
+{
+
+// On-disk layout: an IndexHeader followed by the library records, the class records and a
+// table of NUL terminated strings referenced by offset. Every record has a fixed size and is
+// naturally aligned so that the file can be used straight from a read-only mapping.
+
+const char kIndexMagic[8] = {'P', 'L', 'I', 'N', 'D', 'E', 'X', '\0'};
+const std::uint32_t kIndexVersion = 1;
+
+struct IndexHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t num_libraries;
+  std::uint32_t num_classes;
+  std::uint32_t string_table_size;
+};
+
+struct IndexLibraryRecord
+{
+  std::uint64_t device;
+  std::uint64_t inode;
+  std::uint64_t size;
+  std::int64_t mtime_ns;
+  std::uint32_t path_offset;
+  std::uint32_t first_class;
+  std::uint32_t num_classes;
+  std::uint32_t reserved;
+};
+
+struct IndexClassRecord
+{
+  std::uint32_t base_class_offset;
+  std::uint32_t class_offset;
+};
+
+class StringTable
+{
+public:
+  std::uint32_t add(const std::string & str)
+  {
+    auto itr = offsets_.find(str);
+    if (itr != offsets_.end()) {
+      return itr->second;
+    }
+    std::uint32_t offset = static_cast<std::uint32_t>(data_.size());
+    data_.insert(data_.end(), str.begin(), str.end());
+    data_.push_back('\0');
+    offsets_[str] = offset;
+    return offset;
+  }
+
+  const std::vector<char> & data() const {return data_;}
+
+private:
+  std::vector<char> data_;
+  std::map<std::string, std::uint32_t> offsets_;
+};
+
+bool readString(
+  const char * table, std::uint32_t table_size, std::uint32_t offset, std::string & str)
+{
+  if (offset >= table_size) {
+    return false;
+  }
+  const void * end = std::memchr(table + offset, '\0', table_size - offset);
+  if (nullptr == end) {
+    return false;
+  }
+  str.assign(table + offset, static_cast<const char *>(end));
+  return true;
+}
+
+bool decodeIndex(const char * data, std::size_t size, PluginIndex::LibraryEntryVector & libraries)
+{
+  if (size < sizeof(IndexHeader)) {
+    return false;
+  }
+  IndexHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+    header.version != kIndexVersion)
+  {
+    return false;
+  }
+
+  std::size_t libraries_offset = sizeof(IndexHeader);
+  std::size_t classes_offset =
+    libraries_offset + std::size_t(header.num_libraries) * sizeof(IndexLibraryRecord);
+  std::size_t strings_offset =
+    classes_offset + std::size_t(header.num_classes) * sizeof(IndexClassRecord);
+  if (strings_offset + header.string_table_size != size) {
+    return false;
+  }
+
+  const IndexLibraryRecord * library_records =
+    reinterpret_cast<const IndexLibraryRecord *>(data + libraries_offset);
+  const IndexClassRecord * class_records =
+    reinterpret_cast<const IndexClassRecord *>(data + classes_offset);
+  const char * strings = data + strings_offset;
+
+  libraries.clear();
+  libraries.reserve(header.num_libraries);
+  for (std::uint32_t l = 0; l < header.num_libraries; ++l) {
+    const IndexLibraryRecord & record = library_records[l];
+    if (std::size_t(record.first_class) + record.num_classes > header.num_classes) {
+      return false;
+    }
+    PluginIndex::LibraryEntry library;
+    library.device = record.device;
+    library.inode = record.inode;
+    library.size = record.size;
+    library.mtime_ns = record.mtime_ns;
+    if (!readString(strings, header.string_table_size, record.path_offset, library.library_path)) {
+      return false;
+    }
+    for (std::uint32_t c = record.first_class; c < record.first_class + record.num_classes; ++c) {
+      PluginIndex::ClassEntry entry;
+      if (!readString(
+          strings, header.string_table_size, class_records[c].base_class_offset,
+          entry.base_class_name) ||
+        !readString(
+          strings, header.string_table_size, class_records[c].class_offset, entry.class_name))
+      {
+        return false;
+      }
+      library.classes.push_back(entry);
+    }
+    libraries.push_back(library);
+  }
+  return true;
+}
+
+bool statLibrary(const std::string & path, PluginIndex::LibraryEntry & library)
+{
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+    return false;
+  }
+  library.library_path = path;
+  library.device = static_cast<std::uint64_t>(file_stat.st_dev);
+  library.inode = static_cast<std::uint64_t>(file_stat.st_ino);
+  library.size = static_cast<std::uint64_t>(file_stat.st_size);
+#if CL_OS == CL_OS_MAC_OS_X
+  library.mtime_ns =
+    std::int64_t(file_stat.st_mtimespec.tv_sec) * 1000000000 + file_stat.st_mtimespec.tv_nsec;
+#else
+  library.mtime_ns =
+    std::int64_t(file_stat.st_mtim.tv_sec) * 1000000000 + file_stat.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+bool isSameFile(const PluginIndex::LibraryEntry & a, const PluginIndex::LibraryEntry & b)
+{
+  return a.device == b.device && a.inode == b.inode && a.size == b.size &&
+         a.mtime_ns == b.mtime_ns;
+}
+
+bool hasSharedLibrarySuffix(const std::string & file_name)
+{
+  const std::string suffix = SharedLibrary::suffix();
+  return file_name.size() > suffix.size() &&
+         file_name.compare(file_name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+PluginIndex::PluginIndex()
+{
+}
+
+bool PluginIndex::load(const std::string & index_path)
+{
+  libraries_.clear();
+
+  int fd = open(index_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    logDebug(
+      "plugin_loader.PluginIndex: No plugin index found at %s.", index_path.c_str());
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+  std::size_t size = static_cast<std::size_t>(file_stat.st_size);
+  void * data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (MAP_FAILED == data) {
+    logWarn(
+      "plugin_loader.PluginIndex: Could not map plugin index %s.", index_path.c_str());
+    return false;
+  }
+
+  bool is_valid = decodeIndex(static_cast<const char *>(data), size, libraries_);
+  munmap(data, size);
+  if (!is_valid) {
+    logWarn(
+      "plugin_loader.PluginIndex: Ignoring invalid or outdated plugin index %s.",
+      index_path.c_str());
+    libraries_.clear();
+    return false;
+  }
+  return true;
+}
+
+void PluginIndex::save(const std::string & index_path) const
+{
+  StringTable strings;
+  std::vector<IndexLibraryRecord> library_records;
+  std::vector<IndexClassRecord> class_records;
+
+  for (auto & library : libraries_) {
+    IndexLibraryRecord record;
+    record.device = library.device;
+    record.inode = library.inode;
+    record.size = library.size;
+    record.mtime_ns = library.mtime_ns;
+    record.path_offset = strings.add(library.library_path);
+    record.first_class = static_cast<std::uint32_t>(class_records.size());
+    record.num_classes = static_cast<std::uint32_t>(library.classes.size());
+    record.reserved = 0;
+    library_records.push_back(record);
+    for (auto & entry : library.classes) {
+      IndexClassRecord class_record;
+      class_record.base_class_offset = strings.add(entry.base_class_name);
+      class_record.class_offset = strings.add(entry.class_name);
+      class_records.push_back(class_record);
+    }
+  }
+
+  IndexHeader header;
+  std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+  header.version = kIndexVersion;
+  header.num_libraries = static_cast<std::uint32_t>(library_records.size());
+  header.num_classes = static_cast<std::uint32_t>(class_records.size());
+  header.string_table_size = static_cast<std::uint32_t>(strings.data().size());
+
+  // Write to a temporary file first so that concurrent readers never see a partial index
+  std::string tmp_path = index_path + ".tmp." + std::to_string(getpid());
+  FILE * file = fopen(tmp_path.c_str(), "wb");
+  if (nullptr == file) {
+    throw plugin_loader::PluginIndexException(
+            "Could not open plugin index " + tmp_path + " for writing");
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  if (ok && !library_records.empty()) {
+    ok = fwrite(
+      library_records.data(), sizeof(IndexLibraryRecord), library_records.size(),
+      file) == library_records.size();
+  }
+  if (ok && !class_records.empty()) {
+    ok = fwrite(
+      class_records.data(), sizeof(IndexClassRecord), class_records.size(),
+      file) == class_records.size();
+  }
+  if (ok && !strings.data().empty()) {
+    ok = fwrite(strings.data().data(), 1, strings.data().size(), file) == strings.data().size();
+  }
+  ok = (fclose(file) == 0) && ok;
+  if (!ok || rename(tmp_path.c_str(), index_path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    throw plugin_loader::PluginIndexException("Could not write plugin index " + index_path);
+  }
+}
+
+std::size_t PluginIndex::scanDirectory(const std::string & directory_path)
+{
+  DIR * dir = opendir(directory_path.c_str());
+  if (nullptr == dir) {
+    throw plugin_loader::PluginIndexException(
+            "Could not open plugin directory " + directory_path);
+  }
+  std::vector<std::string> library_paths;
+  while (struct dirent * entry = readdir(dir)) {
+    std::string file_name = entry->d_name;
+    if (hasSharedLibrarySuffix(file_name)) {
+      library_paths.push_back(directory_path + "/" + file_name);
+    }
+  }
+  closedir(dir);
+  std::sort(library_paths.begin(), library_paths.end());
+
+  std::map<std::string, const LibraryEntry *> previous_entries;
+  for (auto & library : libraries_) {
+    previous_entries[library.library_path] = &library;
+  }
+
+  LibraryEntryVector libraries;
+  std::size_t num_scanned = 0;
+  for (auto & library_path : library_paths) {
+    LibraryEntry library;
+    if (!statLibrary(library_path, library)) {
+      continue;
+    }
+    auto previous = previous_entries.find(library_path);
+    if (previous != previous_entries.end() && isSameFile(*previous->second, library)) {
+      library.classes = previous->second->classes;
+      libraries.push_back(library);
+      continue;
+    }
+
+    logDebug(
+      "plugin_loader.PluginIndex: Discovering classes of new or modified library %s.",
+      library_path.c_str());
+    ++num_scanned;
+    try {
+      PluginLoader loader(library_path, false);
+      for (auto & base_and_class : impl::getAllClassesForLibrary(library_path)) {
+        ClassEntry entry;
+        entry.base_class_name = base_and_class.first;
+        entry.class_name = base_and_class.second;
+        library.classes.push_back(entry);
+      }
+    } catch (const plugin_loader::LibraryLoadException & e) {
+      logWarn(
+        "plugin_loader.PluginIndex: Not indexing %s as it could not be loaded (%s).",
+        library_path.c_str(), e.what());
+      continue;
+    }
+    libraries.push_back(library);
+  }
+
+  libraries_.swap(libraries);
+  return num_scanned;
+}
+
+std::size_t PluginIndex::update(const std::string & directory_path, const std::string & index_path)
+{
+  bool was_loaded = load(index_path);
+  std::size_t num_libraries = libraries_.size();
+  std::size_t num_scanned = scanDirectory(directory_path);
+  if (!was_loaded || num_scanned > 0 || num_libraries != libraries_.size()) {
+    save(index_path);
+  }
+  return num_scanned;
+}
+
+}  // namespace plugin_loader
@@ -29,6 +29,9 @@
 
 #include "plugin_loader/plugin_loader.hpp"
 
+#include <atomic>
+#include <cstddef>
+#include <map>
 #include <string>
 
 namespace plugin_loader
@@ -42,16 +45,28 @@ bool PluginLoader::hasUnmanagedInstanceBeenCreated()
 }
 
 
-PluginLoader::PluginLoader(const std::string & library_path, bool ondemand_load_unload)
+PluginLoader::PluginLoader(
+  const std::string & library_path, bool ondemand_load_unload, bool isolated)
 : ondemand_load_unload_(ondemand_load_unload),
+  isolated_(isolated),
   library_path_(library_path),
+  library_key_(library_path),
   load_ref_count_(0),
-  plugin_ref_count_(0)
+  load_ref_count_mutex_("PluginLoader::load_ref_count_mutex_"),
+  plugin_ref_count_(0),
+  plugin_ref_count_mutex_("PluginLoader::plugin_ref_count_mutex_"),
+  deferred_plugin_count_(0),
+  object_pool_capacity_(16)
 {
   logDebug(
     "plugin_loader.PluginLoader: "
     "Constructing new PluginLoader (%p) bound to library %s.",
     this, library_path.c_str());
+  if (isolated_) {
+    static std::atomic<std::size_t> isolated_library_count(0);
+    library_key_ += "@" + std::to_string(++isolated_library_count);
+  }
+  library_metrics_ = impl::getLibraryMetrics(library_path_);
   if (!isOnDemandLoadUnloadEnabled()) {
     loadLibrary();
   }
@@ -62,37 +77,50 @@ PluginLoader::~PluginLoader()
   logDebug("%s",
     "plugin_loader.PluginLoader: "
     "Destroying class loader, unloading associated library...\n");
+  // Deferred work must not call markIdle() for this loader once forgotten
+  impl::LibraryReaper::instance().flush(this);
+  impl::LibraryReaper::instance().forget(this);
   unloadLibrary();  // TODO(mikaelarguedas): while(unloadLibrary() > 0){} ??
 }
 
 bool PluginLoader::isLibraryLoaded()
 {
-  return plugin_loader::impl::isLibraryLoaded(getLibraryPath(), this);
+  return plugin_loader::impl::isLibraryLoaded(library_key_, this);
 }
 
 bool PluginLoader::isLibraryLoadedByAnyClassloader()
 {
-  return plugin_loader::impl::isLibraryLoadedByAnybody(getLibraryPath());
+  return plugin_loader::impl::isLibraryLoadedByAnybody(library_key_);
 }
 
 void PluginLoader::loadLibrary()
 {
-  std::unique_lock<std::recursive_mutex> lock(load_ref_count_mutex_);
+  std::unique_lock<impl::RecursiveMutex> lock(load_ref_count_mutex_);
+  try {
+    plugin_loader::impl::loadLibrary(library_key_, this);
+  } catch (...) {
+    impl::incrementCounter(library_metrics_, impl::LibraryCounter::LoadFailure);
+    throw;
+  }
+  if (0 == load_ref_count_) {
+    impl::incrementCounter(library_metrics_, impl::LibraryCounter::Load);
+  }
   load_ref_count_ = load_ref_count_ + 1;
-  plugin_loader::impl::loadLibrary(getLibraryPath(), this);
 }
 
 int PluginLoader::unloadLibrary()
 {
+  // Plugins released before should not keep the library loaded
+  impl::LibraryReaper::instance().flush(this);
   return unloadLibraryInternal(true);
 }
 
 int PluginLoader::unloadLibraryInternal(bool lock_plugin_ref_count)
 {
-  std::unique_lock<std::recursive_mutex> load_ref_lock(load_ref_count_mutex_);
-  std::unique_lock<std::recursive_mutex> plugin_ref_lock;
+  std::unique_lock<impl::RecursiveMutex> load_ref_lock(load_ref_count_mutex_);
+  std::unique_lock<impl::RecursiveMutex> plugin_ref_lock;
   if (lock_plugin_ref_count) {
-    plugin_ref_lock = std::unique_lock<std::recursive_mutex>(plugin_ref_count_mutex_);
+    plugin_ref_lock = std::unique_lock<impl::RecursiveMutex>(plugin_ref_count_mutex_);
   }
 
   if (plugin_ref_count_ > 0) {
@@ -102,10 +130,18 @@ int PluginLoader::unloadLibraryInternal(bool lock_plugin_ref_count)
       "exist in the heap! "
       "You should delete your objects before attempting to unload the library or "
       "destroying the PluginLoader. The library will NOT be unloaded.");
+    logLiveInstances();
   } else {
     load_ref_count_ = load_ref_count_ - 1;
     if (0 == load_ref_count_) {
-      plugin_loader::impl::unloadLibrary(getLibraryPath(), this);
+      drainObjectPools();
+      try {
+        plugin_loader::impl::unloadLibrary(library_key_, this);
+      } catch (...) {
+        impl::incrementCounter(library_metrics_, impl::LibraryCounter::UnloadFailure);
+        throw;
+      }
+      impl::incrementCounter(library_metrics_, impl::LibraryCounter::Unload);
     } else if (load_ref_count_ < 0) {
       load_ref_count_ = 0;
     }
@@ -113,4 +149,126 @@ int PluginLoader::unloadLibraryInternal(bool lock_plugin_ref_count)
   return load_ref_count_;
 }
 
+int PluginLoader::getPluginInstanceCount()
+{
+  std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+  return plugin_ref_count_;
+}
+
+void PluginLoader::loadLibraryForCreation()
+{
+  if (isOnDemandLoadUnloadEnabled() && impl::LibraryReaper::instance().isRetentionEnabled()) {
+    impl::LibraryReaper::instance().markBusy(this);
+  }
+  // Taking the reference before loading keeps the library from being unloaded by the release of
+  // another plugin, e.g. on the reaper thread, before the new plugin holds it
+  std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+  ++plugin_ref_count_;
+  if (!isLibraryLoaded()) {
+    try {
+      loadLibrary();
+    } catch (...) {
+      --plugin_ref_count_;
+      throw;
+    }
+  }
+}
+
+void PluginLoader::releaseCreationReference()
+{
+  std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+  releasePluginReference(lock);
+}
+
+void PluginLoader::onPluginReleased(std::unique_lock<impl::RecursiveMutex> & lock)
+{
+  impl::LibraryReaper & reaper = impl::LibraryReaper::instance();
+  if (reaper.isDeferredDestructionEnabled()) {
+    lock.unlock();
+    reaper.defer(this, nullptr, nullptr);
+    return;
+  }
+  releasePluginReference(lock);
+}
+
+void PluginLoader::reclaimDeferredPlugin(void * obj, void (* destroy)(void *))
+{
+  impl::TraceScope trace(TraceEventType::Destroy, library_path_);
+  std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+  if (nullptr != obj) {
+    destroy(obj);
+    impl::incrementCounter(library_metrics_, impl::LibraryCounter::Destruction);
+  }
+  releasePluginReference(lock);
+}
+
+void PluginLoader::releasePluginReference(std::unique_lock<impl::RecursiveMutex> & lock)
+{
+  plugin_ref_count_ = plugin_ref_count_ - 1;
+  assert(plugin_ref_count_ >= 0);
+  if (0 == plugin_ref_count_ && isOnDemandLoadUnloadEnabled()) {
+    if (!PluginLoader::hasUnmanagedInstanceBeenCreated()) {
+      impl::LibraryReaper & reaper = impl::LibraryReaper::instance();
+      if (reaper.isRetentionEnabled()) {
+        // The reaper locks plugin_ref_count_mutex_ when it unloads the library
+        lock.unlock();
+        reaper.markIdle(this);
+      } else {
+        unloadLibraryInternal(false);
+      }
+    } else {
+      logWarn(
+        "plugin_loader::PluginLoader: "
+        "Cannot unload library %s even though last shared pointer went out of scope. "
+        "This is because createUnmanagedInstance was used within the scope of this process,"
+        " perhaps by a different PluginLoader. Library will NOT be closed.",
+        getLibraryPath().c_str());
+    }
+  }
+}
+
+void PluginLoader::setObjectPoolCapacity(std::size_t capacity)
+{
+  std::unique_lock<std::mutex> lock(object_pools_mutex_);
+  object_pool_capacity_ = capacity;
+  for (auto & pool : object_pools_) {
+    pool.second->setCapacity(capacity);
+  }
+}
+
+std::size_t PluginLoader::getObjectPoolCapacity()
+{
+  std::unique_lock<std::mutex> lock(object_pools_mutex_);
+  return object_pool_capacity_;
+}
+
+void PluginLoader::drainObjectPools()
+{
+  std::unique_lock<std::mutex> lock(object_pools_mutex_);
+  for (auto & pool : object_pools_) {
+    pool.second->drain();
+  }
+}
+
+void PluginLoader::logLiveInstances()
+{
+  std::map<std::string, std::size_t> instance_counts;
+  for (const InstanceInfo & instance : instance_tracker_.getInstances()) {
+    ++instance_counts[instance.class_name];
+  }
+  for (auto & it : instance_counts) {
+    logWarn(
+      "plugin_loader.PluginLoader: %zu live instance(s) of class %s keep library %s loaded.",
+      it.second, it.first.c_str(), getLibraryPath().c_str());
+  }
+}
+
+void PluginLoader::unloadIdleLibrary()
+{
+  std::unique_lock<impl::RecursiveMutex> lock(plugin_ref_count_mutex_);
+  if (0 == plugin_ref_count_) {
+    unloadLibraryInternal(false);
+  }
+}
+
 }  // namespace plugin_loader
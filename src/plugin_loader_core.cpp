@@ -28,13 +28,22 @@
  */
 
 #include "plugin_loader/plugin_loader_core.hpp"
+#include "plugin_loader/event_trace.hpp"
 #include "plugin_loader/plugin_loader.hpp"
+#include "plugin_loader/registry_snapshot.hpp"
 
 #include "plugin_loader/shared_library.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
 #include <string>
+#include <typeinfo>
 #include <vector>
 
 namespace plugin_loader
@@ -56,6 +65,11 @@ FactoryMap & getFactoryMapForBaseClass(const std::string & typeid_base_class_nam
   return factoryMapMap[base_class_name];
 }
 
+CandidateFactoryMap & getCandidateFactoryMapForBaseClass(const std::string & typeid_base_class_name)
+{
+  return getGlobalPluginBaseToCandidateFactoryMapMap()[typeid_base_class_name];
+}
+
 std::string getCurrentlyLoadingLibraryName()
 {
   return getCurrentlyLoadingLibraryNameReference();
@@ -85,33 +99,250 @@ void hasANonPurePluginLibraryBeenOpened(bool hasIt)
   hasANonPurePluginLibraryBeenOpenedReference() = hasIt;
 }
 
+std::size_t getRegistryGeneration()
+{
+  return getRegistryGenerationReference().load(std::memory_order_acquire);
+}
+
+void bumpRegistryGeneration()
+{
+  getRegistryGenerationReference().fetch_add(1, std::memory_order_acq_rel);
+}
+
+namespace
+{
+
+/**
+ * @brief A factory cached by a thread, valid as long as the registry generation is unchanged
+ */
+struct CachedFactory
+{
+  std::size_t generation = 0;
+  const PluginLoader * loader = nullptr;
+  const char * typeid_base_class_name = nullptr;
+  std::string class_name;
+  void * factory = nullptr;
+};
+
+const std::size_t kFactoryCacheSize = 64;  // A power of 2
+
+/**
+ * @brief Gets the entry of the factory cache of the calling thread a class maps to
+ */
+CachedFactory & getCachedFactoryEntry(
+  const char * typeid_base_class_name, const std::string & class_name, const PluginLoader * loader)
+{
+  static thread_local CachedFactory cache[kFactoryCacheSize];
+  std::size_t hash = std::hash<std::string>()(class_name);
+  hash ^= reinterpret_cast<std::uintptr_t>(typeid_base_class_name) + 0x9e3779b9 + (hash << 6) +
+    (hash >> 2);
+  hash ^= reinterpret_cast<std::uintptr_t>(loader) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  return cache[hash & (kFactoryCacheSize - 1)];
+}
+
+/**
+ * @brief Gets the path of the file of a library, which the library path of an isolated copy is
+ * only a key for, @see PluginLoader::getLibraryKey()
+ */
+std::string getLibraryFilePath(const std::string & library_path, PluginLoader * loader)
+{
+  return nullptr != loader && loader->isIsolated() ? loader->getLibraryPath() : library_path;
+}
+
+}  // namespace
+
+void * findCachedFactory(
+  const char * typeid_base_class_name, const std::string & class_name, const PluginLoader * loader)
+{
+  CachedFactory & entry = getCachedFactoryEntry(typeid_base_class_name, class_name, loader);
+  if (nullptr == entry.factory || entry.generation != getRegistryGeneration() ||
+    entry.loader != loader || entry.typeid_base_class_name != typeid_base_class_name ||
+    entry.class_name != class_name)
+  {
+    return nullptr;
+  }
+  return entry.factory;
+}
+
+void cacheFactory(
+  const char * typeid_base_class_name, const std::string & class_name, const PluginLoader * loader,
+  void * factory, std::size_t generation)
+{
+  CachedFactory & entry = getCachedFactoryEntry(typeid_base_class_name, class_name, loader);
+  entry.generation = generation;
+  entry.loader = loader;
+  entry.typeid_base_class_name = typeid_base_class_name;
+  entry.class_name = class_name;
+  entry.factory = factory;
+}
+
 
 // MetaObject search/insert/removal/query
 
-MetaObjectVector allMetaObjects(const FactoryMap & factories)
+MetaObjectVector allMetaObjects(const CandidateFactoryMap & factories)
 {
   MetaObjectVector all_meta_objs;
   for (auto & it : factories) {
-    all_meta_objs.push_back(it.second);
+    all_meta_objs.insert(all_meta_objs.end(), it.second.begin(), it.second.end());
   }
   return all_meta_objs;
 }
 
 MetaObjectVector allMetaObjects()
 {
-  std::unique_lock<std::recursive_mutex> lock(getPluginBaseToFactoryMapMapMutex());
+  std::unique_lock<RecursiveMutex> lock(lockPluginBaseToFactoryMapMapMutex());
 
   MetaObjectVector all_meta_objs;
-  BaseToFactoryMapMap & factory_map_map = getGlobalPluginBaseToFactoryMapMap();
-  BaseToFactoryMapMap::iterator itr;
+  BaseToCandidateFactoryMapMap & candidate_map_map = getGlobalPluginBaseToCandidateFactoryMapMap();
 
-  for (auto & it : factory_map_map) {
+  // Note: Shadowed factories are included, they belong to a library as much as the winning ones
+  for (auto & it : candidate_map_map) {
     MetaObjectVector objs = allMetaObjects(it.second);
     all_meta_objs.insert(all_meta_objs.end(), objs.begin(), objs.end());
   }
   return all_meta_objs;
 }
 
+bool isLaterLibraryPreferred(
+  const std::string & later_library_path, const std::string & earlier_library_path)
+{
+  std::unique_lock<RecursiveMutex> lock(lockPluginBaseToFactoryMapMapMutex());
+  switch (getDuplicateClassPolicyReference()) {
+    case DuplicateClassPolicy::FirstRegisteredWins:
+      return false;
+    case DuplicateClassPolicy::LibraryPriority:
+      return getLibraryPriority(later_library_path) >= getLibraryPriority(earlier_library_path);
+    case DuplicateClassPolicy::LastRegisteredWins:
+    default:
+      return true;
+  }
+}
+
+/**
+ * @brief Makes the class name resolve to the factory the DuplicateClassPolicy prefers among the ones registered for it
+ */
+void resolveClass(const std::string & typeid_base_class_name, const std::string & class_name)
+{
+  MetaObjectVector & candidates =
+    getCandidateFactoryMapForBaseClass(typeid_base_class_name)[class_name];
+  FactoryMap & factory_map = getFactoryMapForBaseClass(typeid_base_class_name);
+
+  AbstractMetaObjectBase * winner = nullptr;
+  for (auto & candidate : candidates) {
+    if (nullptr == winner ||
+      isLaterLibraryPreferred(
+        candidate->getAssociatedLibraryPath(), winner->getAssociatedLibraryPath()))
+    {
+      winner = candidate;
+    }
+  }
+
+  if (nullptr == winner) {
+    factory_map.erase(class_name);
+    getCandidateFactoryMapForBaseClass(typeid_base_class_name).erase(class_name);
+    return;
+  }
+  FactoryMap::iterator current = factory_map.find(class_name);
+  if (current != factory_map.end() && current->second != winner) {
+    logDebug(
+      "plugin_loader.impl: Class %s now resolves to the factory of library %s instead of %s.",
+      class_name.c_str(), winner->getAssociatedLibraryPath().c_str(),
+      current->second->getAssociatedLibraryPath().c_str());
+  }
+  factory_map[class_name] = winner;
+}
+
+void insertMetaObject(AbstractMetaObjectBase * meta_obj)
+{
+  const std::string base_class_name = meta_obj->typeidBaseClassName();
+  const std::string class_name = meta_obj->className();
+  const std::string library_path = meta_obj->getAssociatedLibraryPath();
+  MetaObjectVector & candidates = getCandidateFactoryMapForBaseClass(base_class_name)[class_name];
+  FactoryMap & qualified_map = getGlobalPluginBaseToQualifiedFactoryMapMap()[base_class_name];
+
+  const std::string qualified_name = qualifiedClassName(library_path, class_name);
+  FactoryMap::iterator same_library = qualified_map.find(qualified_name);
+  if (same_library != qualified_map.end() && same_library->second != meta_obj) {
+    logWarn(
+      "plugin_loader.impl: SEVERE WARNING!!! "
+      "A namespace collision has occured with plugin factory for class %s. "
+      "New factory will OVERWRITE existing one. "
+      "This situation occurs when libraries containing plugins are directly linked against an "
+      "executable (the one running right now generating this message). "
+      "Please separate plugins out into their own library or just don't link against the library "
+      "and use either plugin_loader::PluginLoader/MultiLibraryPluginLoader to open.",
+      class_name.c_str());
+    candidates.erase(std::remove(candidates.begin(), candidates.end(), same_library->second),
+      candidates.end());
+  } else if (nullptr == dynamic_cast<IsolatedMetaObject *>(meta_obj)) {
+    // Only warn once per library, libraries unloaded on demand register their classes again.
+    // Isolated copies of a library are duplicates on purpose and are not worth a warning.
+    MetaObjectVector::iterator other = std::find_if(candidates.begin(), candidates.end(),
+        [](AbstractMetaObjectBase * candidate) {
+          return nullptr == dynamic_cast<IsolatedMetaObject *>(candidate);
+        });
+    static std::set<std::string> reported_qualified_names;
+    if (other != candidates.end() && reported_qualified_names.insert(qualified_name).second) {
+      logWarn(
+        "plugin_loader.impl: "
+        "Class %s is registered by several libraries (%s and %s). The DuplicateClassPolicy "
+        "decides which one the class name resolves to, the other ones stay reachable through "
+        "qualified class names of the form library_path::%s.",
+        class_name.c_str(), (*other)->getAssociatedLibraryPath().c_str(),
+        library_path.c_str(), class_name.c_str());
+    }
+  }
+
+  candidates.push_back(meta_obj);
+  qualified_map[qualified_name] = meta_obj;
+  resolveClass(base_class_name, class_name);
+  bumpRegistryGeneration();
+}
+
+void removeMetaObject(AbstractMetaObjectBase * meta_obj)
+{
+  const std::string base_class_name = meta_obj->typeidBaseClassName();
+  const std::string class_name = meta_obj->className();
+  MetaObjectVector & candidates = getCandidateFactoryMapForBaseClass(base_class_name)[class_name];
+  candidates.erase(std::remove(candidates.begin(), candidates.end(), meta_obj), candidates.end());
+
+  FactoryMap & qualified_map = getGlobalPluginBaseToQualifiedFactoryMapMap()[base_class_name];
+  FactoryMap::iterator qualified = qualified_map.find(
+    qualifiedClassName(meta_obj->getAssociatedLibraryPath(), class_name));
+  if (qualified != qualified_map.end() && qualified->second == meta_obj) {
+    qualified_map.erase(qualified);
+  }
+
+  resolveClass(base_class_name, class_name);
+  bumpRegistryGeneration();
+}
+
+AbstractMetaObjectBase * findMetaObject(
+  const std::string & typeid_base_class_name, const std::string & class_name,
+  const PluginLoader * loader)
+{
+  std::unique_lock<RecursiveMutex> lock(lockPluginBaseToFactoryMapMapMutex());
+
+  FactoryMap & factory_map = getFactoryMapForBaseClass(typeid_base_class_name);
+  FactoryMap & qualified_map = getGlobalPluginBaseToQualifiedFactoryMapMap()[typeid_base_class_name];
+
+  FactoryMap::iterator factory = factory_map.find(class_name);
+  if (factory != factory_map.end()) {
+    if (nullptr == loader || factory->second->isOwnedBy(loader) ||
+      factory->second->isOwnedBy(nullptr))
+    {
+      return factory->second;
+    }
+    // The class of the loader's own library may be shadowed by another library
+    FactoryMap::iterator own = qualified_map.find(
+      qualifiedClassName(loader->getLibraryKey(), class_name));
+    return own != qualified_map.end() ? own->second : factory->second;
+  }
+
+  FactoryMap::iterator qualified = qualified_map.find(class_name);
+  return qualified != qualified_map.end() ? qualified->second : nullptr;
+}
+
 MetaObjectVector
 filterAllMetaObjectsOwnedBy(const MetaObjectVector & to_filter, const PluginLoader * owner)
 {
@@ -165,43 +396,9 @@ void insertMetaObjectIntoGraveyard(AbstractMetaObjectBase * meta_obj)
   getMetaObjectGraveyard().push_back(meta_obj);
 }
 
-void destroyMetaObjectsForLibrary(
-  const std::string & library_path, FactoryMap & factories, const PluginLoader * loader)
-{
-  FactoryMap::iterator factory_itr = factories.begin();
-  while (factory_itr != factories.end()) {
-    AbstractMetaObjectBase * meta_obj = factory_itr->second;
-    if (meta_obj->getAssociatedLibraryPath() == library_path && meta_obj->isOwnedBy(loader)) {
-      meta_obj->removeOwningPluginLoader(loader);
-      if (!meta_obj->isOwnedByAnybody()) {
-        FactoryMap::iterator factory_itr_copy = factory_itr;
-        factory_itr++;
-        // TODO(mikaelarguedas) fix this when branching out for melodic
-        // Note: map::erase does not return iterator like vector::erase does.
-        // Hence the ugliness of this code and a need for copy. Should be fixed in next C++ revision
-        factories.erase(factory_itr_copy);
-
-        // Insert into graveyard
-        // We remove the metaobject from its factory map, but we don't destroy it...instead it
-        // saved to a "graveyard" to the side.
-        // This is due to our static global variable initialization problem that causes factories
-        // to not be registered when a library is closed and then reopened.
-        // This is because it's truly not closed due to the use of global symbol binding i.e.
-        // calling dlopen with RTLD_GLOBAL instead of RTLD_LOCAL.
-        // We require using the former as the which is required to support RTTI
-        insertMetaObjectIntoGraveyard(meta_obj);
-      } else {
-        ++factory_itr;
-      }
-    } else {
-      ++factory_itr;
-    }
-  }
-}
-
 void destroyMetaObjectsForLibrary(const std::string & library_path, const PluginLoader * loader)
 {
-  std::unique_lock<std::recursive_mutex> lock(getPluginBaseToFactoryMapMapMutex());
+  std::unique_lock<RecursiveMutex> lock(lockPluginBaseToFactoryMapMapMutex());
 
   logDebug(
     "plugin_loader.impl: "
@@ -209,11 +406,32 @@ void destroyMetaObjectsForLibrary(const std::string & library_path, const Plugin
     "plugin-to-factorymap map.\n",
     library_path.c_str(), reinterpret_cast<const void *>(loader));
 
-  // We have to walk through all FactoryMaps to be sure
-  BaseToFactoryMapMap & factory_map_map = getGlobalPluginBaseToFactoryMapMap();
-  for (auto & it : factory_map_map) {
-    destroyMetaObjectsForLibrary(library_path, it.second, loader);
+  // We have to walk through all factories, including the shadowed ones, to be sure
+  for (auto & meta_obj : allMetaObjectsForLibraryOwnedBy(library_path, loader)) {
+    meta_obj->removeOwningPluginLoader(loader);
+    if (!meta_obj->isOwnedByAnybody()) {
+      removeMetaObject(meta_obj);
+
+      // The factory it stands for goes away with the namespace, a new load imports new ones
+      IsolatedMetaObject * isolated = dynamic_cast<IsolatedMetaObject *>(meta_obj);
+      if (nullptr != isolated) {
+        delete (isolated);
+        continue;
+      }
+
+      // Insert into graveyard
+      // We remove the metaobject from its factory map, but we don't destroy it...instead it
+      // saved to a "graveyard" to the side.
+      // This is due to our static global variable initialization problem that causes factories
+      // to not be registered when a library is closed and then reopened.
+      // This is because it's truly not closed due to the use of global symbol binding i.e.
+      // calling dlopen with RTLD_GLOBAL instead of RTLD_LOCAL.
+      // We require using the former as the which is required to support RTTI
+      meta_obj->releaseLibraryResources();
+      insertMetaObjectIntoGraveyard(meta_obj);
+    }
   }
+  bumpRegistryGeneration();
 
   logDebug("%s", "plugin_loader.impl: Metaobjects removed.");
 }
@@ -237,7 +455,7 @@ LibraryVector::iterator findLoadedLibrary(const std::string & library_path)
 
 bool isLibraryLoadedByAnybody(const std::string & library_path)
 {
-  std::unique_lock<std::recursive_mutex> lock(getLoadedLibraryVectorMutex());
+  std::unique_lock<RecursiveMutex> lock(getLoadedLibraryVectorMutex());
 
   LibraryVector & open_libraries = getLoadedLibraryVector();
   LibraryVector::iterator itr = findLoadedLibrary(library_path);
@@ -276,6 +494,16 @@ std::vector<std::string> getAllLibrariesUsedByPluginLoader(const PluginLoader *
   return all_libs;
 }
 
+std::vector<std::pair<BaseClassName, ClassName>>
+getAllClassesForLibrary(const std::string & library_path)
+{
+  std::vector<std::pair<BaseClassName, ClassName>> classes;
+  for (auto & meta_obj : allMetaObjectsForLibrary(library_path)) {
+    classes.emplace_back(meta_obj->typeidBaseClassName(), meta_obj->className());
+  }
+  return classes;
+}
+
 
 // Implementation of Remaining Core plugin impl Functions
 
@@ -294,12 +522,14 @@ void addPluginLoaderOwnerForAllExistingMetaObjectsForLibrary(
       nullptr == loader ? loader->getLibraryPath().c_str() : "NULL");
     meta_obj->addOwningPluginLoader(loader);
   }
+  bumpRegistryGeneration();
 }
 
 void revivePreviouslyCreateMetaobjectsFromGraveyard(
   const std::string & library_path, PluginLoader * loader)
 {
-  std::unique_lock<std::recursive_mutex> b2fmm_lock(getPluginBaseToFactoryMapMapMutex());
+  TraceScope trace(TraceEventType::Revive, library_path);
+  std::unique_lock<RecursiveMutex> b2fmm_lock(lockPluginBaseToFactoryMapMapMutex());
   MetaObjectVector & graveyard = getMetaObjectGraveyard();
 
   for (auto & obj : graveyard) {
@@ -314,18 +544,19 @@ void revivePreviouslyCreateMetaobjectsFromGraveyard(
 
       obj->addOwningPluginLoader(loader);
       assert(obj->typeidBaseClassName() != "UNSET");
-      FactoryMap & factory = getFactoryMapForBaseClass(obj->typeidBaseClassName());
-      factory[obj->className()] = obj;
+      insertMetaObject(obj);
     }
   }
+  bumpRegistryGeneration();
 }
 
 void purgeGraveyardOfMetaobjects(
   const std::string & library_path, PluginLoader * loader, bool delete_objs)
 {
+  TraceScope trace(TraceEventType::Purge, library_path);
   MetaObjectVector all_meta_objs = allMetaObjects();
   // Note: Lock must happen after call to allMetaObjects as that will lock
-  std::unique_lock<std::recursive_mutex> b2fmm_lock(getPluginBaseToFactoryMapMapMutex());
+  std::unique_lock<RecursiveMutex> b2fmm_lock(lockPluginBaseToFactoryMapMapMutex());
 
   MetaObjectVector & graveyard = getMetaObjectGraveyard();
   MetaObjectVector::iterator itr = graveyard.begin();
@@ -358,14 +589,9 @@ void purgeGraveyardOfMetaobjects(
             "in addition to purging it from graveyard.",
             reinterpret_cast<void *>(obj), obj->className().c_str(), obj->baseClassName().c_str(),
             obj->getAssociatedLibraryPath().c_str());
-#ifndef _WIN32
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdelete-non-virtual-dtor"
-#endif
-          delete (obj);  // Note: This is the only place where metaobjects can be destroyed
-#ifndef _WIN32
-#pragma GCC diagnostic pop
-#endif
+          // Note: This is the only place where metaobjects of plugins are destroyed. New ones were
+          // registered, so the library was unmapped since this one went to the graveyard.
+          AbstractMetaObjectBase::destroyOrphaned(obj);
         }
       }
     } else {
@@ -374,18 +600,75 @@ void purgeGraveyardOfMetaobjects(
   }
 }
 
+struct IsolatedLibraryImport
+{
+  std::string library_path;
+  PluginLoader * loader;
+};
+
+void importIsolatedMetaObject(AbstractMetaObjectBase * factory, void * context)
+{
+  IsolatedLibraryImport * import = static_cast<IsolatedLibraryImport *>(context);
+  AbstractMetaObjectBase * meta_obj = new IsolatedMetaObject(factory);
+  meta_obj->setAssociatedLibraryPath(import->library_path);
+  meta_obj->addOwningPluginLoader(import->loader);
+  insertMetaObject(meta_obj);
+}
+
+void loadIsolatedLibrary(
+  const std::string & library_path, PluginLoader * loader, LibraryLoadTimes & load_times)
+{
+  // The plugins of the library register into the copy of plugin_loader of the new namespace,
+  // which is why that copy has to be a shared library we can ask for them
+  const std::int64_t start_ns = getMetricsClock();
+  SharedLibrary * library_handle =
+    new SharedLibrary(loader->getLibraryPath(), SharedLibrary::SHLIB_ISOLATED);
+  load_times.dlopen_ns = getMetricsClock() - start_ns;
+  recordLatency(LatencyMetric::Dlopen, load_times.dlopen_ns);
+  const char * symbol_name = "plugin_loader_for_each_meta_object";
+  if (!library_handle->hasSymbol(symbol_name)) {
+    delete (library_handle);
+    throw plugin_loader::LibraryLoadException(
+            "Could not load library " + loader->getLibraryPath() + " in isolation, it does "
+            "not link against plugin_loader as a shared library");
+  }
+  typedef void (* ForEachMetaObjectFunction)(
+    void (*)(AbstractMetaObjectBase *, void *), void *);
+  ForEachMetaObjectFunction for_each_meta_object =
+    reinterpret_cast<ForEachMetaObjectFunction>(library_handle->getSymbol(symbol_name));
+
+  logDebug(
+    "plugin_loader.impl: "
+    "Successfully loaded library %s into its own namespace (SharedLibrary handle = %p).",
+    library_path.c_str(), reinterpret_cast<void *>(library_handle));
+
+  {
+    std::unique_lock<RecursiveMutex> lock(lockPluginBaseToFactoryMapMapMutex());
+    IsolatedLibraryImport import{library_path, loader};
+    for_each_meta_object(&importIsolatedMetaObject, &import);
+    bumpRegistryGeneration();
+    load_times.factory_count = allMetaObjectsForLibrary(library_path).size();
+  }
+
+  std::unique_lock<RecursiveMutex> llv_lock(getLoadedLibraryVectorMutex());
+  getLoadedLibraryVector().push_back(LibraryPair(library_path, library_handle));
+}
+
 void loadLibrary(const std::string & library_path, PluginLoader * loader)
 {
-  static std::recursive_mutex loader_mutex;
+  static RecursiveMutex loader_mutex("loadLibrary::loader_mutex");
+  const std::int64_t load_start_ns = getMetricsClock();
   logDebug(
     "plugin_loader.impl: "
     "Attempting to load library %s on behalf of PluginLoader handle %p...\n",
     library_path.c_str(), reinterpret_cast<void *>(loader));
-  std::unique_lock<std::recursive_mutex> loader_lock(loader_mutex);
+  std::unique_lock<RecursiveMutex> loader_lock(loader_mutex);
+  const std::string library_file_path = getLibraryFilePath(library_path, loader);
+  TraceScope trace(TraceEventType::LibraryLoad, library_file_path);
 
   // If it's already open, just update existing metaobjects to have an additional owner.
   if (isLibraryLoadedByAnybody(library_path)) {
-    std::unique_lock<std::recursive_mutex> lock(getPluginBaseToFactoryMapMapMutex());
+    std::unique_lock<RecursiveMutex> lock(lockPluginBaseToFactoryMapMapMutex());
     logDebug("%s",
       "plugin_loader.impl: "
       "Library already in memory, but binding existing MetaObjects to loader if necesesary.\n");
@@ -393,21 +676,38 @@ void loadLibrary(const std::string & library_path, PluginLoader * loader)
     return;
   }
 
+  LibraryLoadTimes load_times = LibraryLoadTimes();
+  load_times.library_path = library_file_path;
+
+  if (nullptr != loader && loader->isIsolated()) {
+    loadIsolatedLibrary(library_path, loader, load_times);
+    load_times.total_ns = getMetricsClock() - load_start_ns;
+    recordLibraryLoadTimes(load_times);
+    return;
+  }
+
   SharedLibrary * library_handle = nullptr;
 
   {
       try {
           setCurrentlyActivePluginLoader(loader);
           setCurrentlyLoadingLibraryName(library_path);
+          setCurrentLibraryLoadTimes(&load_times);
+          TraceScope dlopen_trace(TraceEventType::Dlopen, library_path);
+          const std::int64_t start_ns = getMetricsClock();
           library_handle = new SharedLibrary(library_path);
+          load_times.dlopen_ns = getMetricsClock() - start_ns;
+          recordLatency(LatencyMetric::Dlopen, load_times.dlopen_ns);
       }
       catch (const std::runtime_error & e)
       {
+          setCurrentLibraryLoadTimes(nullptr);
           setCurrentlyLoadingLibraryName("");
           setCurrentlyActivePluginLoader(nullptr);
-          throw e;
+          throw;
       }
 
+    setCurrentLibraryLoadTimes(nullptr);
     setCurrentlyLoadingLibraryName("");
     setCurrentlyActivePluginLoader(nullptr);
   }
@@ -426,27 +726,38 @@ void loadLibrary(const std::string & library_path, PluginLoader * loader)
       "Though the library %s was just loaded, it seems no factory metaobjects were registered. "
       "Checking factory graveyard for previously loaded metaobjects...",
       library_path.c_str());
+    std::int64_t start_ns = getMetricsClock();
     revivePreviouslyCreateMetaobjectsFromGraveyard(library_path, loader);
+    load_times.revive_ns = getMetricsClock() - start_ns;
+    load_times.factory_count = allMetaObjectsForLibrary(library_path).size();
     // Note: The 'false' indicates we don't want to invoke delete on the metaobject
+    start_ns = getMetricsClock();
     purgeGraveyardOfMetaobjects(library_path, loader, false);
+    load_times.purge_ns = getMetricsClock() - start_ns;
   } else {
     logDebug(
       "plugin_loader.impl: "
       "Library %s generated new factory metaobjects on load. "
       "Destroying graveyarded objects from previous loads...",
       library_path.c_str());
+    const std::int64_t start_ns = getMetricsClock();
     purgeGraveyardOfMetaobjects(library_path, loader, true);
+    load_times.purge_ns = getMetricsClock() - start_ns;
   }
 
   // Insert library into global loaded library vector
-  std::unique_lock<std::recursive_mutex> llv_lock(getLoadedLibraryVectorMutex());
+  std::unique_lock<RecursiveMutex> llv_lock(getLoadedLibraryVectorMutex());
   LibraryVector & open_libraries = getLoadedLibraryVector();
   // Note: SharedLibrary automatically calls load() when library passed to constructor
   open_libraries.push_back(LibraryPair(library_path, library_handle));
+  load_times.total_ns = getMetricsClock() - load_start_ns;
+  recordLibraryLoadTimes(load_times);
 }
 
 void unloadLibrary(const std::string & library_path, PluginLoader * loader)
 {
+  const std::string library_file_path = getLibraryFilePath(library_path, loader);
+  TraceScope trace(TraceEventType::Unload, library_file_path);
   if (hasANonPurePluginLibraryBeenOpened()) {
     logDebug(
       "plugin_loader.impl: "
@@ -462,7 +773,7 @@ void unloadLibrary(const std::string & library_path, PluginLoader * loader)
       "plugin_loader.impl: "
       "Unloading library %s on behalf of PluginLoader %p...",
       library_path.c_str(), reinterpret_cast<void *>(loader));
-    std::unique_lock<std::recursive_mutex> lock(getLoadedLibraryVectorMutex());
+    std::unique_lock<RecursiveMutex> lock(getLoadedLibraryVectorMutex());
     LibraryVector & open_libraries = getLoadedLibraryVector();
     LibraryVector::iterator itr = findLoadedLibrary(library_path);
     if (itr != open_libraries.end()) {
@@ -506,34 +817,34 @@ void unloadLibrary(const std::string & library_path, PluginLoader * loader)
 
 void printDebugInfoToScreen()
 {
+  // Printing is slow, so it is done from a copy rather than under the global mutexes
+  RegistrySnapshot snapshot = getRegistrySnapshot();
+
   printf("*******************************************************************************\n");
   printf("*****                 plugin_loader impl DEBUG INFORMATION                 *****\n");
   printf("*******************************************************************************\n");
 
   printf("OPEN LIBRARIES IN MEMORY:\n");
   printf("--------------------------------------------------------------------------------\n");
-  std::unique_lock<std::recursive_mutex> lock(getLoadedLibraryVectorMutex());
-  LibraryVector libs = getLoadedLibraryVector();
-  for (size_t c = 0; c < libs.size(); c++) {
+  for (size_t c = 0; c < snapshot.libraries.size(); c++) {
+    const LibrarySnapshot & library = snapshot.libraries.at(c);
     printf(
       "Open library %zu = %s (Poco SharedLibrary handle = %p)\n",
-      c, (libs.at(c)).first.c_str(), reinterpret_cast<void *>((libs.at(c)).second));
+      c, library.library_path.c_str(), library.handle);
   }
 
   printf("METAOBJECTS (i.e. FACTORIES) IN MEMORY:\n");
   printf("--------------------------------------------------------------------------------\n");
-  MetaObjectVector meta_objs = allMetaObjects();
-  for (size_t c = 0; c < meta_objs.size(); c++) {
-    AbstractMetaObjectBase * obj = meta_objs.at(c);
+  for (size_t c = 0; c < snapshot.factories.size(); c++) {
+    const FactorySnapshot & factory = snapshot.factories.at(c);
     printf("Metaobject %zu (ptr = %p):\n TypeId = %s\n Associated Library = %s\n",
       c,
-      reinterpret_cast<void *>(obj),
-      (typeid(*obj).name()),
-      obj->getAssociatedLibraryPath().c_str());
+      factory.address,
+      factory.type_name.c_str(),
+      factory.library_path.c_str());
 
-    PluginLoaderVector loaders = obj->getAssociatedPluginLoaders();
-    for (size_t i = 0; i < loaders.size(); i++) {
-      printf(" Associated Loader %zu = %p\n", i, reinterpret_cast<void *>(loaders.at(i)));
+    for (size_t i = 0; i < factory.owners.size(); i++) {
+      printf(" Associated Loader %zu = %p\n", i, factory.owners.at(i));
     }
     printf("--------------------------------------------------------------------------------\n");
   }
@@ -548,5 +859,133 @@ PluginLoader *getCurrentlyActivePluginLoader()
 }
 
 
+void plugin_loader_for_each_meta_object(
+  void (* callback)(AbstractMetaObjectBase * meta_obj, void * context), void * context)
+{
+  std::unique_lock<RecursiveMutex> lock(lockPluginBaseToFactoryMapMapMutex());
+  for (auto & meta_obj : allMetaObjects()) {
+    callback(meta_obj, context);
+  }
+}
+
+namespace
+{
+
+FactorySnapshot snapshotFactory(AbstractMetaObjectBase * obj, bool shadowed)
+{
+  FactorySnapshot factory;
+  factory.address = obj;
+  factory.class_name = obj->className();
+  factory.base_class_name = obj->baseClassName();
+  factory.typeid_base_class_name = obj->typeidBaseClassName();
+  factory.library_path = obj->getAssociatedLibraryPath();
+  for (PluginLoader * loader : obj->getAssociatedPluginLoaders()) {
+    factory.owners.push_back(loader);
+  }
+  factory.shadowed = shadowed;
+  return factory;
+}
+
+}  // namespace
+
 }  // namespace impl
+
+// Registry snapshot
+
+RegistrySnapshot getRegistrySnapshot()
+{
+  RegistrySnapshot snapshot;
+  snapshot.time = std::chrono::system_clock::now();
+
+  // Same order as unloadLibrary(), so that the libraries and factories are consistent
+  std::unique_lock<impl::RecursiveMutex> llv_lock(impl::getLoadedLibraryVectorMutex());
+  std::unique_lock<impl::RecursiveMutex> b2fmm_lock(impl::lockPluginBaseToFactoryMapMapMutex());
+  snapshot.generation = impl::getRegistryGeneration();
+  snapshot.non_pure_library_opened = impl::hasANonPurePluginLibraryBeenOpened();
+  // The library path of an isolated copy is a key, report the path of its file instead
+  std::map<std::string, std::string> file_paths;
+  for (auto & library : impl::getLoadedLibraryVector()) {
+    file_paths[library.first] = library.second->getPath();
+    snapshot.libraries.push_back(LibrarySnapshot{library.second->getPath(), library.second});
+  }
+  impl::BaseToFactoryMapMap & factory_map_map = impl::getGlobalPluginBaseToFactoryMapMap();
+  for (auto & base : impl::getGlobalPluginBaseToCandidateFactoryMapMap()) {
+    auto factory_map = factory_map_map.find(base.first);
+    for (auto & candidates : base.second) {
+      impl::AbstractMetaObjectBase * used = nullptr;
+      if (factory_map != factory_map_map.end()) {
+        auto itr = factory_map->second.find(candidates.first);
+        if (itr != factory_map->second.end()) {
+          used = itr->second;
+        }
+      }
+      for (auto & obj : candidates.second) {
+        snapshot.factories.push_back(impl::snapshotFactory(obj, obj != used));
+        snapshot.factories.back().type_name = typeid(*obj).name();
+        auto file_path = file_paths.find(obj->getAssociatedLibraryPath());
+        if (file_path != file_paths.end()) {
+          snapshot.factories.back().library_path = file_path->second;
+        }
+      }
+    }
+  }
+  // Their type is not looked up, as the library that holds their vtable may be unmapped
+  for (auto & obj : impl::getMetaObjectGraveyard()) {
+    snapshot.graveyard.push_back(impl::snapshotFactory(obj, false));
+  }
+  return snapshot;
+}
+
+// Duplicate class resolution
+
+namespace
+{
+
+void resolveAllClasses()
+{
+  for (auto & base : impl::getGlobalPluginBaseToCandidateFactoryMapMap()) {
+    std::vector<std::string> class_names;
+    for (auto & it : base.second) {
+      class_names.push_back(it.first);
+    }
+    for (auto & class_name : class_names) {
+      impl::resolveClass(base.first, class_name);
+    }
+  }
+  impl::bumpRegistryGeneration();
+}
+
+}  // namespace
+
+void setDuplicateClassPolicy(DuplicateClassPolicy policy)
+{
+  std::unique_lock<impl::RecursiveMutex> lock(impl::lockPluginBaseToFactoryMapMapMutex());
+  impl::getDuplicateClassPolicyReference() = policy;
+  resolveAllClasses();
+}
+
+DuplicateClassPolicy getDuplicateClassPolicy()
+{
+  std::unique_lock<impl::RecursiveMutex> lock(impl::lockPluginBaseToFactoryMapMapMutex());
+  return impl::getDuplicateClassPolicyReference();
+}
+
+void setLibraryPriority(const std::string & library_path, int priority)
+{
+  std::unique_lock<impl::RecursiveMutex> lock(impl::lockPluginBaseToFactoryMapMapMutex());
+  impl::getLibraryPriorityMapReference()[library_path] = priority;
+  resolveAllClasses();
+}
+
+int getLibraryPriority(const std::string & library_path)
+{
+  std::unique_lock<impl::RecursiveMutex> lock(impl::lockPluginBaseToFactoryMapMapMutex());
+  auto priority = impl::getLibraryPriorityMapReference().find(library_path);
+  return priority != impl::getLibraryPriorityMapReference().end() ? priority->second : 0;
+}
+
+std::string qualifiedClassName(const std::string & library_path, const std::string & class_name)
+{
+  return library_path + "::" + class_name;
+}
 }  // namespace plugin_loader
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "plugin_loader/registry_snapshot.hpp"
+#include "plugin_loader/internal.hpp"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace plugin_loader
+{
+
+namespace
+{
+
+void appendJsonAddress(std::string & json, const void * address)
+{
+  if (nullptr == address) {
+    json += "null";
+    return;
+  }
+  char hex[24];
+  snprintf(hex, sizeof(hex), "\"0x%" PRIxPTR "\"", reinterpret_cast<std::uintptr_t>(address));
+  json += hex;
+}
+
+void appendJsonFactories(std::string & json, const std::vector<FactorySnapshot> & factories)
+{
+  json += '[';
+  for (std::size_t i = 0; i < factories.size(); ++i) {
+    const FactorySnapshot & factory = factories[i];
+    json += 0 == i ? "\n    {\"address\": " : ",\n    {\"address\": ";
+    appendJsonAddress(json, factory.address);
+    json += ", \"type_name\": ";
+    impl::appendJsonString(json, factory.type_name);
+    json += ", \"class_name\": ";
+    impl::appendJsonString(json, factory.class_name);
+    json += ", \"base_class_name\": ";
+    impl::appendJsonString(json, factory.base_class_name);
+    json += ", \"typeid_base_class_name\": ";
+    impl::appendJsonString(json, factory.typeid_base_class_name);
+    json += ", \"library_path\": ";
+    impl::appendJsonString(json, factory.library_path);
+    json += ", \"owners\": [";
+    for (std::size_t j = 0; j < factory.owners.size(); ++j) {
+      json += 0 == j ? "" : ", ";
+      appendJsonAddress(json, factory.owners[j]);
+    }
+    json += "], \"shadowed\": ";
+    json += factory.shadowed ? "true}" : "false}";
+  }
+  json += factories.empty() ? "]" : "\n  ]";
+}
+
+}  // namespace
+
+std::string RegistrySnapshot::toJson() const
+{
+  std::string json = "{\n  \"time_ms\": ";
+  json += std::to_string(
+    std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count());
+  json += ",\n  \"generation\": ";
+  json += std::to_string(generation);
+  json += ",\n  \"non_pure_library_opened\": ";
+  json += non_pure_library_opened ? "true" : "false";
+  json += ",\n  \"libraries\": [";
+  for (std::size_t i = 0; i < libraries.size(); ++i) {
+    json += 0 == i ? "\n    {\"library_path\": " : ",\n    {\"library_path\": ";
+    impl::appendJsonString(json, libraries[i].library_path);
+    json += ", \"handle\": ";
+    appendJsonAddress(json, libraries[i].handle);
+    json += '}';
+  }
+  json += libraries.empty() ? "]" : "\n  ]";
+  json += ",\n  \"factories\": ";
+  appendJsonFactories(json, factories);
+  json += ",\n  \"graveyard\": ";
+  appendJsonFactories(json, graveyard);
+  json += "\n}\n";
+  return json;
+}
+
+}  // namespace plugin_loader
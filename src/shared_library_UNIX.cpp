@@ -18,11 +18,23 @@ void SharedLibrary::load(const std::string& path, int flags)
         throw plugin_loader::LibraryLoadException("Library already loaded: " + path);
     }
     int realFlags = RTLD_LAZY;
-    if (flags & SHLIB_LOCAL)
+    if (flags & (SHLIB_LOCAL | SHLIB_ISOLATED))
         realFlags |= RTLD_LOCAL;
     else
         realFlags |= RTLD_GLOBAL;
-    _handle = dlopen(path.c_str(), realFlags);
+    if (flags & SHLIB_ISOLATED)
+    {
+#ifdef LM_ID_NEWLM
+        _handle = dlmopen(LM_ID_NEWLM, path.c_str(), realFlags);
+#else
+        throw plugin_loader::LibraryLoadException(
+                    "Could not load library: " + path + " (dlmopen() is not available)");
+#endif
+    }
+    else
+    {
+        _handle = dlopen(path.c_str(), realFlags);
+    }
     if (!_handle)
     {
         const char* err = dlerror();